@@ -0,0 +1,95 @@
+// Generated by nob from ./src/suffixes.txt, don't edit
+static const SuffixState suffixStates[] = {
+    {{54,0,0,0,25,0,0,0,0,0,0,0,1,0,44,0,0,66,7,70,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{78,0,0,0,20,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,2,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,38,0,0,0,3,57,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{4,0,0,0,6,0,0,0,0,0,0,0,0,0,5,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{12,0,0,0,14,0,0,0,15,0,0,0,0,0,13,0,0,0,0,0,8,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,9,0,0,0,0,0,0,0,0,0,0,65,0,0,0,0,0,52,0,0,0,0,0,0,0}, 2, 0x00, 0x01},
+    {{10,0,0,0,0,0,0,0,11,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x00, 0x05},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x01, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x01, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,35,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x01, 0x00},
+    {{0,0,0,0,16,0,0,0,17,0,0,59,0,29,0,0,0,0,0,18,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x02, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x02, 0x01},
+    {{19,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x00, 0x02},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,23,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,61,0,32,0,0,0,0,0,21,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{22,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,24,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,41,0,0,0,0,0,26,63,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{27,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,28,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,48,0,0,0,0,0,30,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,31,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,33,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,34,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,36,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,37,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x0A, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,39,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,40,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x02, 0x08},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,42,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x00, 0x02},
+    {{0,0,0,0,0,0,0,0,43,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x02, 0x08},
+    {{0,0,0,45,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 1, 0x01, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,46,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,47,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x0A, 0x00},
+    {{0,0,0,49,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,50,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,51,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 7, 0x02, 0x28},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,53,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,55,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,56,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x01, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,58,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{60,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x00},
+    {{62,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,64,0,0,0,0,0,0,0,0,0}, 2, 0x00, 0x02},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x00, 0x04},
+    {{84,0,0,0,85,0,0,0,86,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x00, 0x02},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,67,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,68,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{87,0,0,0,88,0,0,0,89,0,0,0,0,69,0,0,0,0,0,0,0,0,0,0,0,0}, 3, 0x00, 0x02},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x00, 0x04},
+    {{71,0,0,0,91,0,0,0,90,0,0,0,0,74,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,72,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x00, 0x01},
+    {{73,0,0,0,81,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{75,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,76,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{77,0,0,0,82,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x01, 0x04},
+    {{0,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{80,0,0,0,83,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 0, 0x00, 0x00},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 5, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x00, 0x05},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x01, 0x04},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 4, 0x00, 0x05},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x00, 0x01},
+    {{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, 2, 0x00, 0x01},
+};
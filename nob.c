@@ -1,6 +1,7 @@
 #define NOB_IMPLEMENTATION
 #define NOB_STRIP_PREFIX
 #include "./src/nob.h"
+#include "./src/suffix.h"
 
 // Stolen from https://github.com/tsoding/musializer
 typedef enum {
@@ -41,11 +42,175 @@ bool parseTarget(const char* value, Target* target) {
     return true;
 }
 
+typedef struct {
+    SuffixState* items;
+    size_t count;
+    size_t capacity;
+} SuffixStates;
+
+bool isSuffixVowel(const char* ending, size_t index) {
+    char chr = ending[index];
+    if (chr == 'u' && index > 0 && ending[index - 1] == 'q') return false;
+    return chr == 'a' || chr == 'e' || chr == 'i' || chr == 'o' || chr == 'u' || chr == 'y';
+}
+
+// Compile the ending rules (see suffixes.txt) into the table of the suffix automaton, as a header for suffix.c
+bool generateSuffixAutomaton(const char* rulesPath, const char* outputPath) {
+    int needsRebuild = needs_rebuild1(outputPath, rulesPath);
+    if (needsRebuild < 0) return false;
+    if (needsRebuild == 0) return true;
+
+    bool result = true;
+    String_Builder rules = {0};
+    String_Builder output = {0};
+    SuffixStates states = {0};
+    if (!read_entire_file(rulesPath, &rules)) return_defer(false);
+    da_append(&states, (SuffixState) {0});
+
+    String_View content = sv_from_parts(rules.items, rules.count);
+    for (size_t lineNumber = 1; content.count > 0; ++lineNumber) {
+        String_View line = sv_trim(sv_chop_by_delim(&content, '\n'));
+        if (line.count == 0 || line.data[0] == '#') continue;
+        String_View ending = sv_chop_by_delim(&line, ' ');
+        String_View quantities = sv_trim(line);
+
+        if (ending.count == 0 || ending.count > SUFFIX_MAX_LENGTH) {
+            nob_log(ERROR, "%s:%zu: An ending has to have 1 to %d letters", rulesPath, lineNumber, SUFFIX_MAX_LENGTH);
+            return_defer(false);
+        }
+        for (size_t i = 0; i < quantities.count; ++i) {
+            char quantity = quantities.data[i];
+            if (quantity != '_' && quantity != 'u' && quantity != '?') {
+                nob_log(ERROR, "%s:%zu: '%c' isn't a quantity, use '_', 'u' or '?'", rulesPath, lineNumber, quantity);
+                return_defer(false);
+            }
+        }
+        uint8_t longMask = 0, shortMask = 0;
+        size_t vowel = 0;
+        for (size_t i = 0; i < ending.count; ++i) {
+            if (ending.data[i] < 'a' || ending.data[i] > 'z') {
+                nob_log(ERROR, "%s:%zu: An ending can only have lowercase letters", rulesPath, lineNumber);
+                return_defer(false);
+            }
+            if (!isSuffixVowel(ending.data, i)) continue;
+            char quantity = vowel < quantities.count ? quantities.data[vowel] : 0;
+            ++vowel;
+            if (quantity == '_') longMask |= 1 << i;
+            else if (quantity == 'u') shortMask |= 1 << i;
+        }
+        if (vowel != quantities.count) {
+            nob_log(ERROR, "%s:%zu: \"" SV_Fmt "\" needs a quantity ('_', 'u' or '?') for each of its vowels", rulesPath, lineNumber, SV_Arg(ending));
+            return_defer(false);
+        }
+
+        // Insert the ending backwards, with 'j' and 'v' as 'i' and 'u' like the stripped line is walked
+        size_t state = 0;
+        for (size_t i = ending.count; i > 0; --i) {
+            char chr = ending.data[i - 1];
+            if (chr == 'j') chr = 'i';
+            else if (chr == 'v') chr = 'u';
+            if (states.items[state].next[chr - 'a'] == 0) {
+                NOB_ASSERT(states.count <= UINT16_MAX && "Too many suffix rules");
+                states.items[state].next[chr - 'a'] = states.count;
+                da_append(&states, (SuffixState) {0});
+            }
+            state = states.items[state].next[chr - 'a'];
+        }
+        if (states.items[state].length > 0) {
+            nob_log(ERROR, "%s:%zu: There's already a rule for \"" SV_Fmt "\"", rulesPath, lineNumber, SV_Arg(ending));
+            return_defer(false);
+        }
+        states.items[state].length = ending.count;
+        states.items[state].longMask = longMask;
+        states.items[state].shortMask = shortMask;
+    }
+
+    sb_append_cstr(&output, temp_sprintf("// Generated by nob from %s, don't edit\n", rulesPath));
+    sb_append_cstr(&output, "static const SuffixState suffixStates[] = {\n");
+    for (size_t i = 0; i < states.count; ++i) {
+        const SuffixState* state = &states.items[i];
+        sb_append_cstr(&output, "    {{");
+        for (size_t chr = 0; chr < 26; ++chr) sb_append_cstr(&output, temp_sprintf(chr == 0 ? "%u" : ",%u", state->next[chr]));
+        sb_append_cstr(&output, temp_sprintf("}, %u, 0x%02X, 0x%02X},\n", state->length, state->longMask, state->shortMask));
+    }
+    sb_append_cstr(&output, "};\n");
+    if (!write_entire_file(outputPath, output.items, output.count)) return_defer(false);
+    nob_log(INFO, "Generated %s with %zu states", outputPath, states.count);
+
+defer:
+    sb_free(rules);
+    sb_free(output);
+    da_free(states);
+    return result;
+}
+
 static char* sourceFiles[] = {
     "dactylichexameter.c",
+    "batch.c",
+    "pipeline.c",
+    "shard.c",
+    "checkpoint.c",
+    "scansion.c",
+    "records.c",
+    "columnar.c",
+    "unicode.c",
+    "lexicon.c",
+    "suffix.c",
+    "memory.c",
+    "ngram.c",
+    "server.c",
+    "lsp.c",
+    "shm.c",
     "main.c",
 };
 
+// The SIMD kernels are slower than plain loops without optimizations, so they're always built with them
+static char* optimizedSourceFiles[] = {
+    "kernels",
+};
+
+/* Build the CPython extension (src/python.c) for an interpreter, as ./build/dactylichexameter<suffix>. The interpreter
+ * says where its headers are and what its extensions are called. The extension is built with optimizations, since
+ * it's only there to scan a lot of verses
+ */
+bool buildPythonExtension(const char* compiler, const char* python) {
+    bool result = true;
+    Cmd cmd = {0};
+    String_Builder config = {0};
+    const char* configPath = "./build/python-config.txt";
+    Fd configFile = fd_open_for_write(configPath);
+    if (configFile == INVALID_FD) return false;
+    cmd_append(&cmd, python, "-c", "import sysconfig; print(sysconfig.get_paths()['include']); print(sysconfig.get_config_var('EXT_SUFFIX'))");
+    if (!cmd_run_sync_redirect_and_reset(&cmd, (Cmd_Redirect) { .fdout = &configFile })) return_defer(false);
+    if (!read_entire_file(configPath, &config)) return_defer(false);
+    String_View lines = sv_from_parts(config.items, config.count);
+    String_View include = sv_trim(sv_chop_by_delim(&lines, '\n'));
+    String_View suffix = sv_trim(sv_chop_by_delim(&lines, '\n'));
+    if (include.count == 0 || suffix.count == 0 || sv_eq(suffix, sv_from_cstr("None"))) {
+        nob_log(ERROR, "%s didn't say where its headers are or what its extensions are called", python);
+        return_defer(false);
+    }
+
+    cmd_append(&cmd, compiler, "-Wall", "-Wextra", "-ggdb", "-O2", "-shared", "-fPIC", "-fvisibility=hidden", "-pthread");
+    cmd_append(&cmd, "-I./build", "-I./src", temp_sprintf("-I"SV_Fmt, SV_Arg(include)));
+    cmd_append(&cmd, "-o", temp_sprintf("./build/dactylichexameter"SV_Fmt, SV_Arg(suffix)));
+    cmd_append(&cmd, "./src/python.c");
+    for (size_t i = 0; i < ARRAY_LEN(sourceFiles); ++i) {
+        if (strcmp(sourceFiles[i], "main.c") == 0) continue;
+        cmd_append(&cmd, temp_sprintf("./src/%s", sourceFiles[i]));
+    }
+    for (size_t i = 0; i < ARRAY_LEN(optimizedSourceFiles); ++i) {
+        cmd_append(&cmd, temp_sprintf("./src/%s.c", optimizedSourceFiles[i]));
+    }
+    cmd_append(&cmd, "-lm");
+    if (!cmd_run_sync_and_reset(&cmd)) return_defer(false);
+
+defer:
+    cmd_free(cmd);
+    sb_free(config);
+    return result;
+}
+
 int main(int argc, char** argv) {
     NOB_GO_REBUILD_URSELF(argc, argv);
 
@@ -58,32 +223,67 @@ int main(int argc, char** argv) {
 #else
     Target target = TARGET_LINUX;
 #endif
+    // With "lexicon", build for this machine and then compile a word list into a lexicon with the program
+    const char* lexiconWords = NULL;
+    const char* lexiconPath = "./build/lexicon.dhlex";
+    // With "python", also build the Python extension for an interpreter
+    const char* python = NULL;
     if (argc > 0) {
         const char* subcommand = shift(argv, argc);
         if (strcmp(subcommand, "--help") == 0 || strcmp(subcommand, "-h") == 0 || strcmp(subcommand, "help") == 0) {
-            nob_log(INFO, "Usage: %s [target]");
+            nob_log(INFO, "Usage: %s [target]", program);
+            nob_log(INFO, "       %s lexicon <words> [output]", program);
+            nob_log(INFO, "       %s python [interpreter]", program);
             logAvailableTargets(INFO);
         }
 
-        if (!parseTarget(subcommand, &target)) return 1;
+        if (strcmp(subcommand, "lexicon") == 0) {
+            if (argc == 0) {
+                nob_log(ERROR, "Usage: %s lexicon <words> [output]", program);
+                return 1;
+            }
+            lexiconWords = shift(argv, argc);
+            if (argc > 0) lexiconPath = shift(argv, argc);
+        } else if (strcmp(subcommand, "python") == 0) {
+            python = argc > 0 ? shift(argv, argc) : "python3";
+        } else if (!parseTarget(subcommand, &target)) {
+            return 1;
+        }
     }
 
+    if (!generateSuffixAutomaton("./src/suffixes.txt", "./build/suffixautomaton.h")) return 1;
+
+    const char* compiler = target == TARGET_WIN64_MINGW ? "x86_64-w64-mingw32-gcc" : "gcc";
     Cmd cmd = {0};
-    if (target == TARGET_WIN64_MINGW)
-        cmd_append(&cmd, "x86_64-w64-mingw32-gcc");
-    else
-        cmd_append(&cmd, "gcc");
-    cmd_append(&cmd, "-Wall", "-Wextra", "-ggdb");
+    for (size_t i = 0; i < ARRAY_LEN(optimizedSourceFiles); ++i) {
+        cmd_append(&cmd, compiler, "-Wall", "-Wextra", "-ggdb", "-O2", "-c");
+        cmd_append(&cmd, "-o", nob_temp_sprintf("./build/%s.o", optimizedSourceFiles[i]));
+        cmd_append(&cmd, nob_temp_sprintf("./src/%s.c", optimizedSourceFiles[i]));
+        if (!cmd_run_sync_and_reset(&cmd)) return 1;
+    }
+
+    cmd_append(&cmd, compiler);
+    cmd_append(&cmd, "-Wall", "-Wextra", "-ggdb", "-pthread", "-I./build");
     cmd_append(&cmd, "-o", "./build/main");
     for (size_t i = 0; i < ARRAY_LEN(sourceFiles); ++i) {
         cmd_append(&cmd, nob_temp_sprintf("./src/%s", sourceFiles[i]));
     }
+    for (size_t i = 0; i < ARRAY_LEN(optimizedSourceFiles); ++i) {
+        cmd_append(&cmd, nob_temp_sprintf("./build/%s.o", optimizedSourceFiles[i]));
+    }
 
+    cmd_append(&cmd, "-lm");
     if (target == TARGET_WIN64_MINGW)
         cmd_append(&cmd, "-static");
 
 
     if (!cmd_run_sync_and_reset(&cmd)) return 1;
 
+    if (lexiconWords != NULL) {
+        cmd_append(&cmd, "./build/main", "--compile-lexicon", lexiconWords, lexiconPath);
+        if (!cmd_run_sync_and_reset(&cmd)) return 1;
+    }
+    if (python != NULL && !buildPythonExtension(compiler, python)) return 1;
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "batch.h"
+#include "checkpoint.h"
+#include "records.h"
+#include "columnar.h"
+#ifdef _WIN32
+#    include <io.h>
+#else
+#    include <poll.h>
+#    include <sys/stat.h>
+#endif
+
+// batchRun collects the output of this many bytes before writing it
+#define BATCH_OUTPUT_BUFFER_SIZE (64*1024)
+
+const char* outputFormatNames[] = {
+    [OUTPUT_TEXT]   = "text",
+    [OUTPUT_BINARY] = "binary",
+    [OUTPUT_JSONL]  = "jsonl",
+    [OUTPUT_CSV]    = "csv",
+    [OUTPUT_COLUMNAR] = "columnar",
+    [OUTPUT_CHECK]    = "check",
+};
+static_assert(NOB_ARRAY_LEN(outputFormatNames) == COUNT_OUTPUT_FORMATS, "Amount of output formats have changed");
+
+bool parseOutputFormat(const char* value, OutputFormat* format) {
+    for (size_t i = 0; i < COUNT_OUTPUT_FORMATS; ++i) {
+        if (strcmp(outputFormatNames[i], value) == 0) {
+            *format = i;
+            return true;
+        }
+    }
+    nob_log(NOB_ERROR, "Unknown output format %s", value);
+    return false;
+}
+
+void batchScratchFree(BatchScratch* scratch) {
+    dhContextFree(&scratch->ctx);
+    nob_sb_free(scratch->numbers);
+    nob_sb_free(scratch->scan);
+    nob_sb_free(scratch->strippedLine);
+    memset(scratch, 0, sizeof(*scratch));
+}
+
+void batchStatsAdd(BatchStats* stats, BatchStats other) {
+    stats->verses += other.verses;
+    stats->scanned += other.scanned;
+    stats->failed += other.failed;
+}
+
+long long batchTell(FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+bool batchSeek(FILE* file, long long offset) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool batchReadLine(FILE* file, Nob_String_Builder* sb, size_t* consumed) {
+    sb->count = 0;
+    char buffer[4096];
+    bool readSomething = false;
+    // fgets stops at a newline or when the buffer is full, so keep going until we've seen the newline
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        readSomething = true;
+        size_t bufferLen = strlen(buffer);
+        nob_sb_append_buf(sb, buffer, bufferLen);
+        if (bufferLen > 0 && buffer[bufferLen - 1] == '\n') break;
+    }
+    if (!readSomething) return false;
+    if (consumed != NULL) *consumed = sb->count;
+
+    // Remove the line ending (both "\n" and "\r\n")
+    while (sb->count > 0 && (sb->items[sb->count - 1] == '\n' || sb->items[sb->count - 1] == '\r')) --sb->count;
+    nob_sb_append_null(sb);
+    return true;
+}
+
+bool batchInputCanBlock(FILE* file) {
+#ifdef _WIN32
+    return GetFileType((HANDLE) _get_osfhandle(_fileno(file))) != FILE_TYPE_DISK;
+#else
+    struct stat info;
+    return fstat(fileno(file), &info) != 0 || !S_ISREG(info.st_mode);
+#endif
+}
+
+bool batchInputWouldBlock(FILE* file) {
+#ifdef _WIN32
+    HANDLE handle = (HANDLE) _get_osfhandle(_fileno(file));
+    if (GetFileType(handle) != FILE_TYPE_PIPE) return true;
+    DWORD available = 0;
+    return !PeekNamedPipe(handle, NULL, 0, NULL, &available, NULL) || available == 0;
+#else
+    struct pollfd fd = { .fd = fileno(file), .events = POLLIN };
+    return poll(&fd, 1, 0) == 0;
+#endif
+}
+
+bool batchScanVerse(const char* verse, BatchScratch* scratch, Nob_String_Builder* out) {
+    if (scratch->format == OUTPUT_CHECK) {
+        bool valid = dhIsHexameter(&scratch->ctx, verse);
+        nob_sb_append_cstr(out, valid ? "1\n" : "0\n");
+        return valid;
+    }
+
+    DhStatus status = dhScanLine(&scratch->ctx, verse, &scratch->verse);
+    bool scanned = status == DH_OK || status == DH_INCOMPLETE;
+
+    if (scratch->format != OUTPUT_TEXT) {
+        DhRecord record = recordFromVerse(&scratch->verse);
+        switch (scratch->format) {
+        // The columnar writer picks the records back up from the binary format
+        case OUTPUT_COLUMNAR:
+        case OUTPUT_BINARY: recordAppendBinary(out, &record); break;
+        case OUTPUT_JSONL:  recordAppendJson(out, &record);   break;
+        case OUTPUT_CSV:    recordAppendCsv(out, &record);    break;
+        case OUTPUT_TEXT:
+        case OUTPUT_CHECK:
+        case COUNT_OUTPUT_FORMATS: NOB_UNREACHABLE("batchScanVerse");
+        }
+        return scanned;
+    }
+
+    if (!scanned) goto fail;
+
+    dhRenderVerse(&scratch->ctx, &scratch->verse, &scratch->numbers, &scratch->scan, &scratch->strippedLine);
+
+    nob_sb_append_buf(out, scratch->numbers.items, scratch->numbers.count);
+    nob_da_append(out, '\n');
+    nob_sb_append_buf(out, scratch->scan.items, scratch->scan.count);
+    nob_da_append(out, '\n');
+    nob_sb_append_buf(out, scratch->strippedLine.items, scratch->strippedLine.count);
+    nob_sb_append_cstr(out, "\n\n");
+    return true;
+
+fail:
+    // Still write something, so every verse in the input has a block in the output
+    nob_da_append(out, '!');
+    nob_sb_append_cstr(out, verse);
+    nob_sb_append_cstr(out, "\n\n");
+    return false;
+}
+
+bool batchWriteOutput(BatchOutput* output, Nob_String_Builder* buffer, const BatchLineSizes* lineSizes, BatchStats stats) {
+    long long inputBytes = 0;
+    for (size_t i = 0; i < lineSizes->count; ++i) inputBytes += lineSizes->items[i];
+
+    if (output->format == OUTPUT_COLUMNAR) {
+        NOB_ASSERT(buffer->count == lineSizes->count*RECORD_BINARY_SIZE);
+        for (size_t i = 0; i < lineSizes->count; ++i) {
+            DhRecord record = recordDecodeBinary((const uint8_t*) buffer->items + i*RECORD_BINARY_SIZE);
+            if (!columnarWriterAdd(output->columnar, &record, output->sourceOffset)) return false;
+            output->sourceOffset += lineSizes->items[i];
+        }
+    } else {
+        if (fwrite(buffer->items, 1, buffer->count, output->file) != buffer->count) {
+            nob_log(NOB_ERROR, "Couldn't write the verses: %s", strerror(errno));
+            return false;
+        }
+        output->sourceOffset += inputBytes;
+    }
+
+    bool result = checkpointAdvance(output->checkpointer, output->file, inputBytes, buffer->count, stats);
+    buffer->count = 0;
+    return result;
+}
+
+bool batchRun(FILE* in, long long end, BatchOutput* output) {
+    Nob_String_Builder verse = {0};
+    Nob_String_Builder buffer = {0};
+    BatchScratch scratch = {
+        .format = output->format,
+        .ctx = {
+            .meter = output->scan.meter,
+            .detectMeter = output->scan.detectMeter,
+            .lexicon = output->scan.lexicon,
+            .memory = output->memory,
+            .ngram = output->scan.ngram,
+        },
+    };
+    bool result = true;
+    // Only a pipe or a terminal can keep us waiting for the next verse, a file never does
+    bool canBlock = batchInputCanBlock(in);
+
+    // The input sizes and statistics of the verses in buffer right now
+    BatchLineSizes lineSizes = {0};
+    BatchStats stats = {0};
+
+    for (;;) {
+        if (end >= 0) {
+            long long position = batchTell(in);
+            if (position < 0 || position >= end) break;
+        }
+
+        // Whoever is on the other side of a slow pipe shouldn't have to wait for the results of the verses it already sent
+        if (canBlock && buffer.count > 0 && batchInputWouldBlock(in)) {
+            if (!batchWriteOutput(output, &buffer, &lineSizes, stats)) nob_return_defer(false);
+            lineSizes.count = 0;
+            memset(&stats, 0, sizeof(stats));
+            if (output->file != NULL && fflush(output->file) != 0) {
+                nob_log(NOB_ERROR, "Couldn't write the verses: %s", strerror(errno));
+                nob_return_defer(false);
+            }
+        }
+
+        size_t consumed;
+        if (!batchReadLine(in, &verse, &consumed)) break;
+
+        nob_da_append(&lineSizes, consumed);
+        ++stats.verses;
+        if (batchScanVerse(verse.items, &scratch, &buffer))
+            ++stats.scanned;
+        else
+            ++stats.failed;
+
+        // Also write when a checkpoint is due, so the checkpoints come every interval verses and not every buffer
+        if (buffer.count >= BATCH_OUTPUT_BUFFER_SIZE || stats.verses >= checkpointVersesLeft(output->checkpointer)) {
+            if (!batchWriteOutput(output, &buffer, &lineSizes, stats)) nob_return_defer(false);
+            lineSizes.count = 0;
+            memset(&stats, 0, sizeof(stats));
+        }
+    }
+    if (!batchWriteOutput(output, &buffer, &lineSizes, stats)) nob_return_defer(false);
+
+    if (ferror(in)) {
+        nob_log(NOB_ERROR, "Couldn't read the verses: %s", strerror(errno));
+        nob_return_defer(false);
+    }
+
+defer:
+    nob_sb_free(verse);
+    nob_sb_free(buffer);
+    nob_da_free(lineSizes);
+    batchScratchFree(&scratch);
+    return result;
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+typedef enum {
+    // The numbers, lengths and stripped line, like the interactive mode
+    OUTPUT_TEXT,
+    // The records from records.h
+    OUTPUT_BINARY,
+    OUTPUT_JSONL,
+    OUTPUT_CSV,
+    // The column store from columnar.h, which has to go to a file
+    OUTPUT_COLUMNAR,
+    // Only "1" or "0" for every verse, for whether it's a valid hexameter (dhIsHexameter)
+    OUTPUT_CHECK,
+    COUNT_OUTPUT_FORMATS,
+} OutputFormat;
+
+extern const char* outputFormatNames[];
+
+bool parseOutputFormat(const char* value, OutputFormat* format);
+
+// Buffers that are reused from verse to verse, so scanning a lot of verses doesn't allocate for every one of them
+typedef struct {
+    OutputFormat format;
+    DhContext ctx;
+    DhVerse verse;
+    Nob_String_Builder numbers;
+    Nob_String_Builder scan;
+    Nob_String_Builder strippedLine;
+} BatchScratch;
+
+void batchScratchFree(BatchScratch* scratch);
+
+// Counts of what happened to the verses in a run
+typedef struct {
+    size_t verses;
+    size_t scanned;
+    size_t failed;
+} BatchStats;
+
+void batchStatsAdd(BatchStats* stats, BatchStats other);
+
+// Get and set the position in a file as a 64 bit number, so files bigger than 2 GiB work everywhere. batchTell returns -1 on failure
+long long batchTell(FILE* file);
+bool batchSeek(FILE* file, long long offset);
+
+/* Read one line from a file into sb, without the line ending. sb will be cleared first and will be NULL-terminated.
+ * consumed is optional and is set to the amount of bytes that were read, including the line ending.
+ * Returns false if there was nothing left to read
+ */
+bool batchReadLine(FILE* file, Nob_String_Builder* sb, size_t* consumed);
+
+// Whether reading from a file can keep us waiting, which a regular file never does
+bool batchInputCanBlock(FILE* file);
+// Whether the next read from a pipe or terminal would have to wait, because nothing was written to it yet
+bool batchInputWouldBlock(FILE* file);
+
+/* Scan a single (NULL-terminated) verse and append the result to out in scratch->format. As text, that's the numbers,
+ * lengths and stripped line followed by an empty line, or, if the verse couldn't be scanned, a line starting with '!'
+ * and the verse. The other formats always get one record per verse. Returns false if the verse couldn't be scanned
+ */
+bool batchScanVerse(const char* verse, BatchScratch* scratch, Nob_String_Builder* out);
+
+struct Checkpointer;
+struct ColumnarWriter;
+struct WordMemory;
+
+// Where the results of a run go, and how the verses are scanned for them
+typedef struct {
+    OutputFormat format;
+    // How to scan
+    DhScanSettings scan;
+    // Optional, see DhContext. Only batchRun uses it, since the verses have to be scanned in order
+    struct WordMemory* memory;
+    // Where the output goes, for every format except OUTPUT_COLUMNAR
+    FILE* file;
+    // Where the records go for OUTPUT_COLUMNAR
+    struct ColumnarWriter* columnar;
+    // Optional. Keeps track of the progress and statistics, and writes checkpoints
+    struct Checkpointer* checkpointer;
+    // Where the next verse starts in the input, for the source offsets in the column store
+    uint64_t sourceOffset;
+} BatchOutput;
+
+// The input sizes of the verses that are in a piece of output
+typedef struct {
+    size_t* items;
+    size_t count;
+    size_t capacity;
+} BatchLineSizes;
+
+/* Hand a piece of scanned output, the input it came from and its statistics over to where it has to go.
+ * The buffer is cleared afterwards
+ */
+bool batchWriteOutput(BatchOutput* output, Nob_String_Builder* buffer, const BatchLineSizes* lineSizes, BatchStats stats);
+
+/* Scan every line in a file one by one, and write the results to output. If end isn't negative, stop at the first line
+ * that starts at or after that byte offset
+ */
+bool batchRun(FILE* in, long long end, BatchOutput* output);
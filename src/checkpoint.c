@@ -0,0 +1,199 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "checkpoint.h"
+#include "memory.h"
+#ifdef _WIN32
+#    include <io.h>
+#endif
+
+#define CHECKPOINT_HEADER "# dh checkpoint v1"
+// After the numbers, a checkpoint can have the word memory of the run, in the format of memorySave
+#define CHECKPOINT_MEMORY "\nmemory\n"
+
+bool checkpointRead(const char* path, Checkpoint* checkpoint, struct WordMemory* memory) {
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    nob_sb_append_null(&sb);
+    Checkpoint read = {0};
+    int end = 0;
+    bool result = sscanf(sb.items, CHECKPOINT_HEADER " input %lld output %lld verses %zu scanned %zu failed %zu%n",
+        &read.inputOffset, &read.outputOffset, &read.stats.verses, &read.stats.scanned, &read.stats.failed, &end) == 5;
+    if (!result) {
+        nob_log(NOB_ERROR, "Invalid checkpoint in %s", path);
+        nob_return_defer(false);
+    }
+    *checkpoint = read;
+
+    if (memory != NULL) {
+        const char* rest = sb.items + end;
+        size_t restSize = sb.count - 1 - end;
+        size_t headerSize = strlen(CHECKPOINT_MEMORY);
+        if (restSize >= headerSize && memcmp(rest, CHECKPOINT_MEMORY, headerSize) == 0) {
+            if (!memoryDecode(memory, rest + headerSize, restSize - headerSize, path)) nob_return_defer(false);
+            nob_log(NOB_INFO, "Remembered %zu words from %s", memory->count, path);
+        } else {
+            nob_log(NOB_WARNING, "%s doesn't have a word memory, so the memory from before the run is used", path);
+        }
+    }
+
+defer:
+    nob_sb_free(sb);
+    return result;
+}
+
+// Make sure everything that was written to a file is actually on the disk
+bool checkpointSync(FILE* file) {
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+/* Write the checkpoint (with the word memory, if there is one) to a temporary file and rename it over the old one, so
+ * there's always one complete checkpoint
+ */
+bool checkpointWrite(const char* path, Checkpoint checkpoint, const struct WordMemory* memory) {
+    const char* tempPath = nob_temp_sprintf("%s.tmp", path);
+    FILE* file = fopen(tempPath, "wb");
+    if (file == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", tempPath, strerror(errno));
+        return false;
+    }
+    fprintf(file, CHECKPOINT_HEADER "\ninput %lld\noutput %lld\nverses %zu\nscanned %zu\nfailed %zu\n",
+        checkpoint.inputOffset, checkpoint.outputOffset, checkpoint.stats.verses, checkpoint.stats.scanned, checkpoint.stats.failed);
+    bool written = true;
+    if (memory != NULL) {
+        Nob_String_Builder sb = {0};
+        // The numbers already end with a newline
+        nob_sb_append_cstr(&sb, CHECKPOINT_MEMORY + 1);
+        memoryAppend(memory, &sb);
+        written = fwrite(sb.items, 1, sb.count, file) == sb.count;
+        nob_sb_free(sb);
+    }
+    bool synced = checkpointSync(file);
+    if (fclose(file) != 0 || !written || !synced) {
+        nob_log(NOB_ERROR, "Couldn't write %s: %s", tempPath, strerror(errno));
+        return false;
+    }
+#ifdef _WIN32
+    // rename doesn't replace existing files on Windows
+    return MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(tempPath, path) == 0;
+#endif
+}
+
+// Cut a file off at a certain size
+bool checkpointTruncate(const char* path, long long size) {
+#ifdef _WIN32
+    FILE* file = fopen(path, "r+b");
+    if (file == NULL) return false;
+    bool result = _chsize_s(_fileno(file), size) == 0;
+    fclose(file);
+    return result;
+#else
+    return truncate(path, size) == 0;
+#endif
+}
+
+bool checkpointOpenOutput(Checkpointer* checkpointer, const char* outputPath, bool resume, FILE* in, long long inputStart, FILE** out) {
+    memset(&checkpointer->progress, 0, sizeof(checkpointer->progress));
+    checkpointer->versesSinceCheckpoint = 0;
+
+    if (resume && checkpointer->path != NULL && nob_file_exists(checkpointer->path) == 1) {
+        if (!checkpointRead(checkpointer->path, &checkpointer->progress, checkpointer->memory)) return false;
+        Checkpoint progress = checkpointer->progress;
+
+        // Anything after the checkpoint might be half a verse, so throw it away and write it again
+        if (!checkpointTruncate(outputPath, progress.outputOffset)) {
+            nob_log(NOB_ERROR, "Couldn't cut %s off at the checkpoint: %s", outputPath, strerror(errno));
+            return false;
+        }
+
+        if (inputStart >= 0) {
+            if (!batchSeek(in, inputStart + progress.inputOffset)) {
+                nob_log(NOB_ERROR, "Couldn't move to the checkpoint in the input: %s", strerror(errno));
+                return false;
+            }
+        } else {
+            char buffer[64*1024];
+            long long left = progress.inputOffset;
+            while (left > 0) {
+                size_t wanted = left < (long long) sizeof(buffer) ? (size_t) left : sizeof(buffer);
+                size_t read = fread(buffer, 1, wanted, in);
+                if (read == 0) {
+                    nob_log(NOB_ERROR, "The input ended before the checkpoint");
+                    return false;
+                }
+                left -= read;
+            }
+        }
+
+        nob_log(NOB_INFO, "Resuming after verse %zu", progress.stats.verses);
+        *out = fopen(outputPath, "ab");
+    } else {
+        if (resume) nob_log(NOB_WARNING, "There's no checkpoint to resume from, starting from the beginning");
+        *out = fopen(outputPath, "wb");
+    }
+
+    if (*out == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", outputPath, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+// The amount of verses between checkpoints
+size_t checkpointInterval(const Checkpointer* checkpointer) {
+    return checkpointer->interval > 0 ? checkpointer->interval : CHECKPOINT_DEFAULT_INTERVAL;
+}
+
+size_t checkpointVersesLeft(const Checkpointer* checkpointer) {
+    if (checkpointer == NULL || checkpointer->path == NULL) return SIZE_MAX;
+    size_t interval = checkpointInterval(checkpointer);
+    return checkpointer->versesSinceCheckpoint < interval ? interval - checkpointer->versesSinceCheckpoint : 0;
+}
+
+bool checkpointAdvance(Checkpointer* checkpointer, FILE* out, long long inputBytes, long long outputBytes, BatchStats stats) {
+    if (checkpointer == NULL) return true;
+    checkpointer->progress.inputOffset += inputBytes;
+    checkpointer->progress.outputOffset += outputBytes;
+    batchStatsAdd(&checkpointer->progress.stats, stats);
+    checkpointer->versesSinceCheckpoint += stats.verses;
+
+    if (checkpointer->path == NULL) return true;
+    if (checkpointer->versesSinceCheckpoint < checkpointInterval(checkpointer)) return true;
+    checkpointer->versesSinceCheckpoint = 0;
+
+    // The output has to be on the disk before the checkpoint that points to the end of it
+    if (!checkpointSync(out)) {
+        nob_log(NOB_ERROR, "Couldn't write the output: %s", strerror(errno));
+        return false;
+    }
+    return checkpointWrite(checkpointer->path, checkpointer->progress, checkpointer->memory);
+}
+
+void checkpointFinish(Checkpointer* checkpointer) {
+    if (checkpointer == NULL || checkpointer->path == NULL) return;
+    remove(checkpointer->path);
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "nob.h"
+#include "batch.h"
+
+#define CHECKPOINT_DEFAULT_INTERVAL 10000
+
+struct WordMemory;
+
+// How far a run got. The offsets count from where the run started reading and writing
+typedef struct {
+    long long inputOffset;
+    long long outputOffset;
+    // stats.verses is the amount of verses that were written
+    BatchStats stats;
+} Checkpoint;
+
+typedef struct Checkpointer {
+    // Where the checkpoints are written. NULL turns checkpoints off
+    const char* path;
+    // The amount of verses between checkpoints. 0 means CHECKPOINT_DEFAULT_INTERVAL
+    size_t interval;
+    // Everything that was written so far, including everything before the run was resumed
+    Checkpoint progress;
+    size_t versesSinceCheckpoint;
+    /* Optional. The word memory of the run, which is saved in every checkpoint, so a resumed run knows exactly what it
+     * had learned from the verses before the checkpoint
+     */
+    struct WordMemory* memory;
+} Checkpointer;
+
+/* Read a checkpoint. If memory isn't NULL, it's replaced by the word memory in the checkpoint. A checkpoint without
+ * one leaves memory alone
+ */
+bool checkpointRead(const char* path, Checkpoint* checkpoint, struct WordMemory* memory);
+
+/* Open the output file of a run. If resume is true and there's a checkpoint, the output is cut off right after the last
+ * checkpoint (throwing away whatever was written after it), the input is moved to the matching position and
+ * checkpointer->progress (and checkpointer->memory) is filled in. inputStart is where the run begins in the input file, or -1 if the input
+ * can't seek (stdin), in which case the already scanned bytes are read and thrown away instead.
+ * Without a checkpoint to resume from, the output is truncated and the run starts from the beginning
+ */
+bool checkpointOpenOutput(Checkpointer* checkpointer, const char* outputPath, bool resume, FILE* in, long long inputStart, FILE** out);
+
+// How many more verses can be written before the next checkpoint is due, or SIZE_MAX without checkpoints
+size_t checkpointVersesLeft(const Checkpointer* checkpointer);
+
+/* Record that a piece of input was scanned and its output was written to out. Every interval verses the output is flushed to
+ * disk and a new checkpoint replaces the old one, so a checkpoint never points past output that isn't actually stored
+ */
+bool checkpointAdvance(Checkpointer* checkpointer, FILE* out, long long inputBytes, long long outputBytes, BatchStats stats);
+
+// The run finished, so there's nothing to resume anymore: remove the checkpoint
+void checkpointFinish(Checkpointer* checkpointer);
@@ -0,0 +1,354 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "columnar.h"
+#ifndef _WIN32
+#    include <sys/mman.h>
+#endif
+
+#define COLUMNAR_MAGIC "DHCOL001"
+#define COLUMNAR_END_MAGIC "DHCOLEND"
+#define COLUMNAR_MAGIC_SIZE 8
+#define COLUMNAR_INDEX_ENTRY_SIZE 12
+#define COLUMNAR_TRAILER_SIZE (8 + COLUMNAR_MAGIC_SIZE)
+#define COLUMNAR_FOOTER_HEADER_SIZE (8 + 4 + 4 + 4)
+
+const char* columnNames[] = {
+    [COLUMN_PATTERN]       = "pattern",
+    [COLUMN_SYLLABLES]     = "syllables",
+    [COLUMN_STATUS]        = "status",
+    [COLUMN_KNOWN_MASK]    = "known",
+    [COLUMN_LONG_MASK]     = "long",
+    [COLUMN_SOURCE_OFFSET] = "offset",
+    [COLUMN_CAESURAE]      = "caesurae",
+    [COLUMN_METER]         = "meter",
+};
+static_assert(NOB_ARRAY_LEN(columnNames) == COUNT_COLUMNS, "Amount of columns have changed");
+
+typedef enum {
+    // Runs of the same value: a varint with the length of the run, then a varint with the value
+    ENCODING_RUN_LENGTH,
+    // Every value as a varint
+    ENCODING_VARINT,
+    // The difference with the previous value as a varint (the first one is relative to 0)
+    ENCODING_DELTA,
+} Encoding;
+
+// Pattern, syllables and status barely change from verse to verse. The known mask only changes with the amount of syllables
+static Encoding columnEncodings[] = {
+    [COLUMN_PATTERN]       = ENCODING_RUN_LENGTH,
+    [COLUMN_SYLLABLES]     = ENCODING_RUN_LENGTH,
+    [COLUMN_STATUS]        = ENCODING_RUN_LENGTH,
+    [COLUMN_KNOWN_MASK]    = ENCODING_RUN_LENGTH,
+    [COLUMN_LONG_MASK]     = ENCODING_VARINT,
+    [COLUMN_SOURCE_OFFSET] = ENCODING_DELTA,
+    [COLUMN_CAESURAE]      = ENCODING_RUN_LENGTH,
+    [COLUMN_METER]         = ENCODING_RUN_LENGTH,
+};
+static_assert(NOB_ARRAY_LEN(columnEncodings) == COUNT_COLUMNS, "Amount of columns have changed");
+
+void columnarPutVarint(Nob_String_Builder* sb, uint64_t value) {
+    while (value >= 0x80) {
+        nob_da_append(sb, (char) ((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    nob_da_append(sb, (char) value);
+}
+
+// Read a varint, returns false if it runs past the end
+bool columnarGetVarint(const uint8_t** data, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+        if (*data >= end) return false;
+        uint8_t byte = *(*data)++;
+        result |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void columnarPutLittleEndian(Nob_String_Builder* sb, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) nob_da_append(sb, (char) ((value >> (8*i)) & 0xFF));
+}
+
+uint64_t columnarGetLittleEndian(const uint8_t* data, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) value |= (uint64_t) data[i] << (8*i);
+    return value;
+}
+
+void columnarEncode(Encoding encoding, const uint64_t* values, size_t count, Nob_String_Builder* sb) {
+    switch (encoding) {
+    case ENCODING_RUN_LENGTH:
+        for (size_t i = 0; i < count;) {
+            size_t run = 1;
+            while (i + run < count && values[i + run] == values[i]) ++run;
+            columnarPutVarint(sb, run);
+            columnarPutVarint(sb, values[i]);
+            i += run;
+        }
+        break;
+    case ENCODING_VARINT:
+        for (size_t i = 0; i < count; ++i) columnarPutVarint(sb, values[i]);
+        break;
+    case ENCODING_DELTA: {
+        uint64_t previous = 0;
+        for (size_t i = 0; i < count; ++i) {
+            columnarPutVarint(sb, values[i] - previous);
+            previous = values[i];
+        }
+    } break;
+    }
+}
+
+bool columnarDecode(Encoding encoding, const uint8_t* data, size_t size, uint64_t* values, size_t count) {
+    const uint8_t* end = data + size;
+    switch (encoding) {
+    case ENCODING_RUN_LENGTH:
+        for (size_t i = 0; i < count;) {
+            uint64_t run, value;
+            if (!columnarGetVarint(&data, end, &run) || !columnarGetVarint(&data, end, &value)) return false;
+            if (run == 0 || run > count - i) return false;
+            for (uint64_t j = 0; j < run; ++j) values[i++] = value;
+        }
+        return true;
+    case ENCODING_VARINT:
+        for (size_t i = 0; i < count; ++i) {
+            if (!columnarGetVarint(&data, end, &values[i])) return false;
+        }
+        return true;
+    case ENCODING_DELTA: {
+        uint64_t previous = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t delta;
+            if (!columnarGetVarint(&data, end, &delta)) return false;
+            previous += delta;
+            values[i] = previous;
+        }
+    } return true;
+    }
+    return false;
+}
+
+bool columnarWriterOpen(ColumnarWriter* writer, const char* path) {
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    if (fwrite(COLUMNAR_MAGIC, 1, COLUMNAR_MAGIC_SIZE, writer->file) != COLUMNAR_MAGIC_SIZE) return false;
+    writer->position = COLUMNAR_MAGIC_SIZE;
+    return true;
+}
+
+// Compress the block that's being filled and write it, one column after the other
+bool columnarWriterFlushBlock(ColumnarWriter* writer) {
+    size_t count = writer->verseCount - writer->blockCount*COLUMNAR_BLOCK_VERSES;
+    if (count == 0) return true;
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) {
+        writer->encoded.count = 0;
+        columnarEncode(columnEncodings[column], writer->values[column], count, &writer->encoded);
+        if (fwrite(writer->encoded.items, 1, writer->encoded.count, writer->file) != writer->encoded.count) {
+            nob_log(NOB_ERROR, "Couldn't write the columnar file: %s", strerror(errno));
+            return false;
+        }
+        ColumnarBlock block = { .offset = writer->position, .size = writer->encoded.count };
+        nob_da_append(&writer->blocks[column], block);
+        writer->position += writer->encoded.count;
+    }
+    ++writer->blockCount;
+    return true;
+}
+
+bool columnarWriterAdd(ColumnarWriter* writer, const DhRecord* record, uint64_t sourceOffset) {
+    size_t index = writer->verseCount - writer->blockCount*COLUMNAR_BLOCK_VERSES;
+    writer->values[COLUMN_PATTERN][index] = record->footPattern;
+    writer->values[COLUMN_SYLLABLES][index] = record->syllableCount;
+    writer->values[COLUMN_STATUS][index] = record->status;
+    writer->values[COLUMN_KNOWN_MASK][index] = record->knownMask;
+    writer->values[COLUMN_LONG_MASK][index] = record->longMask;
+    writer->values[COLUMN_SOURCE_OFFSET][index] = sourceOffset;
+    writer->values[COLUMN_CAESURAE][index] = record->caesurae;
+    writer->values[COLUMN_METER][index] = record->meter;
+    ++writer->verseCount;
+    if (index + 1 == COLUMNAR_BLOCK_VERSES) return columnarWriterFlushBlock(writer);
+    return true;
+}
+
+bool columnarWriterClose(ColumnarWriter* writer) {
+    bool result = true;
+    if (!columnarWriterFlushBlock(writer)) nob_return_defer(false);
+
+    writer->encoded.count = 0;
+    uint64_t footerOffset = writer->position;
+    columnarPutLittleEndian(&writer->encoded, writer->verseCount, 8);
+    columnarPutLittleEndian(&writer->encoded, COLUMNAR_BLOCK_VERSES, 4);
+    columnarPutLittleEndian(&writer->encoded, COUNT_COLUMNS, 4);
+    columnarPutLittleEndian(&writer->encoded, writer->blockCount, 4);
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) {
+        for (size_t block = 0; block < writer->blockCount; ++block) {
+            columnarPutLittleEndian(&writer->encoded, writer->blocks[column].items[block].offset, 8);
+            columnarPutLittleEndian(&writer->encoded, writer->blocks[column].items[block].size, 4);
+        }
+    }
+    columnarPutLittleEndian(&writer->encoded, footerOffset, 8);
+    nob_sb_append_buf(&writer->encoded, COLUMNAR_END_MAGIC, COLUMNAR_MAGIC_SIZE);
+    if (fwrite(writer->encoded.items, 1, writer->encoded.count, writer->file) != writer->encoded.count) {
+        nob_log(NOB_ERROR, "Couldn't write the columnar file: %s", strerror(errno));
+        nob_return_defer(false);
+    }
+
+defer:
+    if (fclose(writer->file) != 0) result = false;
+    writer->file = NULL;
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) nob_da_free(writer->blocks[column]);
+    nob_sb_free(writer->encoded);
+    return result;
+}
+
+bool columnarReaderOpen(ColumnarReader* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) reader->cachedBlock[column] = -1;
+
+#ifdef _WIN32
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    reader->data = (const uint8_t*) sb.items;
+    reader->size = sb.count;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    reader->size = info.st_size;
+    if (reader->size > 0) {
+        void* data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            nob_log(NOB_ERROR, "Couldn't map %s: %s", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        reader->data = data;
+    }
+    close(fd);
+#endif
+
+    // Check the magic numbers at both ends and find the footer
+    const uint8_t* data = reader->data;
+    if (reader->size < COLUMNAR_MAGIC_SIZE + COLUMNAR_FOOTER_HEADER_SIZE + COLUMNAR_TRAILER_SIZE ||
+        memcmp(data, COLUMNAR_MAGIC, COLUMNAR_MAGIC_SIZE) != 0 ||
+        memcmp(data + reader->size - COLUMNAR_MAGIC_SIZE, COLUMNAR_END_MAGIC, COLUMNAR_MAGIC_SIZE) != 0) {
+        goto invalid;
+    }
+    uint64_t footerOffset = columnarGetLittleEndian(data + reader->size - COLUMNAR_TRAILER_SIZE, 8);
+    if (footerOffset > reader->size - COLUMNAR_TRAILER_SIZE - COLUMNAR_FOOTER_HEADER_SIZE) goto invalid;
+    const uint8_t* footer = data + footerOffset;
+    reader->verseCount = columnarGetLittleEndian(footer, 8);
+    reader->blockVerses = columnarGetLittleEndian(footer + 8, 4);
+    reader->columnCount = columnarGetLittleEndian(footer + 12, 4);
+    reader->blockCount = columnarGetLittleEndian(footer + 16, 4);
+    reader->index = footer + COLUMNAR_FOOTER_HEADER_SIZE;
+    if (reader->columnCount < COLUMN_CAESURAE || reader->columnCount > COUNT_COLUMNS || reader->blockVerses != COLUMNAR_BLOCK_VERSES ||
+        (uint64_t) reader->blockCount*reader->blockVerses < reader->verseCount ||
+        (uint64_t) reader->columnCount*reader->blockCount*COLUMNAR_INDEX_ENTRY_SIZE > reader->size - COLUMNAR_TRAILER_SIZE - footerOffset - COLUMNAR_FOOTER_HEADER_SIZE) {
+        goto invalid;
+    }
+    return true;
+
+invalid:
+    nob_log(NOB_ERROR, "%s isn't a valid columnar file", path);
+    columnarReaderClose(reader);
+    return false;
+}
+
+void columnarReaderClose(ColumnarReader* reader) {
+#ifdef _WIN32
+    free((void*) reader->data);
+#else
+    if (reader->data != NULL) munmap((void*) reader->data, reader->size);
+#endif
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) free(reader->cache[column]);
+    memset(reader, 0, sizeof(*reader));
+}
+
+size_t columnarReadBlock(const ColumnarReader* reader, Column column, size_t block, uint64_t* values) {
+    if (block >= reader->blockCount || column >= reader->columnCount) return 0;
+    const uint8_t* entry = reader->index + (column*reader->blockCount + block)*COLUMNAR_INDEX_ENTRY_SIZE;
+    uint64_t offset = columnarGetLittleEndian(entry, 8);
+    uint32_t size = columnarGetLittleEndian(entry + 8, 4);
+    if (offset > reader->size || size > reader->size - offset) return 0;
+
+    uint64_t count = reader->verseCount - (uint64_t) block*reader->blockVerses;
+    if (count > reader->blockVerses) count = reader->blockVerses;
+    if (!columnarDecode(columnEncodings[column], reader->data + offset, size, values, count)) return 0;
+    return count;
+}
+
+// Get a value from a column, decoding (and caching) its block if it isn't decoded already
+bool columnarReaderValue(ColumnarReader* reader, Column column, uint64_t n, uint64_t* value) {
+    size_t block = n/reader->blockVerses;
+    if (reader->cachedBlock[column] != (int64_t) block) {
+        if (reader->cache[column] == NULL) {
+            reader->cache[column] = malloc(COLUMNAR_BLOCK_VERSES*sizeof(uint64_t));
+            NOB_ASSERT(reader->cache[column] != NULL && "Buy more RAM lol");
+        }
+        if (columnarReadBlock(reader, column, block, reader->cache[column]) == 0) {
+            reader->cachedBlock[column] = -1;
+            return false;
+        }
+        reader->cachedBlock[column] = block;
+    }
+    *value = reader->cache[column][n%reader->blockVerses];
+    return true;
+}
+
+bool columnarReaderGet(ColumnarReader* reader, uint64_t n, ColumnarRow* row) {
+    if (n >= reader->verseCount) {
+        nob_log(NOB_ERROR, "There are only %llu verses", (unsigned long long) reader->verseCount);
+        return false;
+    }
+    uint64_t values[COUNT_COLUMNS];
+    for (size_t column = 0; column < COUNT_COLUMNS; ++column) {
+        values[column] = 0;
+        if (column < reader->columnCount && !columnarReaderValue(reader, column, n, &values[column])) return false;
+    }
+    row->record = (DhRecord) {
+        .status = values[COLUMN_STATUS],
+        .syllableCount = values[COLUMN_SYLLABLES],
+        .footPattern = values[COLUMN_PATTERN],
+        .caesurae = values[COLUMN_CAESURAE],
+        .meter = values[COLUMN_METER],
+        .knownMask = values[COLUMN_KNOWN_MASK],
+        .longMask = values[COLUMN_LONG_MASK],
+    };
+    row->sourceOffset = values[COLUMN_SOURCE_OFFSET];
+    return true;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+/* A file that stores the records of a lot of verses column by column. Every column is split into blocks of
+ * COLUMNAR_BLOCK_VERSES verses that are compressed on their own, and a footer at the end of the file says where every
+ * block is. That way a reader can get one verse or go through one column without decoding anything else.
+ *
+ * Layout (all numbers are little-endian):
+ *     "DHCOL001"
+ *     the blocks
+ *     footer: u64 verse count, u32 verses per block, u32 column count, u32 block count,
+ *             then for every column, for every block: u64 offset, u32 size
+ *     u64 offset of the footer, "DHCOLEND"
+ */
+
+#pragma once
+#include "nob.h"
+#include "records.h"
+
+#define COLUMNAR_BLOCK_VERSES 4096
+
+typedef enum {
+    COLUMN_PATTERN,
+    COLUMN_SYLLABLES,
+    COLUMN_STATUS,
+    COLUMN_KNOWN_MASK,
+    COLUMN_LONG_MASK,
+    // Where the verse starts in the input
+    COLUMN_SOURCE_OFFSET,
+    // Files written before these columns were added don't have them, and read as 0
+    COLUMN_CAESURAE,
+    COLUMN_METER,
+    COUNT_COLUMNS,
+} Column;
+
+extern const char* columnNames[];
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+} ColumnarBlock;
+
+typedef struct {
+    ColumnarBlock* items;
+    size_t count;
+    size_t capacity;
+} ColumnarBlocks;
+
+typedef struct ColumnarWriter {
+    FILE* file;
+    uint64_t position;
+    uint64_t verseCount;
+    // The values of the block that's being filled
+    uint64_t values[COUNT_COLUMNS][COLUMNAR_BLOCK_VERSES];
+    size_t blockCount;
+    ColumnarBlocks blocks[COUNT_COLUMNS];
+    Nob_String_Builder encoded;
+} ColumnarWriter;
+
+bool columnarWriterOpen(ColumnarWriter* writer, const char* path);
+bool columnarWriterAdd(ColumnarWriter* writer, const DhRecord* record, uint64_t sourceOffset);
+// Write the last block and the footer, and close the file
+bool columnarWriterClose(ColumnarWriter* writer);
+
+typedef struct {
+    DhRecord record;
+    uint64_t sourceOffset;
+} ColumnarRow;
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    uint64_t verseCount;
+    uint32_t blockVerses;
+    uint32_t blockCount;
+    // The amount of columns in the file, which is less than COUNT_COLUMNS for older files
+    uint32_t columnCount;
+    // Points into the footer: columnCount*blockCount entries of 12 bytes
+    const uint8_t* index;
+    // The last decoded block of every column, so reading verses that are close together only decodes once
+    uint64_t* cache[COUNT_COLUMNS];
+    int64_t cachedBlock[COUNT_COLUMNS];
+} ColumnarReader;
+
+// Map a columnar file into memory (or read it, where mapping isn't available)
+bool columnarReaderOpen(ColumnarReader* reader, const char* path);
+void columnarReaderClose(ColumnarReader* reader);
+
+/* Decode one block of one column into values, which needs room for COLUMNAR_BLOCK_VERSES values.
+ * Returns the amount of values in the block, or 0 if it's invalid
+ */
+size_t columnarReadBlock(const ColumnarReader* reader, Column column, size_t block, uint64_t* values);
+
+// Get verse n, only decoding the blocks it's in
+bool columnarReaderGet(ColumnarReader* reader, uint64_t n, ColumnarRow* row);
@@ -20,29 +20,41 @@
 // SOFTWARE.
 
 #include "dactylichexameter.h"
-
-// A dynamic array of String Views, to be able to easily split/chop them
-typedef struct {
-    Nob_String_View* items;
-    size_t count;
-    size_t capacity;
-} ChoppedStringView;
-
-// Split a string into a ChoppedStringView: a dynamic array of String Views
-ChoppedStringView chopString(const char* string, char delim) {
-    ChoppedStringView result = {0};
+#include "scansion.h"
+#include "unicode.h"
+#include "kernels.h"
+#include "lexicon.h"
+#include "suffix.h"
+#include "memory.h"
+#include "ngram.h"
+
+// What it costs to make a vowel before another vowel long. It's nearly always short, but not quite
+#define COST_VOWEL_BEFORE_VOWEL 5
+// What it costs to make a vowel before a muta cum liquida short. Either is fine, so it only breaks ties
+#define COST_MUTA_CUM_LIQUIDA_SHORT 1
+// What it costs to go against the quantity the ending of a word usually has. The meter easily overrules it
+#define COST_SUFFIX_QUANTITY 2
+// What it costs to go against the quantity a word had in the verses that were scanned before
+#define COST_MEMORY_QUANTITY 3
+// What it costs to give a syllable the length the n-gram model finds unlikely, when nothing else decided it
+#define COST_NGRAM_UNLIKELY 1
+// The n-gram model only has an opinion when the chance of a long syllable is this far from even (out of 255)
+#define NGRAM_MIN_LEAN 64
+
+// Split a string into a ChoppedStringView: a dynamic array of String Views. result is cleared first
+void chopString(const char* string, char delim, ChoppedStringView* result) {
+    result->count = 0;
     Nob_String_View sv = nob_sv_from_cstr(string);
     Nob_String_View item;
     while (sv.count > 0) {
         item = nob_sv_chop_by_delim(&sv, delim);
-        nob_da_append(&result, item);
+        nob_da_append(result, item);
     }
-    return result;
 }
 
-// Strip out all of the empty items in the ChoppedStringView and trim it at the same time
-ChoppedStringView trimChoppedString(const ChoppedStringView csv) {
-    ChoppedStringView result = {0};
+// Strip out all of the empty items in the ChoppedStringView and trim it at the same time. result is cleared first
+void trimChoppedString(const ChoppedStringView csv, ChoppedStringView* result) {
+    result->count = 0;
     for (size_t i = 0; i < csv.count; ++i) {
         Nob_String_View sv = csv.items[i];
 
@@ -60,19 +72,25 @@ ChoppedStringView trimChoppedString(const ChoppedStringView csv) {
         }
         Nob_String_View svTrimmed = nob_sv_from_parts(svTrimmedLeft.data, svTrimmedLeft.count - i);
 
-        if (svTrimmed.count > 0) nob_da_append(&result, svTrimmed);
+        if (svTrimmed.count > 0) nob_da_append(result, svTrimmed);
     }
-    return result;
 }
 
-// Convert a string to lowercase
-char* strLower(const char* string) {
-    Nob_String_Builder lower = {0};
-    for (size_t i = 0; string[i]; i++) {
-        nob_da_append(&lower, tolower(string[i]));
-    }
-    nob_sb_append_null(&lower);
-    return lower.items;
+// Make sure a string builder has room for at least size bytes, so a kernel can write into it directly
+void reserveString(Nob_String_Builder* sb, size_t size) {
+    if (size <= sb->capacity) return;
+    if (sb->capacity == 0) sb->capacity = NOB_DA_INIT_CAP;
+    while (size > sb->capacity) sb->capacity *= 2;
+    sb->items = NOB_REALLOC(sb->items, sb->capacity);
+    NOB_ASSERT(sb->items != NULL && "Buy more RAM lol");
+}
+
+// Convert a string to lowercase, into a string builder that is cleared first. The result is NULL-terminated
+void strLowerInto(const char* string, Nob_String_Builder* lower) {
+    size_t len = strlen(string);
+    reserveString(lower, len + 1);
+    kernels->lower(string, len, lower->items);
+    lower->count = len + 1;
 }
 
 // A list of all vowels in Latin
@@ -98,13 +116,26 @@ bool isVowel(const char* string, const size_t index) {
     return false;
 }
 
+// The liquids, as bits in mutaCumLiquida
+#define LIQUID_L (1u << ('l' - 'a'))
+#define LIQUID_R (1u << ('r' - 'a'))
+
+// For every consonant, the letters (bit n is 'a' + n) it forms a muta cum liquida with: a stop (or 'f') and a liquid
+static const uint32_t mutaCumLiquida[256] = {
+    ['b'] = LIQUID_L | LIQUID_R,
+    ['c'] = LIQUID_L | LIQUID_R,
+    ['d'] = LIQUID_L | LIQUID_R,
+    ['f'] = LIQUID_L | LIQUID_R,
+    ['g'] = LIQUID_L | LIQUID_R,
+    ['k'] = LIQUID_L | LIQUID_R,
+    ['p'] = LIQUID_L | LIQUID_R,
+    ['t'] = LIQUID_L | LIQUID_R,
+};
 
-// A dynamic array of integers
-typedef struct {
-    int* items;
-    size_t count;
-    size_t capacity;
-} DynamicArrayInt;
+// Check if two letters are a stop followed by a liquid, like "tr" or "cl"
+bool isMutaCumLiquida(char first, char second) {
+    return second >= 'a' && second <= 'z' && (mutaCumLiquida[(unsigned char) first] >> (second - 'a')) & 1;
+}
 
 // Check if a DynamicArrayInt contains a certain value
 bool daIntContains(DynamicArrayInt daInt, int query) {
@@ -140,9 +171,12 @@ static int diphthongExceptionWordStartIndices[] = {
 
 // Check if two characters are a diphthong
 bool isDiphthong(const char* string, const size_t index, const DynamicArrayInt spacePositions) {
-    size_t stringLen = strlen(string);
+    // Two vowels in different words never make a diphthong
+    if (daIntContains(spacePositions, index + 1)) return false;
     for (size_t j = 0; j < NOB_ARRAY_LEN(diphthongs); ++j) {
         if (string[index] == diphthongs[j][0] && string[index + 1] == diphthongs[j][1]) {
+            // Only a diphthong needs the length, to check for the exception words
+            size_t stringLen = strlen(string);
             for (size_t k = 0; k < NOB_ARRAY_LEN(diphthongExceptionWords); ++k) {
                 const size_t diphthongExceptionLen = strlen(diphthongExceptionWords[k]);
                 const size_t exceptionStartIndex = index - diphthongExceptionWordStartIndices[k];
@@ -168,17 +202,104 @@ bool isDiphthong(const char* string, const size_t index, const DynamicArrayInt s
 
 
 
-char* dhStripLine(const char* string) {
-    Nob_String_Builder sb = {0};
-    for (size_t i = 0; i < strlen(string); ++i) {
+// Like dhStripLine, but into a string builder that is cleared first, and the string has to be ASCII already
+void stripLineInto(const char* string, Nob_String_Builder* sb) {
+    size_t len = strlen(string);
+    reserveString(sb, len + 1);
+    sb->count = kernels->strip(string, len, false, sb->items, NULL) + 1;
+}
+
+// Keep the marks of the characters stripLineInto keeps. result is cleared first, and stays empty if marks is empty
+void stripMarksInto(const char* string, const DhMarks* marks, DhMarks* result) {
+    result->count = 0;
+    if (marks->count == 0) return;
+    for (size_t i = 0; i < marks->count; ++i) {
         if (isalpha(string[i]) && !isspace(string[i])) {
-            nob_da_append(&sb, string[i]);
+            nob_da_append(result, marks->items[i]);
         }
     }
-    nob_sb_append_null(&sb);
+}
+
+/* Decode a line into ascii if it isn't plain ASCII already, and return the ASCII line. The marks on its letters go
+ * into marks, which is left empty if there aren't any
+ */
+const char* normalizeLine(const char* line, Nob_String_Builder* ascii, DhMarks* marks) {
+    marks->count = 0;
+    if (unicodeIsAscii(line, strlen(line))) return line;
+    unicodeNormalize(line, ascii, marks);
+    return ascii->items;
+}
+
+char* dhStripLine(const char* string) {
+    Nob_String_Builder sb = {0};
+    Nob_String_Builder ascii = {0};
+    DhMarks marks = {0};
+    stripLineInto(normalizeLine(string, &ascii, &marks), &sb);
+    nob_sb_free(ascii);
+    nob_da_free(marks);
     return sb.items;
 }
 
+static const char* statusNames[] = {
+    [DH_OK]                 = "OK",
+    [DH_INCOMPLETE]         = "Couldn't completely number the metra",
+    [DH_EMPTY_VERSE]        = "Empty verse",
+    [DH_TOO_FEW_SYLLABLES]  = "Too few dactyli",
+    [DH_TOO_MANY_SYLLABLES] = "Too many dactyli",
+};
+static_assert(NOB_ARRAY_LEN(statusNames) == COUNT_DH_STATUSES, "Amount of statuses have changed");
+
+const char* dhStatusName(DhStatus status) {
+    if (status >= COUNT_DH_STATUSES) return "Unknown status";
+    return statusNames[status];
+}
+
+const char* dhMeterName(DhMeter meter) {
+    if (meter >= COUNT_DH_METERS) return "unknown";
+    return scansionMeters[meter].name;
+}
+
+bool dhMeterFromName(const char* name, DhMeter* meter) {
+    for (size_t i = 0; i < COUNT_DH_METERS; ++i) {
+        if (strcmp(scansionMeters[i].name, name) == 0) {
+            *meter = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check if a verse with a certain amount of syllables gets scanned as a meter, with the meter (or meters) ctx is set to
+bool meterCandidate(const DhContext* ctx, DhMeter meter, size_t amountOfSyllables) {
+    if (!ctx->detectMeter) return meter == ctx->meter;
+    return amountOfSyllables >= scansionMeters[meter].minSyllables && amountOfSyllables <= scansionMeters[meter].maxSyllables;
+}
+
+// The fewest and the most syllables a verse can have with the meter (or meters) ctx is set to
+void meterSyllableRange(const DhContext* ctx, size_t* minSyllables, size_t* maxSyllables) {
+    *minSyllables = scansionMeters[ctx->meter].minSyllables;
+    *maxSyllables = scansionMeters[ctx->meter].maxSyllables;
+    if (!ctx->detectMeter) return;
+    for (size_t meter = 0; meter < COUNT_DH_METERS; ++meter) {
+        if (scansionMeters[meter].minSyllables < *minSyllables) *minSyllables = scansionMeters[meter].minSyllables;
+        if (scansionMeters[meter].maxSyllables > *maxSyllables) *maxSyllables = scansionMeters[meter].maxSyllables;
+    }
+}
+
+void dhContextFree(DhContext* ctx) {
+    nob_sb_free(ctx->normalized);
+    nob_da_free(ctx->marks);
+    nob_sb_free(ctx->lower);
+    nob_da_free(ctx->words);
+    nob_da_free(ctx->trimmedWords);
+    nob_sb_free(ctx->elision);
+    nob_sb_free(ctx->line);
+    nob_da_free(ctx->spacePositions);
+    nob_da_free(ctx->lineMarks);
+    nob_da_free(ctx->vowelPositions);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
 char getCharOrJ(const size_t index, const char* str, const size_t len) {
     if (
         str[index] == 'i' &&
@@ -195,24 +316,90 @@ char getCharOrJ(const size_t index, const char* str, const size_t len) {
     return str[index];
 }
 
-bool dhElision(const char* line, Nob_String_Builder* sb) {
-    bool result = true;
-    // Clear the result string builder
+// Check if a word is one of the words where 'ei' isn't a diphthong
+bool isDiphthongExceptionWord(Nob_String_View word) {
+    for (size_t i = 0; i < NOB_ARRAY_LEN(diphthongExceptionWords); ++i) {
+        if (nob_sv_eq(word, nob_sv_from_cstr(diphthongExceptionWords[i]))) return true;
+    }
+    return false;
+}
+
+// Check if a 'u' could also be read as a consonant ('v'), like in "silua" or "uirum"
+bool isConsonantalUCandidate(Nob_String_View word, size_t index) {
+    if (word.data[index] != 'u' || index + 1 >= word.count || !isVowel(word.data, index + 1)) return false;
+    if (index == 0) return true;
+    // A 'u' after a 'q' already isn't a vowel, and a 'u' at the end of a diphthong stays a vowel
+    DynamicArrayInt daIntEmpty = {0};
+    return word.data[index - 1] != 'q' && !isDiphthong(word.data, index - 1, daIntEmpty);
+}
+
+// The mark on a letter of a word in ctx->lower, from the last elide call
+DhMark letterMark(const DhContext* ctx, Nob_String_View word, size_t index) {
+    if (ctx->marks.count == 0) return DH_MARK_NONE;
+    return ctx->marks.items[word.data + index - ctx->lower.items];
+}
+
+// The mark on a letter of ctx->line, from the last syllabify call
+DhMark lineMark(const DhContext* ctx, size_t index) {
+    if (ctx->lineMarks.count == 0) return DH_MARK_NONE;
+    return ctx->lineMarks.items[index];
+}
+
+// Take the next choice for the reading of a verse. Returns true if flips says to read it the other way
+bool readingChoice(DhContext* ctx, DhReadingKind kind, uint32_t flips) {
+    if (ctx->choiceCount >= DH_MAX_READING_CHOICES) return false;
+    ctx->choices[ctx->choiceCount] = kind;
+    return (flips >> ctx->choiceCount++) & 1;
+}
+
+/* Add a word to sb the way it's read, without its 'h's. Only the first size characters are added, but the choices in the
+ * rest are still taken, so the choices after this word are numbered the same way whether or not it's elided
+ */
+void appendWordReading(DhContext* ctx, Nob_String_View word, size_t size, uint32_t flips, Nob_String_Builder* sb) {
+    DynamicArrayInt daIntEmpty = {0};
+    for (size_t i = 0; i < word.count; ++i) {
+        // A vowel with a diaeresis is always a vowel of its own
+        DhMark mark = letterMark(ctx, word, i);
+        char chr = mark == DH_MARK_DIAERESIS ? word.data[i] : getCharOrJ(i, word.data, word.count);
+        bool split = false;
+        if (chr == 'j') {
+            if (readingChoice(ctx, DH_READING_CONSONANTAL_I, flips)) chr = 'i';
+        } else if (mark != DH_MARK_DIAERESIS && isConsonantalUCandidate(word, i)) {
+            if (readingChoice(ctx, DH_READING_CONSONANTAL_U, flips)) chr = 'v';
+        } else if (
+            chr == 'e' && i + 1 < word.count && (word.data[i + 1] == 'i' || word.data[i + 1] == 'u') &&
+            letterMark(ctx, word, i + 1) != DH_MARK_DIAERESIS &&
+            !isDiphthongExceptionWord(word) && isDiphthong(word.data, i, daIntEmpty)
+        ) {
+            // A space between the two vowels stops the scanner from seeing a diphthong
+            split = readingChoice(ctx, DH_READING_DIPHTHONG, flips);
+        }
+        if (i >= size || chr == 'h') continue;
+        // Put the mark back on a vowel, so the scanner still sees it
+        if (mark != DH_MARK_NONE && isVowel(&chr, 0)) unicodeAppendMarked(sb, chr, mark);
+        else nob_da_append(sb, chr);
+        if (split) nob_da_append(sb, ' ');
+    }
+}
+
+// Perform elision on a line into sb, using the buffers in ctx. flips says which choices to read the other way (see DhReadingKind)
+DhStatus elide(DhContext* ctx, const char* line, Nob_String_Builder* sb, uint32_t flips) {
+    // Clear the result string builder and the choices
     sb->count = 0;
+    ctx->choiceCount = 0;
     // Chop the line by spaces and trim it
-    ChoppedStringView temp = chopString(strLower(line), ' ');
-    ChoppedStringView choppedLine = trimChoppedString(temp);
+    strLowerInto(normalizeLine(line, &ctx->normalized, &ctx->marks), &ctx->lower);
+    chopString(ctx->lower.items, ' ', &ctx->words);
+    trimChoppedString(ctx->words, &ctx->trimmedWords);
+    ChoppedStringView choppedLine = ctx->trimmedWords;
 
     // If the line contains 0 words, fail
-    if (choppedLine.count == 0) {
-        nob_log(NOB_ERROR, "Empty verse");
-        nob_return_defer(false);
-    }
+    if (choppedLine.count == 0) return DH_EMPTY_VERSE;
 
     // If there's only one word, you can just return, elision can't happen on just one word
     if (choppedLine.count < 2) {
         nob_sb_append_cstr(sb, line);
-        nob_return_defer(true);
+        return DH_OK;
     }
 
     DynamicArrayInt daIntEmpty = {0};
@@ -222,22 +409,20 @@ bool dhElision(const char* line, Nob_String_Builder* sb) {
         Nob_String_View word = choppedLine.items[i];
         // Check if the words ends with a vowel or an 'm'
         bool endsWithVowel = word.data[word.count - 1] == 'm' || isVowel(word.data, word.count - 1);
-        if (!endsWithVowel) {
-            // If not, just add the word to the string buffer and continue
-            for (size_t i = 0; i < word.count; ++i) {
-                if (word.data[i] != 'h')
-                    nob_da_append(sb, getCharOrJ(i, word.data, word.count));
-            }
-            nob_da_append(sb, ' ');
-            continue;
-        }
 
         Nob_String_View nextWord = choppedLine.items[i + 1];
         // Check if the next word begins with a vowel or an 'h'
         bool beginsWithVowel = nextWord.data[0] == 'h' || (getCharOrJ(0, nextWord.data, nextWord.count) != 'j' && isVowel(nextWord.data, 0));
-        if (beginsWithVowel) {
-            // If so, perform elision
+        // A diaeresis on either of the vowels forces hiatus
+        if (
+            letterMark(ctx, word, word.count - (word.data[word.count - 1] == 'm' ? 2 : 1)) == DH_MARK_DIAERESIS ||
+            letterMark(ctx, nextWord, nextWord.data[0] == 'h' ? 1 : 0) == DH_MARK_DIAERESIS
+        ) {
+            endsWithVowel = false;
+        }
 
+        // Perform elision, unless the reading says to keep the vowel (hiatus)
+        if (endsWithVowel && beginsWithVowel && !readingChoice(ctx, DH_READING_ELISION, flips)) {
             size_t size = word.count;
             // Remove the 'm' from the word
             if (word.data[size - 1] == 'm') --size;
@@ -247,171 +432,259 @@ bool dhElision(const char* line, Nob_String_Builder* sb) {
             --size;
 
             // Add the truncated word to the string builder
-            for (size_t i = 0; i < size; ++i) {
-                if (word.data[i] != 'h')
-                    nob_da_append(sb, getCharOrJ(i, word.data, word.count));
-            }
+            appendWordReading(ctx, word, size, flips, sb);
             // Add extra spaces to the string builder to keep it the same length
             for (size_t _ = 1; _ < word.count - size; ++_) nob_da_append(sb, ' ');
         } else {
-            // If not, just add the line to the string builder
-            for (size_t i = 0; i < word.count; ++i) {
-                if (word.data[i] != 'h')
-                    nob_da_append(sb, getCharOrJ(i, word.data, word.count));
-            }
+            // If not, just add the word to the string builder
+            appendWordReading(ctx, word, word.count, flips, sb);
         }
         // Add a space to seperate the words
         nob_da_append(sb, ' ');
     }
     // Add the last word to the string builder
     Nob_String_View word = choppedLine.items[choppedLine.count - 1];
-    nob_sb_append_buf(sb, word.data, word.count);
+    appendWordReading(ctx, word, word.count, flips, sb);
+    return DH_OK;
+}
 
-defer:
-    // Some cleanup that may or may not actually be neccessary
-    nob_da_free(temp);
-    nob_da_free(choppedLine);
-    return result;
+DhStatus dhElisionContext(DhContext* ctx, const char* line) {
+    DhStatus status = elide(ctx, line, &ctx->elision, 0);
+    nob_sb_append_null(&ctx->elision);
+    return status;
 }
 
-// Define the minimum and maximum amount of syllables/dactyli
-// Lowest amount of dactyli: _ _   _ _   _ _   _ _   _ uu  _ _ (13 dactyli)
-// Lowest amount of dactyli: _ uu  _ uu  _ uu  _ uu  _ uu  _ _ (17 dactyli)
-#define MIN_SYLLABLES 13
-#define MAX_SYLLABLES 17
-
-// Assign numbers to the syllables, and optionally log a warning if too few were assigned
-size_t numberMetra(char* syllableNumbers, char* syllableLengths, size_t amountOfSyllables, bool shouldWarn) {
-    // Clear the syllableNumbers array (it should always have a length of 17, so no buffer overflows should happen)
-    memset(syllableNumbers, ' ', MAX_SYLLABLES);
-    size_t syllableNumberIndex = 0;
-    size_t addedNumbers = 0;
-    for (size_t i = 1; i <= 6; ++i) {
-        // Don't add this number if it landed on a short syllable, because the first syllable in a group cannot be short
-        if (syllableLengths[syllableNumberIndex] == 'u')
-            break;
-        // Set the number character (ASCII 0x3.)
-        syllableNumbers[syllableNumberIndex] = (char) i + 0x30;
-        ++addedNumbers;
-        // Skip the appropriate amount of syllables
-        if (syllableNumberIndex < amountOfSyllables - 1 && syllableLengths[syllableNumberIndex + 1] == 'u')
-            syllableNumberIndex += 3;
-        else if (syllableNumberIndex < amountOfSyllables - 1 && syllableLengths[syllableNumberIndex + 1] == '_')
-            syllableNumberIndex += 2;
-        else
-            break;
+bool dhElision(const char* line, Nob_String_Builder* sb) {
+    DhContext ctx = {0};
+    DhStatus status = elide(&ctx, line, sb, 0);
+    dhContextFree(&ctx);
+    if (status != DH_OK) {
+        nob_log(NOB_ERROR, "%s", dhStatusName(status));
+        return false;
     }
+    return true;
+}
 
-    // If the numbering didn't comlete, try from the other side too
-    if (addedNumbers < 6) {
-        syllableNumberIndex = amountOfSyllables - 2;
-        for (size_t i = 6; i >= 1; --i) {
-            // Don't add this number if it landed on a short syllable, because the first syllable in a group cannot be short
-            if (syllableLengths[syllableNumberIndex] == 'u')
-                break;
-            // Set the number character (ASCII 0x3.)
-            syllableNumbers[syllableNumberIndex] = (char) i + 0x30;
-            ++addedNumbers;
-            // Skip the appropriate amount of syllables
-            if (syllableNumberIndex > 0 && syllableLengths[syllableNumberIndex - 1] == 'u')
-                syllableNumberIndex -= 3;
-            else if (syllableNumberIndex > 0 && syllableLengths[syllableNumberIndex - 1] == '_')
-                syllableNumberIndex -= 2;
-            else
-                break;
-        }
-    }
-    
-    // Log a warning if you're told to do so
-    if (shouldWarn && addedNumbers < 6) {
-        nob_log(NOB_WARNING, "Couldn't completely number the metra due to some missing dactyli. You've either");
-        nob_log(NOB_WARNING, "entered an invalid verse or there are rules this program doesn't account for (yet)");
-    }
+// How the length of a neighbour is encoded to look up a neighbour rule
+#define NEIGHBOUR_UNKNOWN 0
+#define NEIGHBOUR_LONG    1
+#define NEIGHBOUR_SHORT   2
+// Before the first or after the last syllable
+#define NEIGHBOUR_NONE    3
+
+// The length the rules force on an unknown syllable with these neighbours (two before it and two after it), or '?'
+#define NEIGHBOUR_RULE(p2, p1, n1, n2) ( \
+    ((p1) == NEIGHBOUR_LONG && (n1) == NEIGHBOUR_LONG) ||   /* _ ? _ */ \
+    ((p2) == NEIGHBOUR_SHORT && (p1) == NEIGHBOUR_SHORT) || /* u u ? */ \
+    ((n1) == NEIGHBOUR_SHORT && (n2) == NEIGHBOUR_SHORT)    /* ? u u */ \
+        ? '_' : \
+    ((p2) == NEIGHBOUR_LONG && (p1) == NEIGHBOUR_SHORT) ||  /* _ u ? */ \
+    ((n1) == NEIGHBOUR_SHORT && (n2) == NEIGHBOUR_LONG)     /* ? u _ */ \
+        ? 'u' : '?')
+#define NEIGHBOUR_RULES_N2(p2, p1, n1) \
+    NEIGHBOUR_RULE(p2, p1, n1, 0), NEIGHBOUR_RULE(p2, p1, n1, 1), NEIGHBOUR_RULE(p2, p1, n1, 2), NEIGHBOUR_RULE(p2, p1, n1, 3)
+#define NEIGHBOUR_RULES_N1(p2, p1) \
+    NEIGHBOUR_RULES_N2(p2, p1, 0), NEIGHBOUR_RULES_N2(p2, p1, 1), NEIGHBOUR_RULES_N2(p2, p1, 2), NEIGHBOUR_RULES_N2(p2, p1, 3)
+#define NEIGHBOUR_RULES_P1(p2) \
+    NEIGHBOUR_RULES_N1(p2, 0), NEIGHBOUR_RULES_N1(p2, 1), NEIGHBOUR_RULES_N1(p2, 2), NEIGHBOUR_RULES_N1(p2, 3)
+
+// Every neighbour rule worked out by the compiler, indexed by the four neighbours as base 4 digits: p2 p1 n1 n2
+static const char neighbourRules[256] = {
+    NEIGHBOUR_RULES_P1(0), NEIGHBOUR_RULES_P1(1), NEIGHBOUR_RULES_P1(2), NEIGHBOUR_RULES_P1(3),
+};
 
-    // Return the amount of numbers that were filled in
-    return addedNumbers;
+size_t neighbourCode(const char* syllableLengths, size_t amountOfSyllables, size_t i, int offset) {
+    if ((offset < 0 && i < (size_t) -offset) || i + offset >= amountOfSyllables) return NEIGHBOUR_NONE;
+    switch (syllableLengths[i + offset]) {
+    case '_': return NEIGHBOUR_LONG;
+    case 'u': return NEIGHBOUR_SHORT;
+    default:  return NEIGHBOUR_UNKNOWN;
+    }
 }
 
-void makeMetraStartLong(char* syllableNumbers, char* syllableLengths, size_t amountOfSyllables, bool shouldWarn) {
-    numberMetra(syllableNumbers, syllableLengths, amountOfSyllables, shouldWarn);
-
-    // Go through the syllables and make the ones that have a number assigned to them long, because they're at the start of a metrum
+/* Fill in every length the neighbour rules imply. Only the syllables around one that changed get looked at again,
+ * until nothing changes anymore
+ */
+void propagateNeighbourRules(char* syllableLengths, size_t amountOfSyllables) {
+    // A syllable is never on the worklist twice, so it can't hold more than all of them
+    size_t worklist[MAX_SYLLABLES];
+    bool queued[MAX_SYLLABLES] = {0};
+    size_t count = 0;
     for (size_t i = 0; i < amountOfSyllables; ++i) {
-        if (syllableNumbers[i] == ' ' || syllableLengths[i] != '?') continue;
-        syllableLengths[i] = '_';
+        if (syllableLengths[i] != '?') continue;
+        worklist[count++] = i;
+        queued[i] = true;
+    }
+
+    while (count > 0) {
+        size_t i = worklist[--count];
+        queued[i] = false;
+
+        size_t index = neighbourCode(syllableLengths, amountOfSyllables, i, -2)*64 +
+                       neighbourCode(syllableLengths, amountOfSyllables, i, -1)*16 +
+                       neighbourCode(syllableLengths, amountOfSyllables, i, 1)*4 +
+                       neighbourCode(syllableLengths, amountOfSyllables, i, 2);
+        if (neighbourRules[index] == '?') continue;
+        syllableLengths[i] = neighbourRules[index];
+
+        for (size_t j = i >= 2 ? i - 2 : 0; j <= i + 2 && j < amountOfSyllables; ++j) {
+            if (syllableLengths[j] != '?' || queued[j]) continue;
+            worklist[count++] = j;
+            queued[j] = true;
+        }
     }
 }
 
-bool dhScan(const char* unstrippedLine, Nob_String_Builder* sbNumbers, Nob_String_Builder* sbScan, Nob_String_Builder* sbStrippedLine) {
-    // Clear all the string builders
-    sbNumbers->count = 0;
-    sbScan->count = 0;
-    sbStrippedLine->count = 0;
+/* Turn the word from start to end in ctx->line into the key the lexicon and the word memory know it by: without 'h's,
+ * and with 'i' and 'u' instead of 'j' and 'v'. lineIndices gets where every letter of the key is in the line.
+ * Returns the length of the key, or 0 if the word is too long
+ */
+size_t wordKey(const DhContext* ctx, size_t start, size_t end, char* key, size_t* lineIndices) {
+    size_t keyLen = 0;
+    for (size_t i = start; i < end; ++i) {
+        char chr = ctx->line.items[i];
+        if (chr == 'h') continue;
+        if (keyLen == LEXICON_MAX_WORD) return 0;
+        key[keyLen] = chr == 'j' ? 'i' : chr == 'v' ? 'u' : chr;
+        lineIndices[keyLen++] = i;
+    }
+    return keyLen;
+}
 
-    // Strip the line and make it lowercase
-    const char* line = strLower(dhStripLine(unstrippedLine));
+// Look up the word from start to end in ctx->line in the lexicon, and mark its vowels, except the ones the line marks itself
+void markLexiconWord(DhContext* ctx, size_t start, size_t end) {
+    char key[LEXICON_MAX_WORD];
+    size_t lineIndices[LEXICON_MAX_WORD];
+    size_t keyLen = wordKey(ctx, start, end, key, lineIndices);
+    uint32_t longMask, shortMask;
+    if (!lexiconLookup(ctx->lexicon, key, keyLen, &longMask, &shortMask) || (longMask | shortMask) == 0) return;
+
+    // Only now that there's something to mark, make room for the marks of the whole line
+    if (ctx->lineMarks.count == 0) {
+        size_t len = ctx->line.count - 1;
+        while (ctx->lineMarks.count < len) nob_da_append(&ctx->lineMarks, DH_MARK_NONE);
+    }
+    for (size_t i = 0; i < keyLen; ++i) {
+        uint8_t* mark = &ctx->lineMarks.items[lineIndices[i]];
+        if (*mark != DH_MARK_NONE) continue;
+        if ((longMask >> i) & 1) *mark = DH_MARK_LONG;
+        else if ((shortMask >> i) & 1) *mark = DH_MARK_SHORT;
+    }
+}
 
+// Mark the vowels of every word of ctx->line that's in the lexicon. The words are between the space positions
+void markLexiconWords(DhContext* ctx) {
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    size_t len = ctx->line.count - 1;
+    size_t nextSpace = 0;
+    size_t start = 0;
+    while (start < len) {
+        while (nextSpace < spacePositions->count && (size_t) spacePositions->items[nextSpace] <= start) ++nextSpace;
+        size_t end = nextSpace < spacePositions->count ? (size_t) spacePositions->items[nextSpace] : len;
+        markLexiconWord(ctx, start, end);
+        start = end;
+    }
+}
 
-    // Detect where spaces or special characters were in the original unstripped line
-    DynamicArrayInt spacePositions = {0};
+/* Strip the line into ctx, find where the word boundaries were, and find the syllables. Returns the amount of syllables,
+ * but only the positions of the first MAX_SYLLABLES are recorded, and only they are in wordEndMask
+ */
+size_t syllabify(DhContext* ctx, const char* unstrippedLine, size_t* syllablePositions, uint32_t* wordEndMask) {
+    // Decode UTF-8 and keep the marks of the letters, then strip the line and make it lowercase
+    unstrippedLine = normalizeLine(unstrippedLine, &ctx->normalized, &ctx->marks);
+    stripMarksInto(unstrippedLine, &ctx->marks, &ctx->lineMarks);
+    // Detect where spaces or special characters were in the original unstripped line at the same time
+    ctx->spacePositions.count = 0;
+    DynamicArrayInt* spacePositions = &ctx->spacePositions;
     size_t unstrippedLen = strlen(unstrippedLine);
-    size_t strippedLineIndex = 0;
-    for (size_t i = 0; i < unstrippedLen; ++i) {
-        char chr = unstrippedLine[i];
-        if (!isalpha(chr) || isspace(chr)) {
-            nob_da_append(&spacePositions, strippedLineIndex);
-            // Skip over all the whitespace
-           while (i < unstrippedLen && (!isalpha(unstrippedLine[i]) || isspace(unstrippedLine[i]))) ++i;
-           --i;
-        } else {
-            ++strippedLineIndex;
-        }
-    }
+    reserveString(&ctx->line, unstrippedLen + 1);
+    size_t len = kernels->strip(unstrippedLine, unstrippedLen, true, ctx->line.items, spacePositions);
+    ctx->line.count = len + 1;
+    const char* line = ctx->line.items;
+    if (ctx->lexicon != NULL) markLexiconWords(ctx);
 
+    ctx->vowelPositions.count = 0;
+    kernels->vowels(line, len, &ctx->vowelPositions);
+    const DynamicArrayInt* vowelPositions = &ctx->vowelPositions;
 
-    size_t len = strlen(line);
     size_t amountOfSyllables = 0;
-    // Create a list of syllable positions and initialise it at -1
-    size_t syllablePositions[MAX_SYLLABLES] = {0};
+    // Initialise the list of syllable positions at -1
     memset(syllablePositions, -1, MAX_SYLLABLES*sizeof(size_t));
+    *wordEndMask = 0;
+    size_t nextSpace = 0;
     // Count the syllables (dactyli in Latin) and record their positions in the line
-    for (size_t i = 0; i < len; ++i) {
-        if (isVowel(line, i)) {
-            syllablePositions[amountOfSyllables] = i;
-            ++amountOfSyllables;
-
-            // Check for too many syllables
-            if (amountOfSyllables > MAX_SYLLABLES) {
-                nob_log(NOB_ERROR, "Too many dactyli: %lld", amountOfSyllables);
-                return false;
-            }
+    for (size_t v = 0; v < vowelPositions->count; ++v) {
+        size_t i = vowelPositions->items[v];
+        ++amountOfSyllables;
+        if (amountOfSyllables <= MAX_SYLLABLES) syllablePositions[amountOfSyllables - 1] = i;
+
+        // If a word starts between the previous syllable and this one, the previous syllable ends a word
+        bool wordStarted = false;
+        while (nextSpace < spacePositions->count && (size_t) spacePositions->items[nextSpace] <= i) {
+            wordStarted = true;
+            ++nextSpace;
+        }
+        if (wordStarted && amountOfSyllables >= 2 && amountOfSyllables - 2 < MAX_SYLLABLES) *wordEndMask |= 1u << (amountOfSyllables - 2);
 
-            // Check for diphthongs and skip the next vowel if one is found
-            if (i != len - 1 && isVowel(line, i + 1) && isDiphthong(line, i, spacePositions)) {
-                i++;
-            }
+        // Check for diphthongs and skip the next vowel if one is found
+        if (
+            v + 1 < vowelPositions->count && (size_t) vowelPositions->items[v + 1] == i + 1 &&
+            lineMark(ctx, i + 1) != DH_MARK_DIAERESIS && isDiphthong(line, i, *spacePositions)
+        ) {
+            v++;
         }
     }
+    // The last syllable always ends a word
+    if (amountOfSyllables >= 1 && amountOfSyllables <= MAX_SYLLABLES) *wordEndMask |= 1u << (amountOfSyllables - 1);
+    return amountOfSyllables;
+}
 
-    // Check for too few syllables
-    if (amountOfSyllables < MIN_SYLLABLES) {
-        nob_log(NOB_ERROR, "Too few dactyli: %lld", amountOfSyllables);
-        return false;
+/* Lean towards the quantities the ending of every word usually has (like the long 'a' of "-arum"), for the syllables
+ * that nothing else decided yet
+ */
+void suffixCosts(DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, DhSyllableCost* costs) {
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    size_t len = ctx->line.count - 1;
+    size_t syllable = 0;
+    size_t start = 0;
+    for (size_t nextSpace = 0; nextSpace <= spacePositions->count && syllable < amountOfSyllables; ++nextSpace) {
+        size_t end = nextSpace < spacePositions->count ? (size_t) spacePositions->items[nextSpace] : len;
+        if (end <= start) continue;
+        uint8_t longMask, shortMask;
+        size_t suffixLength = suffixMatch(ctx->line.items + start, end - start, &longMask, &shortMask);
+        start = end;
+        for (; syllable < amountOfSyllables && syllablePositions[syllable] < end; ++syllable) {
+            size_t lineIndex = syllablePositions[syllable];
+            if (lineIndex + suffixLength < end || lineMark(ctx, lineIndex) != DH_MARK_NONE) continue;
+            uint8_t bit = 1 << (lineIndex + suffixLength - end);
+            DhSyllableCost* cost = &costs[syllable];
+            if ((longMask & bit) && cost->cost[DH_SHORT] < COST_SUFFIX_QUANTITY) cost->cost[DH_SHORT] = COST_SUFFIX_QUANTITY;
+            else if ((shortMask & bit) && cost->cost[DH_SHORT] == 0 && cost->cost[DH_LONG] == 0) cost->cost[DH_LONG] = COST_SUFFIX_QUANTITY;
+        }
     }
+}
 
-    // Create a list of the characters to indicate the pronounciation of syllables. Initialise it with question marks
-    char syllableLengths[MAX_SYLLABLES] = {0};
-    memset(syllableLengths, '?', MAX_SYLLABLES);
-    // Use (sometimes way too complicated) rules to determine lengths of syllables
+// Give the syllables the costs that follow from the letters after their vowels: diphthongs, hiatus and position
+void ruleCosts(const DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, DhSyllableCost* costs) {
+    const char* line = ctx->line.items;
+    size_t len = ctx->line.count - 1;
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    memset(costs, 0, amountOfSyllables*sizeof(*costs));
     for (size_t i = 0; i < amountOfSyllables; ++i) {
         size_t lineIndex = syllablePositions[i];
-        // Check for a diphthong
+        // Check for a diphthong, and otherwise a vowel before a vowel is (nearly always) short
         if (lineIndex < len - 1 && isVowel(line, lineIndex + 1)) {
-            if (isDiphthong(line, lineIndex, spacePositions)) {
-                syllableLengths[i] = '_';
-                continue;
-            }
-            syllableLengths[i] = 'u';
+            if (lineMark(ctx, lineIndex + 1) != DH_MARK_DIAERESIS && isDiphthong(line, lineIndex, *spacePositions))
+                costs[i].cost[DH_SHORT] = DH_COST_FORBIDDEN;
+            else
+                costs[i].cost[DH_LONG] = COST_VOWEL_BEFORE_VOWEL;
+            continue;
+        }
+
+        // A stop followed by a liquid in the same word (like "patris") can make the syllable long or leave it short,
+        // so leave it up to the meter, only leaning towards long when the meter doesn't care
+        if (lineIndex < len - 2 && isMutaCumLiquida(line[lineIndex + 1], line[lineIndex + 2]) && !daIntContains(*spacePositions, lineIndex + 2)) {
+            costs[i].cost[DH_SHORT] = COST_MUTA_CUM_LIQUIDA_SHORT;
             continue;
         }
 
@@ -421,144 +694,583 @@ bool dhScan(const char* unstrippedLine, Nob_String_Builder* sbNumbers, Nob_Strin
             (lineIndex < len - 2 && !isVowel(line, lineIndex + 1) && !isVowel(line, lineIndex + 2) && !(line[lineIndex + 1] == 'q' && line[lineIndex + 2] == 'u')) || // stupid 'qu'
             (lineIndex < len - 3 && line[lineIndex + 1] == 'q' && line[lineIndex + 2] == 'u' && !isVowel(line, lineIndex + 3))
         ) {
-            syllableLengths[i] = '_';
+            costs[i].cost[DH_SHORT] = DH_COST_FORBIDDEN;
             continue;
         }
+    }
+}
 
-        // The things that are always true
-        // TODO: what to do in the rare occasions that the 5th metrum is _ _ instead of _ u u
-        if (i == 0 || i == amountOfSyllables - 5 || i == amountOfSyllables - 2 || i == amountOfSyllables - 1) {
-            syllableLengths[i] = '_';
-            continue;
-        }
-        if (i == amountOfSyllables - 4 || i == amountOfSyllables - 3) {
-            syllableLengths[i] = 'u';
-            continue;
+/* Lean towards the quantities the word memory has for the words of the verse, over the ones of their endings. Vowels
+ * the verse (or the lexicon) marks itself are left alone
+ */
+void memoryCosts(DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, DhSyllableCost* costs) {
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    size_t len = ctx->line.count - 1;
+    size_t syllable = 0;
+    size_t start = 0;
+    for (size_t nextSpace = 0; nextSpace <= spacePositions->count && syllable < amountOfSyllables; ++nextSpace) {
+        size_t end = nextSpace < spacePositions->count ? (size_t) spacePositions->items[nextSpace] : len;
+        if (end <= start) continue;
+        char key[LEXICON_MAX_WORD];
+        size_t lineIndices[LEXICON_MAX_WORD];
+        size_t keyLen = wordKey(ctx, start, end, key, lineIndices);
+        uint32_t longMask = 0, shortMask = 0;
+        bool known = memoryLookup(ctx->memory, key, keyLen, &longMask, &shortMask);
+        start = end;
+
+        size_t letter = 0;
+        for (; syllable < amountOfSyllables && syllablePositions[syllable] < end; ++syllable) {
+            size_t lineIndex = syllablePositions[syllable];
+            if (!known || lineMark(ctx, lineIndex) != DH_MARK_NONE) continue;
+            while (lineIndices[letter] < lineIndex) ++letter;
+            int* cost = costs[syllable].cost;
+            if (((longMask >> letter) & 1) && cost[DH_LONG] < DH_COST_FORBIDDEN) {
+                cost[DH_LONG] = 0;
+                if (cost[DH_SHORT] < COST_MEMORY_QUANTITY) cost[DH_SHORT] = COST_MEMORY_QUANTITY;
+            } else if (((shortMask >> letter) & 1) && cost[DH_SHORT] < DH_COST_FORBIDDEN) {
+                cost[DH_SHORT] = 0;
+                if (cost[DH_LONG] < COST_MEMORY_QUANTITY) cost[DH_LONG] = COST_MEMORY_QUANTITY;
+            }
         }
     }
+}
 
-    // Create a list of the characters to indicate where a new metrum begins and the how-manieth it is
-    char syllableNumbers[MAX_SYLLABLES] = {0};
-
-    // Check for patterns that force a particular length to be used (thrice, just in case)
-    for (size_t _n = 0; _n < 3; ++_n) {
-        // "Fix" the syllables by numbering the metra and putting a '_' at the first part of every metrum
-        makeMetraStartLong(syllableNumbers, syllableLengths, amountOfSyllables, false);
-
-        // Check for patterns that force a specific length at a specific place
-        for (size_t i = 1; i < amountOfSyllables - 1; ++i) {
-            if (syllableLengths[i] != '?') continue;
-
-            // Patterns that force a long syllable
-            if (
-                (syllableLengths[i - 1] == '_' && syllableLengths[i + 1] == '_') ||                             // _ ? _
-                (i >= 2 && syllableLengths[i - 2] == 'u' && syllableLengths[i - 1] == 'u') ||                   // u u ?
-                (i < amountOfSyllables - 2 && syllableLengths[i + 1] == 'u' && syllableLengths[i + 2] == 'u')   // ? u u
-            ) {
-                syllableLengths[i] = '_';
+/* Teach the word memory the quantities of the vowels in a verse that scanned completely. Only the syllables whose length
+ * doesn't depend on the consonants after them say something about their vowel, and the last syllable of the verse
+ * can be either length, so that says nothing at all. A syllable the memory already leaned towards its length (see
+ * memoryCosts) only agrees with the memory because of that, so it isn't learned again, but the word is still counted as
+ * seen. Going against it counts as a conflict
+ */
+void learnWordQuantities(DhContext* ctx, const DhVerse* verse) {
+    size_t amountOfSyllables = verse->syllableCount;
+    if (verse->status != DH_OK || amountOfSyllables == 0 || amountOfSyllables > MAX_SYLLABLES) return;
+    if ((verse->longMask | verse->shortMask) != (1u << amountOfSyllables) - 1) return;
+    DhSyllableCost costs[MAX_SYLLABLES];
+    ruleCosts(ctx, verse->syllablePositions, amountOfSyllables, costs);
+
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    size_t len = ctx->line.count - 1;
+    size_t syllable = 0;
+    size_t start = 0;
+    for (size_t nextSpace = 0; nextSpace <= spacePositions->count && syllable < amountOfSyllables; ++nextSpace) {
+        size_t end = nextSpace < spacePositions->count ? (size_t) spacePositions->items[nextSpace] : len;
+        if (end <= start) continue;
+        char key[LEXICON_MAX_WORD];
+        size_t lineIndices[LEXICON_MAX_WORD];
+        size_t keyLen = wordKey(ctx, start, end, key, lineIndices);
+        start = end;
+        // What the memory made the scan lean towards, if anything
+        uint32_t leanLong = 0, leanShort = 0;
+        if (!memoryLookup(ctx->memory, key, keyLen, &leanLong, &leanShort)) leanLong = leanShort = 0;
+
+        uint32_t longMask = 0, shortMask = 0;
+        bool agreed = false;
+        size_t letter = 0;
+        for (; syllable < amountOfSyllables && verse->syllablePositions[syllable] < end; ++syllable) {
+            size_t lineIndex = verse->syllablePositions[syllable];
+            if (keyLen == 0 || syllable == amountOfSyllables - 1 || costs[syllable].cost[DH_SHORT] != 0) continue;
+            while (lineIndices[letter] < lineIndex) ++letter;
+            bool isLong = (verse->longMask >> syllable) & 1;
+            if (lineMark(ctx, lineIndex) == DH_MARK_NONE && (((isLong ? leanLong : leanShort) >> letter) & 1)) {
+                agreed = true;
                 continue;
             }
+            if (isLong) longMask |= 1u << letter;
+            else shortMask |= 1u << letter;
+        }
+        if ((longMask | shortMask) != 0)
+            memoryLearn(ctx->memory, key, keyLen, longMask, shortMask);
+        else if (agreed)
+            memoryConfirm(ctx->memory, key, keyLen);
+    }
+}
 
-            // Patterns that force a short one
-            if (
-                // (syllableLengths[i - 1] == 'u' && syllableLengths[i + 1] == '_') ||                             // u ? _
-                (i >= 2 && syllableLengths[i - 2] == '_' && syllableLengths[i - 1] == 'u') ||                   // _ u ?
-                (i < amountOfSyllables - 2 && syllableLengths[i + 1] == 'u' && syllableLengths[i + 2] == '_')   // ? u _
-            ) {
-                syllableLengths[i] = 'u';
-                continue;
-            }
+// What comes after the vowel of a syllable, checked the same way as ruleCosts does
+NgramFollow syllableFollow(const DhContext* ctx, size_t lineIndex) {
+    const char* line = ctx->line.items;
+    size_t len = ctx->line.count - 1;
+    if (lineIndex + 1 >= len) return NGRAM_FOLLOW_END;
+    if (isVowel(line, lineIndex + 1)) return NGRAM_FOLLOW_VOWEL;
+    if (lineIndex < len - 2 && isMutaCumLiquida(line[lineIndex + 1], line[lineIndex + 2]) && !daIntContains(ctx->spacePositions, lineIndex + 2))
+        return NGRAM_FOLLOW_MUTA_CUM_LIQUIDA;
+    if (
+        line[lineIndex + 1] == 'x' ||
+        (lineIndex < len - 2 && !isVowel(line, lineIndex + 2) && !(line[lineIndex + 1] == 'q' && line[lineIndex + 2] == 'u')) ||
+        (lineIndex < len - 3 && line[lineIndex + 1] == 'q' && line[lineIndex + 2] == 'u' && !isVowel(line, lineIndex + 3))
+    ) {
+        return NGRAM_FOLLOW_MORE;
+    }
+    return NGRAM_FOLLOW_ONE;
+}
 
-            // A way too complicated pattern to force a short one (it's also probably redundant because of the check after these for loops)
-            if (
-                // n     n+1
-                // _ ? ? _
-                (i < amountOfSyllables - 2 && syllableLengths[i - 1] == '_' && syllableLengths[i + 2] == '_' &&
-                    syllableNumbers[i - 1] + 1 == syllableNumbers[i + 2])
-            ) {
-                syllableLengths[i] = 'u';
-                continue;
+// Find the context every syllable of the last syllabify call has in the n-gram model
+void syllableContexts(const DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, uint16_t* contexts) {
+    const char* line = ctx->line.items;
+    size_t len = ctx->line.count - 1;
+    const DynamicArrayInt* spacePositions = &ctx->spacePositions;
+    size_t nextSpace = 0;
+    size_t wordStart = 0;
+    for (size_t i = 0; i < amountOfSyllables; ++i) {
+        size_t lineIndex = syllablePositions[i];
+        while (nextSpace < spacePositions->count && (size_t) spacePositions->items[nextSpace] <= lineIndex) {
+            wordStart = spacePositions->items[nextSpace++];
+        }
+        size_t wordEnd = nextSpace < spacePositions->count ? (size_t) spacePositions->items[nextSpace] : len;
+        bool first = i == 0 || syllablePositions[i - 1] < wordStart;
+        bool last = i + 1 == amountOfSyllables || syllablePositions[i + 1] >= wordEnd;
+        NgramWordPosition position = first ? (last ? NGRAM_WORD_ONLY : NGRAM_WORD_FIRST) : (last ? NGRAM_WORD_LAST : NGRAM_WORD_MIDDLE);
+
+        NgramNucleus nucleus;
+        if (lineIndex + 1 < len && isVowel(line, lineIndex + 1) && lineMark(ctx, lineIndex + 1) != DH_MARK_DIAERESIS && isDiphthong(line, lineIndex, *spacePositions)) {
+            nucleus = NGRAM_NUCLEUS_DIPHTHONG;
+            ++lineIndex;
+        } else {
+            switch (line[lineIndex]) {
+            case 'a': nucleus = NGRAM_NUCLEUS_A; break;
+            case 'e': nucleus = NGRAM_NUCLEUS_E; break;
+            case 'i': nucleus = NGRAM_NUCLEUS_I; break;
+            case 'o': nucleus = NGRAM_NUCLEUS_O; break;
+            case 'y': nucleus = NGRAM_NUCLEUS_Y; break;
+            default:  nucleus = NGRAM_NUCLEUS_U; break;
             }
         }
+        contexts[i] = ngramContext(nucleus, syllableFollow(ctx, lineIndex), position);
     }
+}
 
+// Break the ties between lengths nothing else decided with the n-gram model
+void ngramCosts(DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, DhSyllableCost* costs) {
+    uint16_t contexts[MAX_SYLLABLES];
+    syllableContexts(ctx, syllablePositions, amountOfSyllables, contexts);
+    for (size_t i = 0; i < amountOfSyllables; ++i) {
+        int* cost = costs[i].cost;
+        if (cost[DH_LONG] != 0 || cost[DH_SHORT] != 0) continue;
+        int chance = ngramLongChance(ctx->ngram, contexts[i], i == 0 ? NGRAM_START : contexts[i - 1]);
+        if (chance >= 128 + NGRAM_MIN_LEAN) cost[DH_SHORT] = COST_NGRAM_UNLIKELY;
+        else if (chance < 128 - NGRAM_MIN_LEAN) cost[DH_LONG] = COST_NGRAM_UNLIKELY;
+    }
+}
 
-    bool shouldAllBeShort = false;
+size_t dhSyllableContexts(DhContext* ctx, const char* line, size_t* syllablePositions, uint16_t* contexts) {
+    uint32_t wordEndMask;
+    size_t amountOfSyllables = syllabify(ctx, line, syllablePositions, &wordEndMask);
+    syllableContexts(ctx, syllablePositions, amountOfSyllables < MAX_SYLLABLES ? amountOfSyllables : MAX_SYLLABLES, contexts);
+    return amountOfSyllables;
+}
 
+// Use the rules to decide what each length costs for every syllable of the last syllabify call. Where the meter puts the syllables is up to the automaton
+void syllableCosts(DhContext* ctx, const size_t* syllablePositions, size_t amountOfSyllables, DhSyllableCost* costs) {
+    ruleCosts(ctx, syllablePositions, amountOfSyllables, costs);
+    // A vowel marked long makes the syllable long. A vowel marked short makes it short, unless the consonants after it
+    // already make it long (or could, with muta cum liquida)
+    for (size_t i = 0; i < amountOfSyllables && ctx->lineMarks.count > 0; ++i) {
+        DhMark mark = lineMark(ctx, syllablePositions[i]);
+        if (mark == DH_MARK_LONG) costs[i].cost[DH_SHORT] = DH_COST_FORBIDDEN;
+        else if (mark == DH_MARK_SHORT && costs[i].cost[DH_SHORT] == 0) costs[i].cost[DH_LONG] = DH_COST_FORBIDDEN;
+    }
+    suffixCosts(ctx, syllablePositions, amountOfSyllables, costs);
+    if (ctx->memory != NULL) memoryCosts(ctx, syllablePositions, amountOfSyllables, costs);
+    if (ctx->ngram != NULL) ngramCosts(ctx, syllablePositions, amountOfSyllables, costs);
+    if (ctx->hint != NULL) ctx->hint(ctx->hintData, ctx->line.items, syllablePositions, amountOfSyllables, costs);
+}
 
-    // Count the amount of long syllables
-    size_t amountOfLongSyllables = 0;
+/* Find the caesurae by putting the places where they would be (after a certain syllable of a certain metrum) in a mask
+ * and intersecting that with the word ends
+ */
+uint8_t findCaesurae(const ScansionMeter* meter, const char* syllableNumbers, uint8_t footPattern, uint32_t wordEndMask, size_t amountOfSyllables) {
+    // Where every metrum starts, or -1 if it wasn't numbered
+    int footStarts[SCANSION_MAX_FEET] = {-1, -1, -1, -1, -1, -1};
     for (size_t i = 0; i < amountOfSyllables; ++i) {
-        if (syllableLengths[i] == '_') ++amountOfLongSyllables;
+        if (syllableNumbers[i] >= '1' && syllableNumbers[i] < '1' + SCANSION_MAX_FEET) footStarts[syllableNumbers[i] - '1'] = i;
     }
 
-    size_t amountOfShortSyllablesThereShouldBe = (amountOfSyllables - 12) * 2;
-    size_t amountOfLongSyllablesThereShouldBe = amountOfSyllables - amountOfShortSyllablesThereShouldBe;
+    uint32_t places[COUNT_DH_CAESURAE] = {0};
+    for (size_t caesura = 0; caesura < COUNT_DH_CAESURAE; ++caesura) {
+        int foot = meter->caesuraFeet[caesura];
+        if (foot < 0 || footStarts[foot] < 0) continue;
+        switch ((DhCaesura) caesura) {
+        case DH_CAESURA_PENTHEMIMERAL:
+        case DH_CAESURA_HEPHTHEMIMERAL:
+            places[caesura] = 1u << footStarts[foot];
+            break;
+        case DH_CAESURA_TROCHAIC:
+            if (footPattern & (1u << foot)) places[caesura] = 1u << (footStarts[foot] + 1);
+            break;
+        case DH_DIAERESIS_BUCOLIC:
+            if (footStarts[foot] >= 1) places[caesura] = 1u << (footStarts[foot] - 1);
+            break;
+        case COUNT_DH_CAESURAE:
+            NOB_UNREACHABLE("findCaesurae");
+        }
+    }
 
-    if (amountOfLongSyllables == amountOfLongSyllablesThereShouldBe) {
-        shouldAllBeShort = true;
+    uint8_t caesurae = 0;
+    for (size_t caesura = 0; caesura < COUNT_DH_CAESURAE; ++caesura) {
+        if (wordEndMask & places[caesura]) caesurae |= 1u << caesura;
     }
+    return caesurae;
+}
 
+DhStatus dhScanVerse(DhContext* ctx, const char* unstrippedLine, DhVerse* verse) {
+    memset(verse, 0, sizeof(*verse));
+    verse->meter = ctx->meter;
+    size_t* syllablePositions = verse->syllablePositions;
+    size_t amountOfSyllables = syllabify(ctx, unstrippedLine, syllablePositions, &verse->wordEndMask);
+    verse->syllableCount = amountOfSyllables;
 
-    // Number the metra to prepare for the next part
-    size_t amountOfNumberedMetra = numberMetra(syllableNumbers, syllableLengths, amountOfSyllables, false);
+    // Check for too many syllables, after counting all of them so it's clear how many too many there are
+    size_t minSyllables, maxSyllables;
+    meterSyllableRange(ctx, &minSyllables, &maxSyllables);
+    if (amountOfSyllables > maxSyllables) return verse->status = DH_TOO_MANY_SYLLABLES;
 
-    // Count the amount of unknown lengths
-    size_t amountOfUnknownLengths = 0;
-    for (size_t i = 0; i < amountOfSyllables; ++i) {
-        if (syllableLengths[i] == '?') ++amountOfUnknownLengths;
-    }
-
-    // If the amount of numbered metra and the amount of unknown lengths match up in a certain way, they should all be short
-    // Here is an example:
-    //  1                3          4     5      6
-    //  _   ? ?  _   ? ? _    _     _  _  _ u u  _  _
-    //
-    // 5 metra were numbered, so the weird calculation (6 - 5) * 2 + 2 = 4
-    // The amount of unknown lengths is also 4, so this means the unknown lengths can't be long,
-    // because there would be too many metra
-    //
-    // This doesn't work:
-    // 1                            5       6
-    // _  ?  ? ?  ? ?    ? _   ? ?  _ u  u  _  _
-    // ipsa canas oro." Finem dedit ore loquendi.
-    // 
-    // 3 metra were numbered, (6 - 3) * 2 + 2 = 8, there are 8 dactyli unknown. Not all of them should be short.
-    // TODO: solve this issue
-    if ((6 - amountOfNumberedMetra) * 2 + 2 == amountOfUnknownLengths) {
-        shouldAllBeShort = true;
-    }
-    
-
-    if (shouldAllBeShort) {
+    // Check for too few syllables
+    if (amountOfSyllables < minSyllables) return verse->status = DH_TOO_FEW_SYLLABLES;
+
+    DhSyllableCost costs[MAX_SYLLABLES];
+    syllableCosts(ctx, syllablePositions, amountOfSyllables, costs);
+
+    // Find the cheapest scansions in every meter that's being tried, and keep the meter that fits best
+    ScansionResult scansion;
+    bool solved = false;
+    bool found = false;
+    for (DhMeter meter = 0; meter < COUNT_DH_METERS; ++meter) {
+        if (!meterCandidate(ctx, meter, amountOfSyllables)) continue;
+        ScansionResult candidate;
+        bool candidateSolved = scansionSolve(&scansionMeters[meter].automaton, costs, amountOfSyllables, &candidate);
+        if (found && ((solved && !candidateSolved) || (solved == candidateSolved && candidate.cost >= scansion.cost))) continue;
+        found = true;
+        solved = candidateSolved;
+        scansion = candidate;
+        verse->meter = meter;
+    }
+    if (!found) return verse->status = amountOfSyllables < scansionMeters[ctx->meter].minSyllables ? DH_TOO_FEW_SYLLABLES : DH_TOO_MANY_SYLLABLES;
+    const ScansionMeter* meter = &scansionMeters[verse->meter];
+
+    // The syllables the cheapest scansions don't agree on stay unknown
+    char* syllableLengths = verse->syllableLengths;
+    char* syllableNumbers = verse->syllableNumbers;
+    memset(syllableLengths, '?', MAX_SYLLABLES);
+    for (size_t i = 0; i < amountOfSyllables; ++i) verse->longProbability[i] = scansion.longProbability[i];
+    for (size_t i = 0; i < NOB_ARRAY_LEN(verse->dactylProbability); ++i) verse->dactylProbability[i] = scansion.dactylProbability[i];
+    if (solved) {
+        memcpy(syllableLengths, scansion.lengths, MAX_SYLLABLES);
+        verse->alternativeCount = scansion.alternativeCount;
+        memcpy(verse->alternatives, scansion.alternatives, sizeof(verse->alternatives));
+    } else {
+        // Every scansion breaks a rule, so only show what the rules say on their own, the things that are always true
+        // (or nearly, like a dactyl in the fifth metrum of a hexameter), and what follows from those for the neighbouring syllables
+        size_t endingLength = strlen(meter->ending);
         for (size_t i = 0; i < amountOfSyllables; ++i) {
-            if (syllableLengths[i] == '?') syllableLengths[i] = 'u';
+            if (costs[i].cost[DH_LONG] < costs[i].cost[DH_SHORT]) syllableLengths[i] = '_';
+            else if (costs[i].cost[DH_SHORT] < costs[i].cost[DH_LONG]) syllableLengths[i] = 'u';
+            else if (i + endingLength >= amountOfSyllables) syllableLengths[i] = meter->ending[i + endingLength - amountOfSyllables];
+            else if (i == 0) syllableLengths[i] = '_';
         }
+        propagateNeighbourRules(syllableLengths, amountOfSyllables);
     }
 
     // Put the syllable numbers in the correct spots
-    numberMetra(syllableNumbers, syllableLengths, amountOfSyllables, true);
+    verse->status = scansionNumber(&meter->automaton, syllableLengths, amountOfSyllables, syllableNumbers) < meter->footCount || !solved ? DH_INCOMPLETE : DH_OK;
+
+    // Summarise the lengths as bit masks and the metra as a foot pattern
+    for (size_t i = 0; i < amountOfSyllables; ++i) {
+        if (syllableLengths[i] == '_') verse->longMask |= 1u << i;
+        if (syllableLengths[i] == 'u') verse->shortMask |= 1u << i;
+        if (syllableNumbers[i] >= '1' && syllableNumbers[i] <= '5' && i + 1 < amountOfSyllables && syllableLengths[i + 1] == 'u')
+            verse->footPattern |= 1u << (syllableNumbers[i] - '1');
+    }
+    verse->caesurae = findCaesurae(meter, syllableNumbers, verse->footPattern, verse->wordEndMask, amountOfSyllables);
+
+    return verse->status;
+}
+
+// At most this many choices are read the other way when looking for a reading that fits
+#define READING_MAX_CHANGES 3
+
+// What reading a choice the other way costs, on top of the cost of the scansion
+static const int readingCosts[] = {
+    [DH_READING_ELISION]       = 3,
+    [DH_READING_DIPHTHONG]     = 3,
+    [DH_READING_CONSONANTAL_I] = 3,
+    [DH_READING_CONSONANTAL_U] = 2,
+};
+static_assert(NOB_ARRAY_LEN(readingCosts) == COUNT_DH_READINGS, "Amount of readings have changed");
+
+// How many syllables reading a choice the other way adds
+static const int readingSyllables[] = {
+    [DH_READING_ELISION]       = 1,
+    [DH_READING_DIPHTHONG]     = 1,
+    [DH_READING_CONSONANTAL_I] = 1,
+    [DH_READING_CONSONANTAL_U] = -1,
+};
+static_assert(NOB_ARRAY_LEN(readingSyllables) == COUNT_DH_READINGS, "Amount of readings have changed");
+
+typedef struct {
+    DhContext* ctx;
+    const char* line;
+    DhVerse verse;
+    DhReadingKind choices[DH_MAX_READING_CHOICES];
+    size_t choiceCount;
+    // The most syllables the choices from a certain one on can add or take away
+    int maxAdded[DH_MAX_READING_CHOICES + 1];
+    int maxRemoved[DH_MAX_READING_CHOICES + 1];
+    // The range of syllables the meter (or meters) can have
+    size_t minSyllables;
+    size_t maxSyllables;
+    // Stop at the first reading that fits, and don't scan it
+    bool checkOnly;
+    bool found;
+    uint32_t bestFlips;
+    int bestCost;
+} ReadingSearch;
+
+// Check if a verse fits the meter: it has a scansion that doesn't break any hard rules
+bool verseFits(const DhVerse* verse) {
+    return (verse->status == DH_OK || verse->status == DH_INCOMPLETE) && verse->alternativeCount > 0;
+}
+
+/* The same as verseFits after dhScanVerse, but without finding the scansion: only count the syllables, give them their
+ * costs and check if the automaton can get through them
+ */
+bool lineFits(DhContext* ctx, const char* unstrippedLine, size_t* amountOfSyllables) {
+    size_t syllablePositions[MAX_SYLLABLES];
+    uint32_t wordEndMask;
+    *amountOfSyllables = syllabify(ctx, unstrippedLine, syllablePositions, &wordEndMask);
+    size_t minSyllables, maxSyllables;
+    meterSyllableRange(ctx, &minSyllables, &maxSyllables);
+    if (*amountOfSyllables < minSyllables || *amountOfSyllables > maxSyllables) return false;
+
+    DhSyllableCost costs[MAX_SYLLABLES];
+    syllableCosts(ctx, syllablePositions, *amountOfSyllables, costs);
+    for (DhMeter meter = 0; meter < COUNT_DH_METERS; ++meter) {
+        if (meterCandidate(ctx, meter, *amountOfSyllables) && scansionFeasible(&scansionMeters[meter].automaton, costs, *amountOfSyllables)) return true;
+    }
+    return false;
+}
+
+/* Go through the readings, one choice at a time, depth first. A branch is cut off once it can't get the amount of
+ * syllables in range anymore, or once it costs more than the best reading so far
+ */
+void searchReadings(ReadingSearch* search, size_t choice, uint32_t flips, int syllables, int cost, size_t changes) {
+    if (search->found && (search->checkOnly || cost >= search->bestCost)) return;
+    if (syllables + search->maxAdded[choice] < (int) search->minSyllables || syllables - search->maxRemoved[choice] > (int) search->maxSyllables) return;
+
+    if (choice == search->choiceCount) {
+        // The reading without any changes was already tried
+        if (flips == 0) return;
+        elide(search->ctx, search->line, &search->ctx->elision, flips);
+        nob_sb_append_null(&search->ctx->elision);
+        if (search->checkOnly) {
+            size_t amountOfSyllables;
+            search->found = lineFits(search->ctx, search->ctx->elision.items, &amountOfSyllables);
+            search->bestFlips = flips;
+            return;
+        }
+        dhScanVerse(search->ctx, search->ctx->elision.items, &search->verse);
+        if (!verseFits(&search->verse)) return;
+        cost += search->verse.alternatives[0].cost;
+        if (search->found && cost >= search->bestCost) return;
+        search->found = true;
+        search->bestFlips = flips;
+        search->bestCost = cost;
+        return;
+    }
+
+    DhReadingKind kind = search->choices[choice];
+    searchReadings(search, choice + 1, flips, syllables, cost, changes);
+    if (changes < READING_MAX_CHANGES)
+        searchReadings(search, choice + 1, flips | 1u << choice, syllables + readingSyllables[kind], cost + readingCosts[kind], changes + 1);
+}
+
+// Set up a search through the other readings of the choices in ctx, for the line ctx->elision was made from
+void readingSearchInit(ReadingSearch* search, DhContext* ctx, const char* line, bool checkOnly) {
+    memset(search, 0, sizeof(*search));
+    search->ctx = ctx;
+    search->line = line;
+    search->checkOnly = checkOnly;
+    search->choiceCount = ctx->choiceCount;
+    meterSyllableRange(ctx, &search->minSyllables, &search->maxSyllables);
+    memcpy(search->choices, ctx->choices, ctx->choiceCount*sizeof(*ctx->choices));
+    for (size_t choice = search->choiceCount; choice-- > 0;) {
+        int added = readingSyllables[search->choices[choice]];
+        search->maxAdded[choice] = search->maxAdded[choice + 1] + (added > 0 ? added : 0);
+        search->maxRemoved[choice] = search->maxRemoved[choice + 1] + (added < 0 ? -added : 0);
+    }
+}
+
+DhStatus dhScanLine(DhContext* ctx, const char* line, DhVerse* verse) {
+    DhStatus status = dhElisionContext(ctx, line);
+    if (status != DH_OK) {
+        memset(verse, 0, sizeof(*verse));
+        return verse->status = status;
+    }
+    return dhScanElided(ctx, line, verse);
+}
+
+DhStatus dhScanElided(DhContext* ctx, const char* line, DhVerse* verse) {
+    dhScanVerse(ctx, ctx->elision.items, verse);
+    if (!verseFits(verse)) {
+        ReadingSearch search;
+        readingSearchInit(&search, ctx, line, false);
+        searchReadings(&search, 0, 0, verse->syllableCount, 0, 0);
+
+        // Scan the best reading again (or the normal one if nothing fits), so ctx is left with that one
+        elide(ctx, line, &ctx->elision, search.found ? search.bestFlips : 0);
+        nob_sb_append_null(&ctx->elision);
+        dhScanVerse(ctx, ctx->elision.items, verse);
+    }
+    if (ctx->memory != NULL) learnWordQuantities(ctx, verse);
+    return verse->status;
+}
+
+bool dhIsHexameter(DhContext* ctx, const char* line) {
+    if (dhElisionContext(ctx, line) != DH_OK) return false;
+    size_t amountOfSyllables;
+    if (lineFits(ctx, ctx->elision.items, &amountOfSyllables)) return true;
+
+    ReadingSearch search;
+    readingSearchInit(&search, ctx, line, true);
+    searchReadings(&search, 0, 0, amountOfSyllables, 0, 0);
+    return search.found;
+}
+
+void dhRenderVerse(const DhContext* ctx, const DhVerse* verse, Nob_String_Builder* sbNumbers, Nob_String_Builder* sbScan, Nob_String_Builder* sbStrippedLine) {
+    // Clear all the string builders
+    sbNumbers->count = 0;
+    sbScan->count = 0;
+    sbStrippedLine->count = 0;
+
+    const char* line = ctx->line.items;
+    size_t len = ctx->line.count - 1;
 
-    
     // Add some spaces back into the line to make it more readable, and fill the other string builders
     size_t syllableIndex = 0;
     for (size_t i = 0; i < len; ++i) {
-        if (daIntContains(spacePositions, i)) {
+        if (daIntContains(ctx->spacePositions, i)) {
             nob_da_append(sbNumbers, ' ');
             nob_da_append(sbScan, ' ');
             nob_da_append(sbStrippedLine, ' ');
         }
         nob_da_append(sbStrippedLine, line[i]);
-        if (i == syllablePositions[syllableIndex]) {
-            nob_da_append(sbNumbers, syllableNumbers[syllableIndex]);
-            nob_da_append(sbScan, syllableLengths[syllableIndex]);
+        if (syllableIndex < verse->syllableCount && i == verse->syllablePositions[syllableIndex]) {
+            nob_da_append(sbNumbers, verse->syllableNumbers[syllableIndex]);
+            nob_da_append(sbScan, verse->syllableLengths[syllableIndex]);
             ++syllableIndex;
             continue;
         }
         nob_da_append(sbNumbers, ' ');
         nob_da_append(sbScan, ' ');
     }
+}
 
-    // Success!
+bool dhLogStatus(const DhVerse* verse) {
+    switch (verse->status) {
+    case DH_TOO_MANY_SYLLABLES:
+    case DH_TOO_FEW_SYLLABLES:
+        nob_log(NOB_ERROR, "%s: %zu", dhStatusName(verse->status), verse->syllableCount);
+        return false;
+    case DH_EMPTY_VERSE:
+        nob_log(NOB_ERROR, "%s", dhStatusName(verse->status));
+        return false;
+    case DH_INCOMPLETE:
+        nob_log(NOB_WARNING, "Couldn't completely number the metra due to some missing dactyli. You've either");
+        nob_log(NOB_WARNING, "entered an invalid verse or there are rules this program doesn't account for (yet)");
+        break;
+    case DH_OK:
+    case COUNT_DH_STATUSES:
+        break;
+    }
     return true;
 }
+
+bool dhScan(const char* unstrippedLine, Nob_String_Builder* sbNumbers, Nob_String_Builder* sbScan, Nob_String_Builder* sbStrippedLine) {
+    // Clear all the string builders
+    sbNumbers->count = 0;
+    sbScan->count = 0;
+    sbStrippedLine->count = 0;
+
+    DhContext ctx = {0};
+    DhVerse verse;
+    bool result = true;
+    dhScanVerse(&ctx, unstrippedLine, &verse);
+    if (!dhLogStatus(&verse)) nob_return_defer(false);
+
+    // Success!
+    dhRenderVerse(&ctx, &verse, sbNumbers, sbScan, sbStrippedLine);
+
+defer:
+    dhContextFree(&ctx);
+    return result;
+}
+
+void dhBatchResultAlloc(DhBatchResult* result, size_t capacity) {
+    result->capacity = capacity;
+    result->status = malloc(capacity*sizeof(*result->status));
+    result->syllableCount = malloc(capacity*sizeof(*result->syllableCount));
+    result->footPattern = malloc(capacity*sizeof(*result->footPattern));
+    result->longMask = malloc(capacity*sizeof(*result->longMask));
+    result->shortMask = malloc(capacity*sizeof(*result->shortMask));
+    result->caesurae = malloc(capacity*sizeof(*result->caesurae));
+    result->meter = malloc(capacity*sizeof(*result->meter));
+    result->syllableOffsets = malloc((capacity + 1)*sizeof(*result->syllableOffsets));
+    result->syllablePositions = malloc(capacity*MAX_SYLLABLES*sizeof(*result->syllablePositions));
+    result->longProbability = malloc(capacity*MAX_SYLLABLES*sizeof(*result->longProbability));
+    result->dactylProbability = malloc(capacity*5*sizeof(*result->dactylProbability));
+    NOB_ASSERT(result->status != NULL && result->syllableCount != NULL && result->footPattern != NULL &&
+        result->longMask != NULL && result->shortMask != NULL && result->caesurae != NULL && result->meter != NULL &&
+        result->syllableOffsets != NULL && result->syllablePositions != NULL && result->longProbability != NULL &&
+        result->dactylProbability != NULL && "Buy more RAM lol");
+}
+
+void dhBatchResultFree(DhBatchResult* result) {
+    free(result->status);
+    free(result->syllableCount);
+    free(result->footPattern);
+    free(result->longMask);
+    free(result->shortMask);
+    free(result->caesurae);
+    free(result->meter);
+    free(result->syllableOffsets);
+    free(result->syllablePositions);
+    free(result->longProbability);
+    free(result->dactylProbability);
+    memset(result, 0, sizeof(*result));
+}
+
+size_t dhScanBatch(DhContext* ctx, const char* const* lines, size_t n, DhBatchResult* out) {
+    NOB_ASSERT(n <= out->capacity);
+    size_t scanned = 0;
+    uint32_t offset = 0;
+    DhVerse verse;
+    for (size_t i = 0; i < n; ++i) {
+        out->syllableOffsets[i] = offset;
+
+        DhStatus status = dhScanLine(ctx, lines[i], &verse);
+        if (status == DH_OK) ++scanned;
+
+        out->status[i] = status;
+        if (status == DH_OK || status == DH_INCOMPLETE) {
+            out->syllableCount[i] = verse.syllableCount;
+            out->footPattern[i] = verse.footPattern;
+            out->longMask[i] = verse.longMask;
+            out->shortMask[i] = verse.shortMask;
+            out->caesurae[i] = verse.caesurae;
+            out->meter[i] = verse.meter;
+            memcpy(&out->dactylProbability[i*5], verse.dactylProbability, sizeof(verse.dactylProbability));
+            for (size_t j = 0; j < verse.syllableCount; ++j) {
+                out->longProbability[offset] = verse.longProbability[j];
+                out->syllablePositions[offset++] = verse.syllablePositions[j];
+            }
+        } else {
+            out->syllableCount[i] = status == DH_EMPTY_VERSE ? 0 : verse.syllableCount > 255 ? 255 : verse.syllableCount;
+            out->footPattern[i] = 0;
+            out->longMask[i] = 0;
+            out->shortMask[i] = 0;
+            out->caesurae[i] = 0;
+            out->meter[i] = verse.meter;
+            memset(&out->dactylProbability[i*5], 0, 5*sizeof(*out->dactylProbability));
+        }
+    }
+    out->syllableOffsets[n] = offset;
+    return scanned;
+}
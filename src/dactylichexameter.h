@@ -21,8 +21,229 @@
 
 #pragma once
 #include "nob.h"
+#include <stdint.h>
 
-// Get rid of all whitespace and extra characters, and only leave in letters in a string
+// Define the minimum and maximum amount of syllables/dactyli of a hexameter
+// Lowest amount of dactyli: _ _   _ _   _ _   _ _   _ uu  _ _ (13 dactyli)
+// Lowest amount of dactyli: _ uu  _ uu  _ uu  _ uu  _ uu  _ _ (17 dactyli)
+// The other meters have their own range, but none of them has more syllables than a hexameter
+#define MIN_SYLLABLES 13
+#define MAX_SYLLABLES 17
+
+// The meters that can be scanned
+typedef enum {
+    // _ uu  _ uu  _ uu  _ uu  _ uu  _ x, where every metrum but the last can also be _ _ (the fifth one rarely)
+    DH_METER_HEXAMETER,
+    // _ uu  _ uu  _ || _ uu  _ uu  x, the second line of an elegiac couplet, where the first two metra can also be _ _
+    DH_METER_PENTAMETER,
+    // _ uu  _ uu  _ uu  _ x, where the first three metra can also be _ _ (the third one rarely)
+    DH_METER_TETRAMETER,
+    COUNT_DH_METERS,
+} DhMeter;
+
+// The name of a meter, like "pentameter"
+const char* dhMeterName(DhMeter meter);
+// Find a meter by its name. Returns false if there's no meter with that name
+bool dhMeterFromName(const char* name, DhMeter* meter);
+
+// A dynamic array of String Views, to be able to easily split/chop them
+typedef struct {
+    Nob_String_View* items;
+    size_t count;
+    size_t capacity;
+} ChoppedStringView;
+
+// A dynamic array of integers
+typedef struct {
+    int* items;
+    size_t count;
+    size_t capacity;
+} DynamicArrayInt;
+
+// What an accent on a vowel in UTF-8 input says about it
+typedef enum {
+    DH_MARK_NONE,
+    // A macron (or a circumflex): the vowel is long
+    DH_MARK_LONG,
+    // A breve: the vowel is short
+    DH_MARK_SHORT,
+    // A diaeresis: the vowel starts a syllable of its own, so it doesn't make a diphthong and isn't elided (hiatus)
+    DH_MARK_DIAERESIS,
+    COUNT_DH_MARKS,
+} DhMark;
+
+// A dynamic array of DhMarks, one for every character of a line
+typedef struct {
+    uint8_t* items;
+    size_t count;
+    size_t capacity;
+} DhMarks;
+
+// What happened when scanning a verse
+typedef enum {
+    // Every syllable was numbered into the metra of the meter
+    DH_OK,
+    // The verse was scanned, but the metra couldn't all be numbered
+    DH_INCOMPLETE,
+    DH_EMPTY_VERSE,
+    DH_TOO_FEW_SYLLABLES,
+    DH_TOO_MANY_SYLLABLES,
+    COUNT_DH_STATUSES,
+} DhStatus;
+
+// A short description of a status, like "Too few dactyli"
+const char* dhStatusName(DhStatus status);
+
+// The two lengths a syllable can have, used as an index into DhSyllableCost
+typedef enum {
+    DH_LONG,
+    DH_SHORT,
+    COUNT_DH_LENGTHS,
+} DhLength;
+
+// A cost at or above this rules a length out completely
+#define DH_COST_FORBIDDEN 1000
+
+// How unlikely each length of a syllable is. The scanner picks the scansion with the lowest total cost
+typedef struct {
+    int cost[COUNT_DH_LENGTHS];
+} DhSyllableCost;
+
+// The amount of full scansions the scanner keeps besides the best one
+#define DH_MAX_ALTERNATIVES 4
+
+// One complete scansion of a verse, where every syllable is known
+typedef struct {
+    int cost;
+    // The same as in DhVerse
+    uint8_t footPattern;
+    // Bit n is set if syllable n is long, every other syllable is short
+    uint32_t longMask;
+} DhAlternative;
+
+// The main caesurae and diaereses, as bits in DhVerse's caesurae
+typedef enum {
+    // A word ends after the first syllable of the third metrum
+    DH_CAESURA_PENTHEMIMERAL,
+    // A word ends after the first syllable of the fourth metrum
+    DH_CAESURA_HEPHTHEMIMERAL,
+    // A word ends after the first short syllable of the third metrum, if it's a dactyl
+    DH_CAESURA_TROCHAIC,
+    // A word ends after the fourth metrum
+    DH_DIAERESIS_BUCOLIC,
+    COUNT_DH_CAESURAE,
+} DhCaesura;
+
+// The result of scanning one verse
+typedef struct {
+    DhStatus status;
+    // The meter the verse was scanned as
+    DhMeter meter;
+    size_t syllableCount;
+    // Where the vowel of every syllable is in the stripped line
+    size_t syllablePositions[MAX_SYLLABLES];
+    // '_' for long, 'u' for short, '?' for unknown
+    char syllableLengths[MAX_SYLLABLES];
+    // '1' to '6' on the first syllable of every metrum, ' ' everywhere else. The pentameter counts its halves as metra 3 and 6
+    char syllableNumbers[MAX_SYLLABLES];
+    // Bit n is set if metrum n+1 (of the first five) is a dactyl (_ u u) instead of a spondee (_ _). Only complete when status is DH_OK
+    uint8_t footPattern;
+    // Bit n is set if syllable n is long or short respectively. If neither is set, the length is unknown
+    uint32_t longMask;
+    uint32_t shortMask;
+    // Bit n is set if a word ends after syllable n
+    uint32_t wordEndMask;
+    /* Bit n is set if the verse has caesura (or diaeresis) n from DhCaesura. Only caesurae in metra that were numbered
+     * are found. In a pentameter, the penthemimeral caesura is the break in the middle, and there are no others
+     */
+    uint8_t caesurae;
+    // The cheapest complete scansions, cheapest first. Syllables these don't all agree on (at the lowest cost) are unknown
+    size_t alternativeCount;
+    DhAlternative alternatives[DH_MAX_ALTERNATIVES];
+    // The chance that a syllable is long, taking every possible scansion into account
+    float longProbability[MAX_SYLLABLES];
+    // The chance that each of the first five metra is a dactyl instead of a spondee
+    float dactylProbability[5];
+} DhVerse;
+
+/* Adds soft costs to the syllables of a verse, for example from a lexicon of word quantities. line is the stripped,
+ * lowercase line and syllablePositions says where the vowel of every syllable is in it
+ */
+typedef void (*DhHintFunction)(void* data, const char* line, const size_t* syllablePositions, size_t syllableCount, DhSyllableCost* costs);
+
+/* A place where a verse can be read in two ways. The first way is how dhElision reads it, the second way is only tried
+ * by dhScanLine when the first one doesn't fit the meter
+ */
+typedef enum {
+    // Elide a vowel (or a vowel and an 'm') before a vowel or an 'h', or keep it (hiatus)
+    DH_READING_ELISION,
+    // Read 'ei' or 'eu' as one syllable (synizesis), or as two
+    DH_READING_DIPHTHONG,
+    // Read an 'i' before a vowel as a consonant ('j'), or as a vowel
+    DH_READING_CONSONANTAL_I,
+    // Read a 'u' before a vowel as a vowel, or as a consonant ('v')
+    DH_READING_CONSONANTAL_U,
+    COUNT_DH_READINGS,
+} DhReadingKind;
+
+// Only this many choices in a verse can be read the other way
+#define DH_MAX_READING_CHOICES 32
+
+struct Lexicon;
+struct WordMemory;
+struct NgramModel;
+
+/* Buffers that are reused from verse to verse, so scanning a lot of verses doesn't allocate for every one of them.
+ * Initialise it with {0}. A context can only be used by one thread at a time
+ */
+typedef struct {
+    // The line decoded into ASCII and the marks on its letters, when it isn't ASCII already
+    Nob_String_Builder normalized;
+    DhMarks marks;
+    Nob_String_Builder lower;
+    ChoppedStringView words;
+    ChoppedStringView trimmedWords;
+    // The result of the last dhElisionContext call
+    Nob_String_Builder elision;
+    // The choices in the reading of the last elision, in the order they appear in the verse
+    DhReadingKind choices[DH_MAX_READING_CHOICES];
+    size_t choiceCount;
+    // The stripped, lowercase line and the word boundaries in it of the last dhScanVerse call
+    Nob_String_Builder line;
+    DynamicArrayInt spacePositions;
+    // The marks on the letters of line, or empty if nothing is marked
+    DhMarks lineMarks;
+    // Where the vowels are in line
+    DynamicArrayInt vowelPositions;
+    // Optional, the natural quantities of the words that are in it are used like the marks on vowels in UTF-8 lines
+    const struct Lexicon* lexicon;
+    /* Optional, dhScanLine teaches it the quantities of the words of every verse that scans completely, and the verses
+     * after that lean towards them
+     */
+    struct WordMemory* memory;
+    // Optional, breaks the ties between lengths that nothing else decided
+    const struct NgramModel* ngram;
+    // Optional, called for every verse after the rules have set the costs
+    DhHintFunction hint;
+    void* hintData;
+    // The meter to scan as (a hexameter by default), or with detectMeter, scan as whichever meter fits best
+    DhMeter meter;
+    bool detectMeter;
+} DhContext;
+
+void dhContextFree(DhContext* ctx);
+
+// The parts of a DhContext that say how to scan, for programs that make a context for every thread
+typedef struct {
+    DhMeter meter;
+    bool detectMeter;
+    const struct Lexicon* lexicon;
+    const struct NgramModel* ngram;
+} DhScanSettings;
+
+/* Get rid of all whitespace and extra characters, and only leave in letters in a string. UTF-8 letters with an accent
+ * become the letter without it
+ */
 char* dhStripLine(const char* string);
 
 // Perform elision on a Latin verse. The words must be seperated by spaces
@@ -32,3 +253,72 @@ bool dhElision(const char* sentence, Nob_String_Builder* sb);
  * with information that can be printed in that order with newlines inbetween them
  */
 bool dhScan(const char* unstrippedLine, Nob_String_Builder* sbNumbers, Nob_String_Builder* sbLength, Nob_String_Builder* sbStrippedLine);
+
+// Like dhElision, but the result goes into ctx->elision (NULL-terminated) and nothing is logged
+DhStatus dhElisionContext(DhContext* ctx, const char* line);
+
+// Like dhScan, but it fills in a DhVerse instead of rendering text, and nothing is logged
+DhStatus dhScanVerse(DhContext* ctx, const char* unstrippedLine, DhVerse* verse);
+
+/* Perform elision on a verse and scan it. If that reading has too few or too many syllables or doesn't fit the meter,
+ * look for the cheapest other reading that does, changing at most a few of the choices. The reading that was used ends
+ * up in ctx->elision
+ */
+DhStatus dhScanLine(DhContext* ctx, const char* line, DhVerse* verse);
+
+/* The part of dhScanLine after the elision: scan the verse dhElisionContext just put in ctx->elision, and try the other
+ * readings of line if it doesn't fit. Only call it when the elision succeeded
+ */
+DhStatus dhScanElided(DhContext* ctx, const char* line, DhVerse* verse);
+
+/* Find the syllables of a stripped line, with spaces between the words like dhRenderVerse writes it, and the context
+ * of every syllable in the n-gram model (see ngram.h). Returns the amount of syllables, but only the first MAX_SYLLABLES
+ * are filled in
+ */
+size_t dhSyllableContexts(DhContext* ctx, const char* line, size_t* syllablePositions, uint16_t* contexts);
+
+/* Check if a line is a valid hexameter (or whatever meter ctx is set to): true exactly when dhScanLine would find a
+ * reading and a scansion that don't break any hard rules. It only counts syllables, gives them their costs and checks
+ * if the meter can get through them,
+ * so it doesn't find the scansion, number the metra or render anything, and it stops at the first reading that fits.
+ * ctx is left with the last reading that was tried
+ */
+bool dhIsHexameter(DhContext* ctx, const char* line);
+
+// Log what went wrong with a verse the same way dhScan does. Returns false if it couldn't be scanned at all
+bool dhLogStatus(const DhVerse* verse);
+
+// Render the verse of the last dhScanVerse call on ctx the same way dhScan does
+void dhRenderVerse(const DhContext* ctx, const DhVerse* verse, Nob_String_Builder* sbNumbers, Nob_String_Builder* sbLength, Nob_String_Builder* sbStrippedLine);
+
+/* The results of scanning many verses, with one array per field (struct-of-arrays), so analytics can go through one field
+ * at a time. Verse i's syllable positions are syllablePositions[syllableOffsets[i]] up to syllablePositions[syllableOffsets[i + 1]]
+ */
+typedef struct {
+    // The amount of verses the arrays have room for
+    size_t capacity;
+    uint8_t* status;
+    uint8_t* syllableCount;
+    uint8_t* footPattern;
+    uint32_t* longMask;
+    uint32_t* shortMask;
+    uint8_t* caesurae;
+    // A DhMeter
+    uint8_t* meter;
+    // capacity + 1 entries
+    uint32_t* syllableOffsets;
+    // capacity*MAX_SYLLABLES entries
+    uint16_t* syllablePositions;
+    // The chance every syllable is long, with the same offsets as syllablePositions
+    float* longProbability;
+    // capacity*5 entries: the chance each of the first five metra of a verse is a dactyl
+    float* dactylProbability;
+} DhBatchResult;
+
+void dhBatchResultAlloc(DhBatchResult* result, size_t capacity);
+void dhBatchResultFree(DhBatchResult* result);
+
+/* Perform elision on and scan n (unelided) verses, and put the results in out, which must have room for at least n verses.
+ * Returns the amount of verses that were scanned completely (DH_OK)
+ */
+size_t dhScanBatch(DhContext* ctx, const char* const* lines, size_t n, DhBatchResult* out);
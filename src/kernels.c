@@ -0,0 +1,284 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Check if a byte is an ASCII letter, the same way the SIMD kernels do (isalpha depends on the locale)
+#define KERNEL_IS_LETTER(chr) (((chr) | 0x20) >= 'a' && ((chr) | 0x20) <= 'z')
+
+size_t kernelStripScalar(const char* string, size_t len, bool lower, char* out, DynamicArrayInt* boundaries) {
+    size_t count = 0;
+    // The start of the line counts as a letter, so non-letters at the start are a boundary too
+    bool previousLetter = true;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char chr = string[i];
+        bool letter = KERNEL_IS_LETTER(chr);
+        if (letter) out[count++] = lower ? chr | 0x20 : chr;
+        else if (previousLetter && boundaries != NULL) nob_da_append(boundaries, count);
+        previousLetter = letter;
+    }
+    out[count] = '\0';
+    return count;
+}
+
+void kernelLowerScalar(const char* string, size_t len, char* out) {
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char chr = string[i];
+        out[i] = chr >= 'A' && chr <= 'Z' ? chr | 0x20 : chr;
+    }
+    out[len] = '\0';
+}
+
+void kernelVowelsScalar(const char* line, size_t len, DynamicArrayInt* positions) {
+    for (size_t i = 0; i < len; ++i) {
+        switch (line[i]) {
+        case 'u':
+            if (i != 0 && line[i - 1] == 'q') break;
+            // fallthrough
+        case 'a': case 'e': case 'i': case 'o': case 'y':
+            nob_da_append(positions, i);
+            break;
+        }
+    }
+}
+
+/* Copy the letters of a block of at most 32 bytes to out + count, one run of letters at a time, and append a boundary
+ * for every run of non-letters. Bit n of letters is set if byte n is a letter, and bit n of starts if a run of
+ * non-letters starts there. Returns the new count
+ */
+size_t kernelCompact(const char* block, uint32_t letters, uint32_t starts, char* out, size_t count, DynamicArrayInt* boundaries) {
+    while (letters != 0) {
+        int start = __builtin_ctz(letters);
+        // There's at most one run of non-letters between two runs of letters
+        if (starts != 0 && __builtin_ctz(starts) < start) {
+            if (boundaries != NULL) nob_da_append(boundaries, count);
+            starts &= starts - 1;
+        }
+        uint32_t rest = ~(letters >> start);
+        int length = rest == 0 ? 32 : __builtin_ctz(rest);
+        memcpy(out + count, block + start, length);
+        count += length;
+        letters = start + length >= 32 ? 0 : letters & ~0u << (start + length);
+    }
+    if (starts != 0 && boundaries != NULL) nob_da_append(boundaries, count);
+    return count;
+}
+
+#ifdef KERNELS_X86
+
+// Load up to 16 bytes, with zeros after the end
+__attribute__((target("sse2")))
+static inline __m128i kernelLoadSse2(const char* string, size_t size) {
+    if (size >= 16) return _mm_loadu_si128((const __m128i*) string);
+    char block[16] = {0};
+    memcpy(block, string, size);
+    return _mm_loadu_si128((const __m128i*) block);
+}
+
+// Bytes that are letters become 0xFF, the rest 0. Bytes from 0x80 up are negative, so they're never in the range
+__attribute__((target("sse2")))
+static inline __m128i kernelLettersSse2(__m128i bytes) {
+    __m128i folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+    return _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), folded));
+}
+
+__attribute__((target("sse2")))
+size_t kernelStripSse2(const char* string, size_t len, bool lower, char* out, DynamicArrayInt* boundaries) {
+    size_t count = 0;
+    uint32_t previousLetter = 1;
+    char block[16];
+    for (size_t i = 0; i < len; i += 16) {
+        size_t size = len - i < 16 ? len - i : 16;
+        __m128i bytes = kernelLoadSse2(string + i, size);
+        __m128i isLetter = kernelLettersSse2(bytes);
+        if (lower) bytes = _mm_or_si128(bytes, _mm_and_si128(isLetter, _mm_set1_epi8(0x20)));
+        _mm_storeu_si128((__m128i*) block, bytes);
+        uint32_t valid = (1u << size) - 1;
+        uint32_t letters = _mm_movemask_epi8(isLetter) & valid;
+        uint32_t starts = ~letters & (letters << 1 | previousLetter) & valid;
+        previousLetter = letters >> 15;
+        count = kernelCompact(block, letters, starts, out, count, boundaries);
+    }
+    out[count] = '\0';
+    return count;
+}
+
+__attribute__((target("sse2")))
+void kernelLowerSse2(const char* string, size_t len, char* out) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (string + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), bytes));
+        _mm_storeu_si128((__m128i*) (out + i), _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    }
+    kernelLowerScalar(string + i, len - i, out + i);
+}
+
+__attribute__((target("sse2")))
+void kernelVowelsSse2(const char* line, size_t len, DynamicArrayInt* positions) {
+    uint32_t previousQ = 0;
+    for (size_t i = 0; i < len; i += 16) {
+        size_t size = len - i < 16 ? len - i : 16;
+        __m128i bytes = kernelLoadSse2(line + i, size);
+        __m128i isVowel = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('a')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('e'))),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('i')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('o')))
+        );
+        isVowel = _mm_or_si128(isVowel, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('y')));
+        uint32_t us = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('u')));
+        uint32_t qs = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('q')));
+        uint32_t vowels = _mm_movemask_epi8(isVowel) | (us & ~(qs << 1 | previousQ));
+        previousQ = qs >> 15;
+        while (vowels != 0) {
+            nob_da_append(positions, i + __builtin_ctz(vowels));
+            vowels &= vowels - 1;
+        }
+    }
+}
+
+// The AVX2 kernels are the same, 32 bytes at a time. Like the SSE2 ones, they're compiled for their instruction set on
+// their own, so the rest of the program runs on any CPU
+
+__attribute__((target("avx2")))
+static inline __m256i kernelLoadAvx2(const char* string, size_t size) {
+    if (size >= 32) return _mm256_loadu_si256((const __m256i*) string);
+    char block[32] = {0};
+    memcpy(block, string, size);
+    return _mm256_loadu_si256((const __m256i*) block);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i kernelLettersAvx2(__m256i bytes) {
+    __m256i folded = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+    return _mm256_and_si256(_mm256_cmpgt_epi8(folded, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), folded));
+}
+
+__attribute__((target("avx2")))
+size_t kernelStripAvx2(const char* string, size_t len, bool lower, char* out, DynamicArrayInt* boundaries) {
+    size_t count = 0;
+    uint32_t previousLetter = 1;
+    char block[32];
+    for (size_t i = 0; i < len; i += 32) {
+        size_t size = len - i < 32 ? len - i : 32;
+        __m256i bytes = kernelLoadAvx2(string + i, size);
+        __m256i isLetter = kernelLettersAvx2(bytes);
+        if (lower) bytes = _mm256_or_si256(bytes, _mm256_and_si256(isLetter, _mm256_set1_epi8(0x20)));
+        _mm256_storeu_si256((__m256i*) block, bytes);
+        uint32_t valid = size == 32 ? 0xFFFFFFFF : (1u << size) - 1;
+        uint32_t letters = (uint32_t) _mm256_movemask_epi8(isLetter) & valid;
+        uint32_t starts = ~letters & (letters << 1 | previousLetter) & valid;
+        previousLetter = letters >> 31;
+        count = kernelCompact(block, letters, starts, out, count, boundaries);
+    }
+    out[count] = '\0';
+    return count;
+}
+
+__attribute__((target("avx2")))
+void kernelLowerAvx2(const char* string, size_t len, char* out) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) (string + i));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+        _mm256_storeu_si256((__m256i*) (out + i), _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+    }
+    kernelLowerScalar(string + i, len - i, out + i);
+}
+
+__attribute__((target("avx2")))
+void kernelVowelsAvx2(const char* line, size_t len, DynamicArrayInt* positions) {
+    uint32_t previousQ = 0;
+    for (size_t i = 0; i < len; i += 32) {
+        size_t size = len - i < 32 ? len - i : 32;
+        __m256i bytes = kernelLoadAvx2(line + i, size);
+        __m256i isVowel = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('a')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('e'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('i')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('o')))
+        );
+        isVowel = _mm256_or_si256(isVowel, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('y')));
+        uint32_t us = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('u')));
+        uint32_t qs = _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('q')));
+        uint32_t vowels = (uint32_t) _mm256_movemask_epi8(isVowel) | (us & ~(qs << 1 | previousQ));
+        previousQ = qs >> 31;
+        while (vowels != 0) {
+            nob_da_append(positions, i + __builtin_ctz(vowels));
+            vowels &= vowels - 1;
+        }
+    }
+}
+
+const KernelSet kernelSets[COUNT_KERNEL_SETS] = {
+    [KERNELS_SCALAR] = {"scalar", kernelStripScalar, kernelLowerScalar, kernelVowelsScalar},
+    [KERNELS_SSE2]   = {"sse2",   kernelStripSse2,   kernelLowerSse2,   kernelVowelsSse2},
+    [KERNELS_AVX2]   = {"avx2",   kernelStripAvx2,   kernelLowerAvx2,   kernelVowelsAvx2},
+};
+
+#else
+
+// Without x86 there's only the scalar set, which the others fall back to
+const KernelSet kernelSets[COUNT_KERNEL_SETS] = {
+    [KERNELS_SCALAR] = {"scalar", kernelStripScalar, kernelLowerScalar, kernelVowelsScalar},
+    [KERNELS_SSE2]   = {"sse2",   kernelStripScalar, kernelLowerScalar, kernelVowelsScalar},
+    [KERNELS_AVX2]   = {"avx2",   kernelStripScalar, kernelLowerScalar, kernelVowelsScalar},
+};
+
+#endif // KERNELS_X86
+
+const KernelSet* kernels = &kernelSets[KERNELS_SCALAR];
+
+// Check if the CPU (and the OS) can run a set of kernels
+bool kernelSetSupported(KernelSetKind kind) {
+    switch (kind) {
+    case KERNELS_SCALAR: return true;
+#ifdef KERNELS_X86
+    case KERNELS_SSE2: return __builtin_cpu_supports("sse2");
+    case KERNELS_AVX2: return __builtin_cpu_supports("avx2");
+#else
+    case KERNELS_SSE2:
+    case KERNELS_AVX2:
+        return false;
+#endif
+    case COUNT_KERNEL_SETS: NOB_UNREACHABLE("kernelSetSupported");
+    }
+    return false;
+}
+
+// Pick the fastest set the CPU supports (or the one DH_KERNELS asks for, if it's supported) before main runs
+__attribute__((constructor))
+void kernelsInit(void) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+#endif
+    KernelSetKind best = KERNELS_SCALAR;
+    for (size_t kind = 0; kind < COUNT_KERNEL_SETS; ++kind) {
+        if (kernelSetSupported(kind)) best = kind;
+    }
+    const char* wanted = getenv("DH_KERNELS");
+    for (size_t kind = 0; wanted != NULL && kind < best; ++kind) {
+        if (strcmp(kernelSets[kind].name, wanted) == 0) best = kind;
+    }
+    kernels = &kernelSets[best];
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* The byte loops the scanner spends most of its time in: stripping a line down to its letters, making it lowercase and
+ * finding the vowels. There's a plain C version of every kernel, and on x86 an SSE2 and an AVX2 version that classify
+ * 16 or 32 bytes at a time into masks (letter, vowel, start of a word boundary) and then copy the letters out run by
+ * run. The fastest set the CPU supports is picked when the program starts. Setting the environment variable DH_KERNELS
+ * to "scalar", "sse2" or "avx2" picks a slower one instead, to compare them.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+typedef enum {
+    KERNELS_SCALAR,
+    KERNELS_SSE2,
+    KERNELS_AVX2,
+    COUNT_KERNEL_SETS,
+} KernelSetKind;
+
+typedef struct {
+    const char* name;
+    /* Copy the letters of string (len bytes) to out, made lowercase if lower is set, and NULL-terminate it. out needs
+     * room for len + 1 bytes. If boundaries isn't NULL, the index in out of every run of non-letters is appended to it,
+     * so it says where the words were. Returns the amount of letters
+     */
+    size_t (*strip)(const char* string, size_t len, bool lower, char* out, DynamicArrayInt* boundaries);
+    // Copy string (len bytes) to out with every letter lowercase, and NULL-terminate it. out may be string itself
+    void (*lower)(const char* string, size_t len, char* out);
+    /* Append the index of every vowel in a stripped, lowercase line to positions, the same ones isVowel finds: 'a',
+     * 'e', 'i', 'o', 'u' and 'y', except a 'u' after a 'q'
+     */
+    void (*vowels)(const char* line, size_t len, DynamicArrayInt* positions);
+} KernelSet;
+
+extern const KernelSet kernelSets[COUNT_KERNEL_SETS];
+// The set that's used, picked when the program starts
+extern const KernelSet* kernels;
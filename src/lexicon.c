@@ -0,0 +1,327 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "lexicon.h"
+#include "unicode.h"
+#ifndef _WIN32
+#    include <sys/mman.h>
+#endif
+
+#define LEXICON_MAGIC "DHLEX001"
+#define LEXICON_MAGIC_SIZE 8
+#define LEXICON_HEADER_SIZE (LEXICON_MAGIC_SIZE + 4 + 4 + 4)
+#define LEXICON_WORD_SIZE 12
+// The average amount of words in a bucket. Bigger buckets make the file smaller, but compiling it slower
+#define LEXICON_BUCKET_SIZE 4
+// Give up on a bucket after trying this many seeds, which only happens if two words hash the same with every seed
+#define LEXICON_MAX_SEED 100000000
+
+// FNV-1a with the seed mixed into the start, and a final mix so every bit depends on every letter
+uint32_t lexiconHash(const char* word, size_t len, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed*0x9E3779B9u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t) word[i];
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+void lexiconPutUint32(Nob_String_Builder* sb, uint32_t value) {
+    for (size_t i = 0; i < 4; ++i) nob_da_append(sb, (char) ((value >> (8*i)) & 0xFF));
+}
+
+uint32_t lexiconGetUint32(const uint8_t* data) {
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t) data[3] << 24;
+}
+
+// A word from the word list
+typedef struct {
+    char word[LEXICON_MAX_WORD];
+    uint8_t len;
+    uint32_t longMask;
+    uint32_t shortMask;
+    uint32_t bucket;
+} LexiconEntry;
+
+typedef struct {
+    LexiconEntry* items;
+    size_t count;
+    size_t capacity;
+} LexiconEntries;
+
+/* Turn a line of the word list into the key it's looked up by, with the quantities of its vowels. Returns false if
+ * there's no word on it, or if it's too long
+ */
+bool lexiconParseWord(const char* line, Nob_String_Builder* ascii, DhMarks* marks, LexiconEntry* entry) {
+    memset(entry, 0, sizeof(*entry));
+    unicodeNormalize(line, ascii, marks);
+    for (size_t i = 0; i + 1 < ascii->count; ++i) {
+        char chr = tolower(ascii->items[i]);
+        if (!isalpha(chr) || chr == 'h') continue;
+        if (entry->len >= LEXICON_MAX_WORD) return false;
+        if (chr == 'j') chr = 'i';
+        if (chr == 'v') chr = 'u';
+        DhMark mark = marks->count > 0 ? marks->items[i] : DH_MARK_NONE;
+        if (mark == DH_MARK_LONG) entry->longMask |= 1u << entry->len;
+        if (mark == DH_MARK_SHORT) entry->shortMask |= 1u << entry->len;
+        entry->word[entry->len++] = chr;
+    }
+    return entry->len > 0;
+}
+
+int lexiconCompareWords(const void* a, const void* b) {
+    const LexiconEntry* first = a;
+    const LexiconEntry* second = b;
+    if (first->len != second->len) return first->len - second->len;
+    return memcmp(first->word, second->word, first->len);
+}
+
+// Sort the buckets from big to small, since the big ones are the hardest to find a seed for
+typedef struct {
+    uint32_t bucket;
+    uint32_t start;
+    uint32_t count;
+} LexiconBucket;
+
+int lexiconCompareBuckets(const void* a, const void* b) {
+    const LexiconBucket* first = a;
+    const LexiconBucket* second = b;
+    if (first->count != second->count) return second->count > first->count ? 1 : -1;
+    return first->bucket < second->bucket ? -1 : first->bucket > second->bucket;
+}
+
+int lexiconCompareEntryBuckets(const void* a, const void* b) {
+    const LexiconEntry* first = a;
+    const LexiconEntry* second = b;
+    return first->bucket < second->bucket ? -1 : first->bucket > second->bucket;
+}
+
+bool lexiconCompile(const char* inputPath, const char* outputPath) {
+    bool result = true;
+    Nob_String_Builder input = {0};
+    Nob_String_Builder ascii = {0};
+    Nob_String_Builder out = {0};
+    DhMarks marks = {0};
+    LexiconEntries entries = {0};
+    LexiconBucket* buckets = NULL;
+    uint32_t* seeds = NULL;
+    int32_t* slots = NULL;
+    if (!nob_read_entire_file(inputPath, &input)) nob_return_defer(false);
+
+    // Read every word, skipping comments
+    size_t skipped = 0;
+    Nob_String_View text = nob_sv_from_parts(input.items, input.count);
+    Nob_String_Builder line = {0};
+    while (text.count > 0) {
+        Nob_String_View sv = nob_sv_trim(nob_sv_chop_by_delim(&text, '\n'));
+        if (sv.count == 0 || sv.data[0] == '#') continue;
+        line.count = 0;
+        nob_sb_append_buf(&line, sv.data, sv.count);
+        nob_sb_append_null(&line);
+        LexiconEntry entry;
+        if (lexiconParseWord(line.items, &ascii, &marks, &entry)) nob_da_append(&entries, entry);
+        else ++skipped;
+    }
+    nob_sb_free(line);
+    if (skipped > 0) nob_log(NOB_WARNING, "Skipped %zu words that were too long or had no letters", skipped);
+
+    // Merge the forms that are there more than once, keeping only the quantities they agree on
+    qsort(entries.items, entries.count, sizeof(*entries.items), lexiconCompareWords);
+    size_t unique = 0;
+    for (size_t i = 0; i < entries.count; ++i) {
+        if (unique > 0 && lexiconCompareWords(&entries.items[unique - 1], &entries.items[i]) == 0) {
+            entries.items[unique - 1].longMask &= entries.items[i].longMask;
+            entries.items[unique - 1].shortMask &= entries.items[i].shortMask;
+        } else {
+            entries.items[unique++] = entries.items[i];
+        }
+    }
+    entries.count = unique;
+    if (entries.count > UINT32_MAX/LEXICON_WORD_SIZE) {
+        nob_log(NOB_ERROR, "%s has too many words", inputPath);
+        nob_return_defer(false);
+    }
+
+    // Put the words in buckets, and find a seed for every bucket, biggest first, that gives its words free slots
+    uint32_t wordCount = entries.count;
+    uint32_t bucketCount = wordCount/LEXICON_BUCKET_SIZE + 1;
+    for (size_t i = 0; i < entries.count; ++i) {
+        entries.items[i].bucket = lexiconHash(entries.items[i].word, entries.items[i].len, 0) % bucketCount;
+    }
+    qsort(entries.items, entries.count, sizeof(*entries.items), lexiconCompareEntryBuckets);
+    buckets = calloc(bucketCount, sizeof(*buckets));
+    seeds = calloc(bucketCount, sizeof(*seeds));
+    slots = malloc((wordCount + 1)*sizeof(*slots));
+    NOB_ASSERT(buckets != NULL && seeds != NULL && slots != NULL && "Buy more RAM lol");
+    for (uint32_t i = 0; i < bucketCount; ++i) buckets[i].bucket = i;
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        LexiconBucket* bucket = &buckets[entries.items[i].bucket];
+        if (bucket->count == 0) bucket->start = i;
+        ++bucket->count;
+    }
+    qsort(buckets, bucketCount, sizeof(*buckets), lexiconCompareBuckets);
+    // Which word is in every slot, or -1
+    for (uint32_t i = 0; i < wordCount; ++i) slots[i] = -1;
+    for (uint32_t b = 0; b < bucketCount && buckets[b].count > 0; ++b) {
+        const LexiconBucket* bucket = &buckets[b];
+        uint32_t taken[LEXICON_BUCKET_SIZE*8];
+        if (bucket->count > NOB_ARRAY_LEN(taken)) {
+            nob_log(NOB_ERROR, "A bucket of %s got too big, which means the hash is broken", inputPath);
+            nob_return_defer(false);
+        }
+        uint32_t seed = 1;
+        for (; seed < LEXICON_MAX_SEED; ++seed) {
+            size_t placed = 0;
+            for (; placed < bucket->count; ++placed) {
+                const LexiconEntry* entry = &entries.items[bucket->start + placed];
+                uint32_t slot = lexiconHash(entry->word, entry->len, seed) % wordCount;
+                if (slots[slot] >= 0) break;
+                slots[slot] = bucket->start + placed;
+                taken[placed] = slot;
+            }
+            if (placed == bucket->count) break;
+            // Free the slots again and try the next seed
+            for (size_t i = 0; i < placed; ++i) slots[taken[i]] = -1;
+        }
+        if (seed == LEXICON_MAX_SEED) {
+            nob_log(NOB_ERROR, "Couldn't find a perfect hash for %s", inputPath);
+            nob_return_defer(false);
+        }
+        seeds[bucket->bucket] = seed;
+    }
+
+    // Write the header, the seeds, the words in the order of their slots and the string pool
+    nob_sb_append_cstr(&out, LEXICON_MAGIC);
+    lexiconPutUint32(&out, wordCount);
+    lexiconPutUint32(&out, bucketCount);
+    uint32_t poolSize = 0;
+    for (uint32_t i = 0; i < wordCount; ++i) poolSize += 1 + entries.items[i].len;
+    lexiconPutUint32(&out, poolSize);
+    for (uint32_t i = 0; i < bucketCount; ++i) lexiconPutUint32(&out, seeds[i]);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        const LexiconEntry* entry = &entries.items[slots[i]];
+        lexiconPutUint32(&out, offset);
+        lexiconPutUint32(&out, entry->longMask);
+        lexiconPutUint32(&out, entry->shortMask);
+        offset += 1 + entry->len;
+    }
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        const LexiconEntry* entry = &entries.items[slots[i]];
+        nob_da_append(&out, (char) entry->len);
+        nob_sb_append_buf(&out, entry->word, entry->len);
+    }
+    if (!nob_write_entire_file(outputPath, out.items, out.count)) nob_return_defer(false);
+    nob_log(NOB_INFO, "Compiled %u words into %s", wordCount, outputPath);
+
+defer:
+    nob_sb_free(input);
+    nob_sb_free(ascii);
+    nob_sb_free(out);
+    nob_da_free(marks);
+    nob_da_free(entries);
+    free(buckets);
+    free(seeds);
+    free(slots);
+    return result;
+}
+
+bool lexiconOpen(Lexicon* lexicon, const char* path) {
+    memset(lexicon, 0, sizeof(*lexicon));
+
+#ifdef _WIN32
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    lexicon->data = (const uint8_t*) sb.items;
+    lexicon->size = sb.count;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    lexicon->size = info.st_size;
+    if (lexicon->size > 0) {
+        void* data = mmap(NULL, lexicon->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            nob_log(NOB_ERROR, "Couldn't map %s: %s", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        lexicon->data = data;
+    }
+    close(fd);
+#endif
+
+    // Check the magic number and that the parts add up to the size of the file
+    const uint8_t* data = lexicon->data;
+    if (lexicon->size < LEXICON_HEADER_SIZE || memcmp(data, LEXICON_MAGIC, LEXICON_MAGIC_SIZE) != 0) goto invalid;
+    lexicon->wordCount = lexiconGetUint32(data + LEXICON_MAGIC_SIZE);
+    lexicon->bucketCount = lexiconGetUint32(data + LEXICON_MAGIC_SIZE + 4);
+    lexicon->poolSize = lexiconGetUint32(data + LEXICON_MAGIC_SIZE + 8);
+    if (lexicon->bucketCount == 0 ||
+        LEXICON_HEADER_SIZE + 4*(uint64_t) lexicon->bucketCount + LEXICON_WORD_SIZE*(uint64_t) lexicon->wordCount + lexicon->poolSize != lexicon->size) {
+        goto invalid;
+    }
+    lexicon->seeds = data + LEXICON_HEADER_SIZE;
+    lexicon->words = lexicon->seeds + 4*lexicon->bucketCount;
+    lexicon->pool = lexicon->words + LEXICON_WORD_SIZE*lexicon->wordCount;
+    return true;
+
+invalid:
+    nob_log(NOB_ERROR, "%s isn't a valid lexicon", path);
+    lexiconClose(lexicon);
+    return false;
+}
+
+void lexiconClose(Lexicon* lexicon) {
+#ifdef _WIN32
+    free((void*) lexicon->data);
+#else
+    if (lexicon->data != NULL) munmap((void*) lexicon->data, lexicon->size);
+#endif
+    memset(lexicon, 0, sizeof(*lexicon));
+}
+
+bool lexiconLookup(const Lexicon* lexicon, const char* word, size_t len, uint32_t* longMask, uint32_t* shortMask) {
+    if (lexicon->wordCount == 0 || len == 0 || len > LEXICON_MAX_WORD) return false;
+    uint32_t bucket = lexiconHash(word, len, 0) % lexicon->bucketCount;
+    uint32_t seed = lexiconGetUint32(lexicon->seeds + 4*bucket);
+    const uint8_t* entry = lexicon->words + LEXICON_WORD_SIZE*(lexiconHash(word, len, seed) % lexicon->wordCount);
+    uint32_t offset = lexiconGetUint32(entry);
+    // The file could be broken, so check that the word is inside the string pool before comparing it
+    if (offset >= lexicon->poolSize || lexicon->pool[offset] != len || len > lexicon->poolSize - offset - 1) return false;
+    if (memcmp(lexicon->pool + offset + 1, word, len) != 0) return false;
+    *longMask = lexiconGetUint32(entry + 4);
+    *shortMask = lexiconGetUint32(entry + 8);
+    return true;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A lexicon of word forms with the natural quantities of their vowels, like "armā" or "canō", so the scanner knows
+ * them without needing the meter. It's compiled from a text file with one word form per line (UTF-8, a macron for
+ * a long vowel and a breve for a short one, unmarked vowels are unknown, and lines starting with '#' are comments)
+ * into a file that's mapped into memory as it is, so opening it takes no time no matter how big it is.
+ *
+ * Words are looked up the way they end up in the stripped line: lowercase, without 'h's, and with 'j' and 'v' as 'i'
+ * and 'u'. When a form is in the file more than once (like "arma" and "armā"), only the quantities they agree on are
+ * kept.
+ *
+ * Layout (all numbers are little-endian):
+ *     "DHLEX001", u32 word count, u32 bucket count, u32 string pool size
+ *     u32 seed for every bucket
+ *     for every word: u32 offset in the string pool, u32 long mask, u32 short mask
+ *     the string pool: for every word, its length as one byte and then its letters
+ *
+ * It's a minimal perfect hash (hash and displace): a word's bucket is its hash with seed 0, and its slot is its hash
+ * with the seed of the bucket, which the compiler picked so that every word gets a slot of its own. A word that isn't
+ * in the lexicon lands on some slot too, so the string pool is there to check.
+ */
+
+#pragma once
+#include "nob.h"
+#include <stdint.h>
+
+// Words longer than this aren't in the lexicon, so their masks fit in 32 bits
+#define LEXICON_MAX_WORD 32
+
+typedef struct Lexicon {
+    const uint8_t* data;
+    size_t size;
+    uint32_t wordCount;
+    uint32_t bucketCount;
+    const uint8_t* seeds;
+    const uint8_t* words;
+    const uint8_t* pool;
+    uint32_t poolSize;
+} Lexicon;
+
+// Compile a word list into a lexicon file
+bool lexiconCompile(const char* inputPath, const char* outputPath);
+
+// Map a lexicon file into memory (or read it, where mapping isn't available)
+bool lexiconOpen(Lexicon* lexicon, const char* path);
+void lexiconClose(Lexicon* lexicon);
+
+/* Look up a word, which has to be lowercase, without 'h's, and with 'i' and 'u' instead of 'j' and 'v'. Bit n of
+ * longMask or shortMask is set if letter n is a long or short vowel. Returns false if the word isn't in the lexicon
+ */
+bool lexiconLookup(const Lexicon* lexicon, const char* word, size_t len, uint32_t* longMask, uint32_t* shortMask);
+
+// The hash of a word with a seed, and reading and writing little-endian numbers. The word memory uses them too
+uint32_t lexiconHash(const char* word, size_t len, uint32_t seed);
+void lexiconPutUint32(Nob_String_Builder* sb, uint32_t value);
+uint32_t lexiconGetUint32(const uint8_t* data);
@@ -0,0 +1,869 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "lsp.h"
+#include "lexicon.h"
+#include "records.h"
+#include "scansion.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Lines are remembered in a table of this many entries, by where the hash of their text puts them
+#define LSP_CACHE_SIZE 4096
+#define LSP_READ_SIZE (64*1024)
+// A message that's nested deeper than this is rejected instead of parsed
+#define LSP_MAX_DEPTH 64
+
+// JSON-RPC error codes
+#define LSP_PARSE_ERROR      -32700
+#define LSP_INVALID_REQUEST  -32600
+#define LSP_METHOD_NOT_FOUND -32601
+
+// LSP diagnostic severities
+#define LSP_SEVERITY_ERROR   1
+#define LSP_SEVERITY_WARNING 2
+
+typedef enum {
+    LSP_JSON_NULL,
+    LSP_JSON_FALSE,
+    LSP_JSON_TRUE,
+    LSP_JSON_NUMBER,
+    LSP_JSON_STRING,
+    LSP_JSON_ARRAY,
+    LSP_JSON_OBJECT,
+} LspJsonType;
+
+/* A value in a parsed message. The values are all in one array, and refer to each other by index. Index 0 is always a
+ * null, which is also what looking up something that isn't there gives
+ */
+typedef struct {
+    LspJsonType type;
+    // The name of a member of an object
+    Nob_String_View key;
+    // The text of a string, decoded
+    Nob_String_View string;
+    double number;
+    // The first value in an array or object, and the value after this one in its parent, or 0 if there's none
+    size_t child;
+    size_t next;
+} LspJson;
+
+typedef struct {
+    LspJson* items;
+    size_t count;
+    size_t capacity;
+} LspJsonValues;
+
+// Parses a message in place: strings are decoded over their own text, since decoding only ever makes them shorter
+typedef struct {
+    char* data;
+    size_t pos;
+    LspJsonValues* values;
+} LspParser;
+
+typedef struct {
+    DhStatus status;
+    size_t syllableCount;
+    DhMeter meter;
+    // The lengths of the syllables with a space before every metrum, like "_uu _uu __ __ _uu _u"
+    char label[2*MAX_SYLLABLES];
+} LspScan;
+
+typedef struct {
+    // NULL-terminated, without the line break
+    char* text;
+    size_t len;
+    bool scanned;
+    LspScan scan;
+} LspLine;
+
+typedef struct {
+    LspLine* items;
+    size_t count;
+    size_t capacity;
+} LspLines;
+
+typedef struct {
+    char* uri;
+    // There's always at least one line, even if it's empty
+    LspLines lines;
+    // The diagnostics are out of date, and are sent once the deadline passes without any more changes
+    bool dirty;
+    uint64_t deadline;
+} LspDocument;
+
+typedef struct {
+    LspDocument* items;
+    size_t count;
+    size_t capacity;
+} LspDocuments;
+
+typedef struct {
+    uint32_t hash;
+    // A copy of the line, or NULL if the entry is empty
+    char* text;
+    size_t len;
+    LspScan scan;
+} LspCacheEntry;
+
+typedef struct {
+    LspOptions options;
+    DhContext ctx;
+    DhVerse verse;
+    LspDocuments documents;
+    LspCacheEntry* cache;
+    // What's been read from stdin and not handled yet, the body of the message that's being handled, and its values
+    Nob_String_Builder in;
+    Nob_String_Builder body;
+    LspJsonValues json;
+    // The message that's being written
+    Nob_String_Builder out;
+    bool shutdown;
+    bool exited;
+} Lsp;
+
+#ifdef _WIN32
+
+uint64_t lspNow(void) {
+    return GetTickCount64()*1000000;
+}
+
+// Wait until there's something to read, or timeoutMs (-1 is forever) passes. Editors talk to their servers through pipes
+bool lspWaitForInput(int timeoutMs) {
+    HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+    uint64_t end = lspNow() + (uint64_t) timeoutMs*1000000;
+    for (;;) {
+        DWORD available = 0;
+        // Let read find out what's wrong with it
+        if (!PeekNamedPipe(input, NULL, 0, NULL, &available, NULL) || available > 0) return true;
+        if (timeoutMs >= 0 && lspNow() >= end) return false;
+        Sleep(1);
+    }
+}
+
+#else
+
+uint64_t lspNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+// Wait until there's something to read, or timeoutMs (-1 is forever) passes
+bool lspWaitForInput(int timeoutMs) {
+    struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+    int ready = poll(&input, 1, timeoutMs);
+    return ready > 0 || (ready < 0 && errno != EINTR);
+}
+
+#endif // _WIN32
+
+void lspSkipSpace(LspParser* parser) {
+    while (isspace((unsigned char) parser->data[parser->pos])) ++parser->pos;
+}
+
+bool lspParseWord(LspParser* parser, const char* word) {
+    size_t len = strlen(word);
+    if (strncmp(parser->data + parser->pos, word, len) != 0) return false;
+    parser->pos += len;
+    return true;
+}
+
+bool lspParseHex(LspParser* parser, uint32_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        char c = parser->data[parser->pos++];
+        uint32_t digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        *value = *value << 4 | digit;
+    }
+    return true;
+}
+
+// Write a code point as UTF-8, and return how many bytes that took
+size_t lspPutUtf8(char* out, uint32_t code) {
+    if (code < 0x80) {
+        out[0] = code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = 0xC0 | code >> 6;
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = 0xE0 | code >> 12;
+        out[1] = 0x80 | (code >> 6 & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | code >> 18;
+    out[1] = 0x80 | (code >> 12 & 0x3F);
+    out[2] = 0x80 | (code >> 6 & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+// Decode the string that starts right after the opening quote
+bool lspParseString(LspParser* parser, Nob_String_View* string) {
+    char* start = parser->data + parser->pos;
+    char* out = start;
+    for (;;) {
+        char c = parser->data[parser->pos++];
+        if (c == '"') break;
+        if (c == '\0') return false;
+        if (c != '\\') {
+            *out++ = c;
+            continue;
+        }
+        c = parser->data[parser->pos++];
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/': *out++ = c;    break;
+        case 'b': *out++ = '\b'; break;
+        case 'f': *out++ = '\f'; break;
+        case 'n': *out++ = '\n'; break;
+        case 'r': *out++ = '\r'; break;
+        case 't': *out++ = '\t'; break;
+        case 'u': {
+            uint32_t code;
+            if (!lspParseHex(parser, &code)) return false;
+            // Characters outside the BMP are written as two surrogates
+            if (code >= 0xD800 && code < 0xDC00 && parser->data[parser->pos] == '\\' && parser->data[parser->pos + 1] == 'u') {
+                parser->pos += 2;
+                uint32_t low;
+                if (!lspParseHex(parser, &low)) return false;
+                code = low >= 0xDC00 && low < 0xE000 ? 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00) : 0xFFFD;
+            }
+            out += lspPutUtf8(out, code);
+        } break;
+        default: return false;
+        }
+    }
+    *string = nob_sv_from_parts(start, out - start);
+    return true;
+}
+
+// Parse a value and everything in it, and put its index in index
+bool lspParseValue(LspParser* parser, size_t depth, size_t* index) {
+    if (depth > LSP_MAX_DEPTH) return false;
+    lspSkipSpace(parser);
+    *index = parser->values->count;
+    nob_da_append(parser->values, (LspJson) {0});
+    // Parsing what's inside moves the values around, so this one is only ever reached by its index
+
+    char c = parser->data[parser->pos];
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        parser->values->items[*index].type = object ? LSP_JSON_OBJECT : LSP_JSON_ARRAY;
+        ++parser->pos;
+        lspSkipSpace(parser);
+        if (parser->data[parser->pos] == close) {
+            ++parser->pos;
+            return true;
+        }
+        size_t last = 0;
+        for (;;) {
+            Nob_String_View key = {0};
+            if (object) {
+                lspSkipSpace(parser);
+                if (parser->data[parser->pos++] != '"' || !lspParseString(parser, &key)) return false;
+                lspSkipSpace(parser);
+                if (parser->data[parser->pos++] != ':') return false;
+            }
+            size_t member;
+            if (!lspParseValue(parser, depth + 1, &member)) return false;
+            parser->values->items[member].key = key;
+            if (last == 0) parser->values->items[*index].child = member;
+            else parser->values->items[last].next = member;
+            last = member;
+            lspSkipSpace(parser);
+            char next = parser->data[parser->pos++];
+            if (next == close) return true;
+            if (next != ',') return false;
+        }
+    }
+    if (c == '"') {
+        ++parser->pos;
+        parser->values->items[*index].type = LSP_JSON_STRING;
+        return lspParseString(parser, &parser->values->items[*index].string);
+    }
+    if (lspParseWord(parser, "true")) {
+        parser->values->items[*index].type = LSP_JSON_TRUE;
+        return true;
+    }
+    if (lspParseWord(parser, "false")) {
+        parser->values->items[*index].type = LSP_JSON_FALSE;
+        return true;
+    }
+    if (lspParseWord(parser, "null")) return true;
+
+    char* end;
+    parser->values->items[*index].type = LSP_JSON_NUMBER;
+    parser->values->items[*index].number = strtod(parser->data + parser->pos, &end);
+    if (end == parser->data + parser->pos) return false;
+    parser->pos = end - parser->data;
+    return true;
+}
+
+// Parse the body of the message that's being handled into lsp->json. The message itself is at index 1
+bool lspParse(Lsp* lsp) {
+    lsp->json.count = 0;
+    nob_da_append(&lsp->json, (LspJson) {0});
+    LspParser parser = { .data = lsp->body.items, .values = &lsp->json };
+    size_t message;
+    if (!lspParseValue(&parser, 0, &message)) return false;
+    lspSkipSpace(&parser);
+    return parser.data[parser.pos] == '\0';
+}
+
+// Follow a path of member names separated by dots from a value, like "params.textDocument.uri". Gives 0 if it isn't there
+size_t lspGet(const Lsp* lsp, size_t value, const char* path) {
+    while (value != 0 && *path != '\0') {
+        const char* dot = strchr(path, '.');
+        size_t len = dot != NULL ? (size_t) (dot - path) : strlen(path);
+        if (lsp->json.items[value].type != LSP_JSON_OBJECT) return 0;
+        size_t member = lsp->json.items[value].child;
+        while (member != 0 && !nob_sv_eq(lsp->json.items[member].key, nob_sv_from_parts(path, len))) member = lsp->json.items[member].next;
+        value = member;
+        path += dot != NULL ? len + 1 : len;
+    }
+    return value;
+}
+
+// Get a number that's a line or character, which is 0 if it isn't there
+size_t lspGetSize(const Lsp* lsp, size_t value, const char* path) {
+    const LspJson* json = &lsp->json.items[lspGet(lsp, value, path)];
+    if (json->type != LSP_JSON_NUMBER || json->number < 0) return 0;
+    return json->number;
+}
+
+Nob_String_View lspGetString(const Lsp* lsp, size_t value, const char* path) {
+    const LspJson* json = &lsp->json.items[lspGet(lsp, value, path)];
+    if (json->type != LSP_JSON_STRING) return nob_sv_from_parts("", 0);
+    return json->string;
+}
+
+void lspAppendString(Nob_String_Builder* out, Nob_String_View string) {
+    nob_da_append(out, '"');
+    for (size_t i = 0; i < string.count; ++i) {
+        unsigned char c = string.data[i];
+        if (c == '"' || c == '\\') {
+            nob_da_append(out, '\\');
+            nob_da_append(out, c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            nob_sb_append_cstr(out, escaped);
+        } else {
+            nob_da_append(out, c);
+        }
+    }
+    nob_da_append(out, '"');
+}
+
+void lspAppendSize(Nob_String_Builder* out, size_t value) {
+    char digits[32];
+    snprintf(digits, sizeof(digits), "%zu", value);
+    nob_sb_append_cstr(out, digits);
+}
+
+// Append the id of the request that's being handled, as it was sent
+void lspAppendId(Nob_String_Builder* out, const LspJson* id) {
+    if (id->type == LSP_JSON_STRING) {
+        lspAppendString(out, id->string);
+    } else if (id->type == LSP_JSON_NUMBER) {
+        char number[32];
+        snprintf(number, sizeof(number), "%.17g", id->number);
+        nob_sb_append_cstr(out, number);
+    } else {
+        nob_sb_append_cstr(out, "null");
+    }
+}
+
+// Write lsp->out to stdout as a message
+void lspSend(Lsp* lsp) {
+    fprintf(stdout, "Content-Length: %zu\r\n\r\n", lsp->out.count);
+    fwrite(lsp->out.items, 1, lsp->out.count, stdout);
+    fflush(stdout);
+}
+
+// Start the response to a request in lsp->out, up to where its result goes
+void lspBeginResult(Lsp* lsp, size_t id) {
+    lsp->out.count = 0;
+    nob_sb_append_cstr(&lsp->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    lspAppendId(&lsp->out, &lsp->json.items[id]);
+    nob_sb_append_cstr(&lsp->out, ",\"result\":");
+}
+
+void lspSendError(Lsp* lsp, size_t id, int code, const char* message) {
+    lsp->out.count = 0;
+    nob_sb_append_cstr(&lsp->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    lspAppendId(&lsp->out, &lsp->json.items[id]);
+    nob_sb_append_cstr(&lsp->out, ",\"error\":{\"code\":");
+    char number[16];
+    snprintf(number, sizeof(number), "%d", code);
+    nob_sb_append_cstr(&lsp->out, number);
+    nob_sb_append_cstr(&lsp->out, ",\"message\":");
+    lspAppendString(&lsp->out, nob_sv_from_cstr(message));
+    nob_sb_append_cstr(&lsp->out, "}}");
+    lspSend(lsp);
+}
+
+// How many bytes a UTF-8 character that starts with a certain byte takes
+size_t lspUtf8Size(unsigned char c) {
+    if (c < 0xC0) return 1;
+    if (c < 0xE0) return 2;
+    if (c < 0xF0) return 3;
+    return 4;
+}
+
+// Where a character in a line is, in bytes. LSP counts characters in UTF-16 code units, so some take two
+size_t lspByteOffset(const LspLine* line, size_t character) {
+    size_t i = 0;
+    size_t units = 0;
+    while (i < line->len && units < character) {
+        size_t size = lspUtf8Size(line->text[i]);
+        units += size == 4 ? 2 : 1;
+        i += size;
+    }
+    return i < line->len ? i : line->len;
+}
+
+// The length of a line in UTF-16 code units
+size_t lspCharacterCount(const LspLine* line) {
+    size_t units = 0;
+    for (size_t i = 0; i < line->len; i += lspUtf8Size(line->text[i])) units += lspUtf8Size(line->text[i]) == 4 ? 2 : 1;
+    return units;
+}
+
+bool lspIsBlank(const LspLine* line) {
+    for (size_t i = 0; i < line->len; ++i) {
+        if (!isspace((unsigned char) line->text[i])) return false;
+    }
+    return true;
+}
+
+char* lspCopy(const char* text, size_t len) {
+    char* copy = malloc(len + 1);
+    NOB_ASSERT(copy != NULL && "Buy more RAM lol");
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// Split text into lines at any kind of line break, and append them (not scanned yet)
+void lspSplitLines(Nob_String_View text, LspLines* lines) {
+    size_t start = 0;
+    for (size_t i = 0; i <= text.count; ++i) {
+        if (i < text.count && text.data[i] != '\n' && text.data[i] != '\r') continue;
+        LspLine line = { .text = lspCopy(text.data + start, i - start), .len = i - start };
+        nob_da_append(lines, line);
+        if (i + 1 < text.count && text.data[i] == '\r' && text.data[i + 1] == '\n') ++i;
+        start = i + 1;
+    }
+}
+
+void lspFreeLines(LspLines* lines) {
+    for (size_t i = 0; i < lines->count; ++i) free(lines->items[i].text);
+    lines->count = 0;
+}
+
+/* Replace a range of a document with some text. Only the lines the range is in are replaced, so all the others keep
+ * their scansion
+ */
+void lspEdit(LspDocument* document, size_t startLine, size_t startCharacter, size_t endLine, size_t endCharacter, Nob_String_View text) {
+    LspLines* lines = &document->lines;
+    // A range past the end of the document means the end of it
+    if (startLine >= lines->count) {
+        startLine = lines->count - 1;
+        startCharacter = SIZE_MAX;
+    }
+    if (endLine >= lines->count) {
+        endLine = lines->count - 1;
+        endCharacter = SIZE_MAX;
+    }
+    if (endLine < startLine) endLine = startLine;
+    const LspLine* first = &lines->items[startLine];
+    const LspLine* last = &lines->items[endLine];
+    size_t startByte = lspByteOffset(first, startCharacter);
+    size_t endByte = lspByteOffset(last, endCharacter);
+    if (endLine == startLine && endByte < startByte) endByte = startByte;
+
+    Nob_String_Builder joined = {0};
+    recordReserve(&joined, startByte + text.count + last->len - endByte);
+    nob_sb_append_buf(&joined, first->text, startByte);
+    nob_sb_append_buf(&joined, text.data, text.count);
+    nob_sb_append_buf(&joined, last->text + endByte, last->len - endByte);
+    LspLines added = {0};
+    lspSplitLines(nob_sv_from_parts(joined.items, joined.count), &added);
+    nob_sb_free(joined);
+
+    size_t removed = endLine - startLine + 1;
+    for (size_t i = startLine; i <= endLine; ++i) free(lines->items[i].text);
+    size_t oldCount = lines->count;
+    while (lines->count < oldCount - removed + added.count) nob_da_append(lines, (LspLine) {0});
+    memmove(lines->items + startLine + added.count, lines->items + endLine + 1, (oldCount - endLine - 1)*sizeof(LspLine));
+    memcpy(lines->items + startLine, added.items, added.count*sizeof(LspLine));
+    lines->count = oldCount - removed + added.count;
+    nob_da_free(added);
+}
+
+LspDocument* lspFindDocument(Lsp* lsp, Nob_String_View uri) {
+    for (size_t i = 0; i < lsp->documents.count; ++i) {
+        LspDocument* document = &lsp->documents.items[i];
+        if (nob_sv_eq(nob_sv_from_cstr(document->uri), uri)) return document;
+    }
+    return NULL;
+}
+
+// Scan a line, unless it was scanned since it last changed or a line with the same text was scanned before
+const LspScan* lspScanLine(Lsp* lsp, LspLine* line) {
+    if (line->scanned) return &line->scan;
+    uint32_t hash = lexiconHash(line->text, line->len, 0);
+    LspCacheEntry* entry = &lsp->cache[hash % LSP_CACHE_SIZE];
+    if (entry->text == NULL || entry->hash != hash || entry->len != line->len || memcmp(entry->text, line->text, line->len) != 0) {
+        DhVerse* verse = &lsp->verse;
+        dhScanLine(&lsp->ctx, line->text, verse);
+        LspScan* scan = &entry->scan;
+        memset(scan, 0, sizeof(*scan));
+        scan->status = verse->status;
+        scan->syllableCount = verse->syllableCount;
+        scan->meter = verse->meter;
+        if (verse->status == DH_OK || verse->status == DH_INCOMPLETE) {
+            size_t len = 0;
+            for (size_t i = 0; i < verse->syllableCount && i < MAX_SYLLABLES; ++i) {
+                if (i > 0 && verse->syllableNumbers[i] != ' ') scan->label[len++] = ' ';
+                scan->label[len++] = verse->syllableLengths[i];
+            }
+        }
+        free(entry->text);
+        entry->text = lspCopy(line->text, line->len);
+        entry->len = line->len;
+        entry->hash = hash;
+    }
+    line->scan = entry->scan;
+    line->scanned = true;
+    return &line->scan;
+}
+
+void lspAppendPosition(Nob_String_Builder* out, size_t line, size_t character) {
+    nob_sb_append_cstr(out, "{\"line\":");
+    lspAppendSize(out, line);
+    nob_sb_append_cstr(out, ",\"character\":");
+    lspAppendSize(out, character);
+    nob_da_append(out, '}');
+}
+
+// Send the diagnostics of every verse in a document that doesn't scan. A document that's closed gets none
+void lspPublishDiagnostics(Lsp* lsp, LspDocument* document, bool closed) {
+    Nob_String_Builder* out = &lsp->out;
+    out->count = 0;
+    nob_sb_append_cstr(out, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    lspAppendString(out, nob_sv_from_cstr(document->uri));
+    nob_sb_append_cstr(out, ",\"diagnostics\":[");
+    bool first = true;
+    for (size_t i = 0; i < document->lines.count && !closed; ++i) {
+        LspLine* line = &document->lines.items[i];
+        if (lspIsBlank(line)) continue;
+        const LspScan* scan = lspScanLine(lsp, line);
+        if (scan->status == DH_OK) continue;
+
+        char message[256];
+        const ScansionMeter* meter = &scansionMeters[scan->meter];
+        if (scan->status == DH_TOO_FEW_SYLLABLES || scan->status == DH_TOO_MANY_SYLLABLES) {
+            snprintf(
+                message, sizeof(message), "%s: %zu syllables, but a %s has %zu to %zu", dhStatusName(scan->status),
+                scan->syllableCount, meter->name, meter->minSyllables, meter->maxSyllables
+            );
+        } else {
+            snprintf(message, sizeof(message), "%s", dhStatusName(scan->status));
+        }
+
+        if (!first) nob_da_append(out, ',');
+        first = false;
+        nob_sb_append_cstr(out, "{\"range\":{\"start\":");
+        lspAppendPosition(out, i, 0);
+        nob_sb_append_cstr(out, ",\"end\":");
+        lspAppendPosition(out, i, lspCharacterCount(line));
+        nob_sb_append_cstr(out, "},\"severity\":");
+        lspAppendSize(out, scan->status == DH_INCOMPLETE ? LSP_SEVERITY_WARNING : LSP_SEVERITY_ERROR);
+        nob_sb_append_cstr(out, ",\"source\":\"dactylichexameter\",\"message\":");
+        lspAppendString(out, nob_sv_from_cstr(message));
+        nob_da_append(out, '}');
+    }
+    nob_sb_append_cstr(out, "]}}");
+    lspSend(lsp);
+}
+
+// Answer textDocument/inlayHint with the scansion of every verse in the range, at the end of its line
+void lspInlayHints(Lsp* lsp, size_t id, size_t params) {
+    LspDocument* document = lspFindDocument(lsp, lspGetString(lsp, params, "textDocument.uri"));
+    lspBeginResult(lsp, id);
+    nob_da_append(&lsp->out, '[');
+    if (document != NULL) {
+        size_t start = lspGetSize(lsp, params, "range.start.line");
+        size_t end = lspGetSize(lsp, params, "range.end.line");
+        bool first = true;
+        for (size_t i = start; i <= end && i < document->lines.count; ++i) {
+            LspLine* line = &document->lines.items[i];
+            if (lspIsBlank(line)) continue;
+            const LspScan* scan = lspScanLine(lsp, line);
+            if (scan->label[0] == '\0') continue;
+
+            if (!first) nob_da_append(&lsp->out, ',');
+            first = false;
+            nob_sb_append_cstr(&lsp->out, "{\"position\":");
+            lspAppendPosition(&lsp->out, i, lspCharacterCount(line));
+            nob_sb_append_cstr(&lsp->out, ",\"label\":");
+            // Say which meter it is when it could be any of them
+            if (lsp->options.scan.detectMeter) {
+                char label[64];
+                snprintf(label, sizeof(label), "%s %s", scan->label, dhMeterName(scan->meter));
+                lspAppendString(&lsp->out, nob_sv_from_cstr(label));
+            } else {
+                lspAppendString(&lsp->out, nob_sv_from_cstr(scan->label));
+            }
+            nob_sb_append_cstr(&lsp->out, ",\"paddingLeft\":true}");
+        }
+    }
+    nob_sb_append_cstr(&lsp->out, "]}");
+    lspSend(lsp);
+}
+
+void lspDidChange(Lsp* lsp, size_t params) {
+    LspDocument* document = lspFindDocument(lsp, lspGetString(lsp, params, "textDocument.uri"));
+    if (document == NULL) return;
+    size_t changes = lspGet(lsp, params, "contentChanges");
+    if (lsp->json.items[changes].type != LSP_JSON_ARRAY) return;
+    for (size_t change = lsp->json.items[changes].child; change != 0; change = lsp->json.items[change].next) {
+        Nob_String_View text = lspGetString(lsp, change, "text");
+        if (lspGet(lsp, change, "range") == 0) {
+            // The whole document
+            lspFreeLines(&document->lines);
+            lspSplitLines(text, &document->lines);
+            continue;
+        }
+        lspEdit(
+            document,
+            lspGetSize(lsp, change, "range.start.line"), lspGetSize(lsp, change, "range.start.character"),
+            lspGetSize(lsp, change, "range.end.line"), lspGetSize(lsp, change, "range.end.character"),
+            text
+        );
+    }
+    document->dirty = true;
+    document->deadline = lspNow() + lsp->options.debounceMs*1000000;
+}
+
+// Handle the message in lsp->body
+void lspHandle(Lsp* lsp) {
+    if (!lspParse(lsp)) {
+        lsp->json.count = 1;
+        lspSendError(lsp, 0, LSP_PARSE_ERROR, "The message isn't valid JSON");
+        return;
+    }
+    size_t id = lspGet(lsp, 1, "id");
+    size_t params = lspGet(lsp, 1, "params");
+    size_t methodValue = lspGet(lsp, 1, "method");
+    if (lsp->json.items[methodValue].type != LSP_JSON_STRING) {
+        // Responses to requests of ours don't have a method, but this server doesn't send any requests
+        if (id != 0 && lspGet(lsp, 1, "result") == 0 && lspGet(lsp, 1, "error") == 0) {
+            lspSendError(lsp, id, LSP_INVALID_REQUEST, "The request has no method");
+        }
+        return;
+    }
+    Nob_String_View method = lsp->json.items[methodValue].string;
+
+    if (nob_sv_eq(method, nob_sv_from_cstr("initialize"))) {
+        lspBeginResult(lsp, id);
+        nob_sb_append_cstr(
+            &lsp->out,
+            "{\"capabilities\":{\"positionEncoding\":\"utf-16\",\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+            "\"inlayHintProvider\":true},\"serverInfo\":{\"name\":\"dactylichexameter\"}}}"
+        );
+        lspSend(lsp);
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("shutdown"))) {
+        lsp->shutdown = true;
+        lspBeginResult(lsp, id);
+        nob_sb_append_cstr(&lsp->out, "null}");
+        lspSend(lsp);
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("exit"))) {
+        lsp->exited = true;
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("textDocument/didOpen"))) {
+        Nob_String_View uri = lspGetString(lsp, params, "textDocument.uri");
+        LspDocument* document = lspFindDocument(lsp, uri);
+        if (document == NULL) {
+            nob_da_append(&lsp->documents, (LspDocument) { .uri = lspCopy(uri.data, uri.count) });
+            document = &lsp->documents.items[lsp->documents.count - 1];
+        }
+        lspFreeLines(&document->lines);
+        lspSplitLines(lspGetString(lsp, params, "textDocument.text"), &document->lines);
+        // Show what's wrong with a document right when it's opened
+        lspPublishDiagnostics(lsp, document, false);
+        document->dirty = false;
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("textDocument/didChange"))) {
+        lspDidChange(lsp, params);
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("textDocument/didClose"))) {
+        LspDocument* document = lspFindDocument(lsp, lspGetString(lsp, params, "textDocument.uri"));
+        if (document == NULL) return;
+        lspPublishDiagnostics(lsp, document, true);
+        lspFreeLines(&document->lines);
+        nob_da_free(document->lines);
+        free(document->uri);
+        *document = lsp->documents.items[--lsp->documents.count];
+    } else if (nob_sv_eq(method, nob_sv_from_cstr("textDocument/inlayHint"))) {
+        lspInlayHints(lsp, id, params);
+    } else if (id != 0) {
+        lspSendError(lsp, id, LSP_METHOD_NOT_FOUND, "Unknown method");
+    }
+}
+
+// Compare the name of a header without caring about case
+bool lspHeaderIs(Nob_String_View name, const char* expected) {
+    size_t len = strlen(expected);
+    if (name.count != len) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (tolower((unsigned char) name.data[i]) != expected[i]) return false;
+    }
+    return true;
+}
+
+// Move the next whole message from lsp->in to lsp->body. Returns false if it hasn't fully come in yet
+bool lspNextMessage(Lsp* lsp) {
+    for (;;) {
+        size_t headerEnd = 0;
+        while (headerEnd + 4 <= lsp->in.count && memcmp(lsp->in.items + headerEnd, "\r\n\r\n", 4) != 0) ++headerEnd;
+        if (headerEnd + 4 > lsp->in.count) return false;
+
+        Nob_String_View header = nob_sv_from_parts(lsp->in.items, headerEnd);
+        bool hasLength = false;
+        size_t length = 0;
+        while (header.count > 0) {
+            Nob_String_View value = nob_sv_chop_by_delim(&header, '\n');
+            Nob_String_View name = nob_sv_trim(nob_sv_chop_by_delim(&value, ':'));
+            if (lspHeaderIs(name, "content-length")) {
+                value = nob_sv_trim(value);
+                char number[32] = {0};
+                memcpy(number, value.data, value.count < sizeof(number) - 1 ? value.count : sizeof(number) - 1);
+                char* end;
+                length = strtoull(number, &end, 10);
+                hasLength = value.count > 0 && *end == '\0';
+            }
+        }
+        size_t bodyStart = headerEnd + 4;
+        if (!hasLength) {
+            nob_log(NOB_ERROR, "Skipping a message without a Content-Length");
+            memmove(lsp->in.items, lsp->in.items + bodyStart, lsp->in.count - bodyStart);
+            lsp->in.count -= bodyStart;
+            continue;
+        }
+        if (lsp->in.count - bodyStart < length) return false;
+
+        lsp->body.count = 0;
+        nob_sb_append_buf(&lsp->body, lsp->in.items + bodyStart, length);
+        nob_sb_append_null(&lsp->body);
+        memmove(lsp->in.items, lsp->in.items + bodyStart + length, lsp->in.count - bodyStart - length);
+        lsp->in.count -= bodyStart + length;
+        return true;
+    }
+}
+
+// Send the diagnostics of the documents that haven't changed for long enough, and return how long until the next one is due
+int lspPublishDue(Lsp* lsp) {
+    uint64_t now = lspNow();
+    int timeoutMs = -1;
+    for (size_t i = 0; i < lsp->documents.count; ++i) {
+        LspDocument* document = &lsp->documents.items[i];
+        if (!document->dirty) continue;
+        if (now >= document->deadline) {
+            lspPublishDiagnostics(lsp, document, false);
+            document->dirty = false;
+            continue;
+        }
+        int wait = (document->deadline - now + 999999)/1000000;
+        if (timeoutMs < 0 || wait < timeoutMs) timeoutMs = wait;
+    }
+    return timeoutMs;
+}
+
+bool lspRun(LspOptions options) {
+    if (options.debounceMs == 0) options.debounceMs = LSP_DEFAULT_DEBOUNCE_MS;
+#ifdef _WIN32
+    // Content-Length counts bytes, so nothing may turn "\n" into "\r\n"
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    Lsp lsp = {
+        .options = options,
+        .ctx = {
+            .meter = options.scan.meter,
+            .detectMeter = options.scan.detectMeter,
+            .lexicon = options.scan.lexicon,
+            .ngram = options.scan.ngram,
+        },
+    };
+    lsp.cache = calloc(LSP_CACHE_SIZE, sizeof(LspCacheEntry));
+    NOB_ASSERT(lsp.cache != NULL && "Buy more RAM lol");
+
+    while (!lsp.exited) {
+        while (!lsp.exited && lspNextMessage(&lsp)) lspHandle(&lsp);
+        if (lsp.exited) break;
+        int timeoutMs = lspPublishDue(&lsp);
+        if (!lspWaitForInput(timeoutMs)) continue;
+
+        recordReserve(&lsp.in, LSP_READ_SIZE);
+        int received = read(0, lsp.in.items + lsp.in.count, LSP_READ_SIZE);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            if (received < 0) nob_log(NOB_ERROR, "Couldn't read from stdin: %s", strerror(errno));
+            break;
+        }
+        lsp.in.count += received;
+    }
+
+    for (size_t i = 0; i < lsp.documents.count; ++i) {
+        lspFreeLines(&lsp.documents.items[i].lines);
+        nob_da_free(lsp.documents.items[i].lines);
+        free(lsp.documents.items[i].uri);
+    }
+    nob_da_free(lsp.documents);
+    for (size_t i = 0; i < LSP_CACHE_SIZE; ++i) free(lsp.cache[i].text);
+    free(lsp.cache);
+    nob_sb_free(lsp.in);
+    nob_sb_free(lsp.body);
+    nob_sb_free(lsp.out);
+    nob_da_free(lsp.json);
+    dhContextFree(&lsp.ctx);
+    return lsp.shutdown;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A language server (LSP) over stdin and stdout, so editors can show the scansion of Latin verse while it's being
+ * typed. Every line of an open document is a verse: its scansion is shown as an inlay hint at the end of the line, and
+ * verses that don't scan get a diagnostic.
+ *
+ * Editors send every change as an edit of a range of the document (incremental sync), and only the lines an edit
+ * touches are scanned again. The results are also remembered by the text of the line, so undoing an edit or writing
+ * the same verse twice doesn't scan anything. The diagnostics are only sent once the editor has been quiet for a
+ * moment, so a keystroke costs at most the scan of the line it's on.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+#define LSP_DEFAULT_DEBOUNCE_MS 150
+
+typedef struct {
+    // How to scan
+    DhScanSettings scan;
+    // How long a document has to stay the same before its diagnostics are sent, in milliseconds. 0 means LSP_DEFAULT_DEBOUNCE_MS
+    size_t debounceMs;
+} LspOptions;
+
+// Serve until the editor says to exit or closes stdin. Returns false unless the editor asked to shut down first
+bool lspRun(LspOptions options);
@@ -1,11 +1,138 @@
 #include "dactylichexameter.h"
+#include "batch.h"
+#include "pipeline.h"
+#include "shard.h"
+#include "checkpoint.h"
+#include "records.h"
+#include "columnar.h"
+#include "lexicon.h"
+#include "memory.h"
+#include "ngram.h"
+#include "server.h"
+#include "lsp.h"
+#include "shm.h"
 #define NOB_IMPLEMENTATION
 #include "nob.h"
 
-int main(void) {
+void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [mode]\n", program);
+    fprintf(stderr, "Modes:\n");
+    fprintf(stderr, "    (none)                          Scan verses entered one by one\n");
+    fprintf(stderr, "    --batch [options]               Scan every line from stdin and write the results to stdout\n");
+    fprintf(stderr, "    --pipeline [-j threads] [-b lines] [options]\n");
+    fprintf(stderr, "                                    Like --batch, but with multiple scanner threads, for big or endless streams\n");
+    fprintf(stderr, "        Options:\n");
+    fprintf(stderr, "        -i <input>                  Read the verses from a file instead of stdin\n");
+    fprintf(stderr, "        -o <output>                 Write the results to a file instead of stdout\n");
+    fprintf(stderr, "        --format <format>           The output format: text (default), binary, jsonl, csv, columnar or check\n");
+    fprintf(stderr, "                                    columnar needs -o, and doesn't support checkpoints\n");
+    fprintf(stderr, "        --meter <meter>             The meter: hexameter (default), pentameter, tetrameter, or detect to use whichever fits best\n");
+    fprintf(stderr, "        --lexicon <lexicon>         Use the vowel quantities of the words in a lexicon (see --compile-lexicon)\n");
+    fprintf(stderr, "        --ngram <model>             Break ties between lengths with an n-gram model (see --train-ngram)\n");
+    fprintf(stderr, "        --memory <memory>           Learn the vowel quantities of words from the verses that scan completely, and use\n");
+    fprintf(stderr, "                                    them for the verses after them. The memory is loaded from and saved to this file\n");
+    fprintf(stderr, "                                    (--batch only)\n");
+    fprintf(stderr, "        --checkpoint <verses>       Save the progress to <output>.checkpoint every so many verses (default %d)\n", CHECKPOINT_DEFAULT_INTERVAL);
+    fprintf(stderr, "        --resume                    Continue from <output>.checkpoint\n");
+    fprintf(stderr, "    --serve [-p port] [-j threads] [--queue requests] [--timeout ms] [--meter meter] [--lexicon lexicon] [--ngram model]\n");
+    fprintf(stderr, "                                    Serve POST /scan (one verse) and POST /batch (one verse per line) over HTTP on\n");
+    fprintf(stderr, "                                    127.0.0.1 (port %d by default), answering with JSON records\n", SERVER_DEFAULT_PORT);
+    fprintf(stderr, "    --shm-serve [--name name] [-j threads] [--slots slots] [--meter meter] [--lexicon lexicon] [--ngram model]\n");
+    fprintf(stderr, "                                    Scan the verses other processes put in shared memory (%s by default)\n", SHM_DEFAULT_NAME);
+    fprintf(stderr, "    --shm-client [--name name]      Scan every line from stdin through a --shm-serve daemon, and write JSON records\n");
+    fprintf(stderr, "    --lsp [--debounce ms] [--meter meter] [--lexicon lexicon] [--ngram model]\n");
+    fprintf(stderr, "                                    Run a language server on stdin and stdout, which shows the scansion of every line\n");
+    fprintf(stderr, "                                    of a document as an inlay hint and the lines that don't scan as diagnostics\n");
+    fprintf(stderr, "    --shard <shards> -o <output> [-m manifest] [--manifest-only] [options] <input files...>\n");
+    fprintf(stderr, "                                    Split the input files into shards, scan them in seperate processes and merge the results.\n");
+    fprintf(stderr, "                                    Takes --format (except columnar), --meter, --lexicon and --ngram from the options above\n");
+    fprintf(stderr, "    --worker <manifest> <index>     Scan one shard of a shard manifest\n");
+    fprintf(stderr, "    --read-columnar <file> [verses...]\n");
+    fprintf(stderr, "                                    Print the records of some verses (or all of them) from a columnar file as JSON lines\n");
+    fprintf(stderr, "    --compile-lexicon <words> <lexicon>\n");
+    fprintf(stderr, "                                    Compile a list of words with macrons and breves (one per line) into a lexicon\n");
+    fprintf(stderr, "    --train-ngram <scanned> <model> Learn an n-gram model of syllable lengths from the text output of --batch\n");
+}
+
+bool parseSize(const char* program, const char* flag, int* argc, char*** argv, size_t* value) {
+    if (*argc == 0) {
+        nob_log(NOB_ERROR, "%s expects a number", flag);
+        usage(program);
+        return false;
+    }
+    const char* arg = nob_shift_args(argc, argv);
+    char* end;
+    unsigned long long parsed = strtoull(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0') {
+        nob_log(NOB_ERROR, "%s expects a number, not %s", flag, arg);
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+// The flags that say how to scan, which every mode that scans verses takes
+typedef struct {
+    DhMeter meter;
+    bool detectMeter;
+    const char* lexiconPath;
+    const char* ngramPath;
+    // Opened by scanModelsOpen
+    Lexicon lexicon;
+    NgramModel ngram;
+} ScanModels;
+
+bool isScanFlag(const char* flag) {
+    return strcmp(flag, "--meter") == 0 || strcmp(flag, "--lexicon") == 0 || strcmp(flag, "--ngram") == 0;
+}
+
+// Parse one of the flags isScanFlag accepts
+bool parseScanFlag(const char* program, const char* flag, int* argc, char*** argv, ScanModels* models) {
+    if (*argc == 0) {
+        nob_log(NOB_ERROR, "%s expects a value", flag);
+        usage(program);
+        return false;
+    }
+    const char* value = nob_shift_args(argc, argv);
+    if (strcmp(flag, "--meter") == 0) {
+        models->detectMeter = strcmp(value, "detect") == 0;
+        if (!models->detectMeter && !dhMeterFromName(value, &models->meter)) {
+            nob_log(NOB_ERROR, "Unknown meter %s", value);
+            return false;
+        }
+    } else if (strcmp(flag, "--lexicon") == 0) {
+        models->lexiconPath = value;
+    } else {
+        models->ngramPath = value;
+    }
+    return true;
+}
+
+// Open the lexicon and the n-gram model that were asked for, and fill in settings with them and the meter
+bool scanModelsOpen(ScanModels* models, DhScanSettings* settings) {
+    settings->meter = models->meter;
+    settings->detectMeter = models->detectMeter;
+    if (models->lexiconPath != NULL) {
+        if (!lexiconOpen(&models->lexicon, models->lexiconPath)) return false;
+        settings->lexicon = &models->lexicon;
+    }
+    if (models->ngramPath != NULL) {
+        if (!ngramLoad(&models->ngram, models->ngramPath)) return false;
+        settings->ngram = &models->ngram;
+    }
+    return true;
+}
+
+void scanModelsClose(ScanModels* models) {
+    lexiconClose(&models->lexicon);
+    ngramFree(&models->ngram);
+}
+
+int interactive(void) {
     char sentence[128] = {0};
     char yesno[16] = {0};
-    Nob_String_Builder sbElision = {0};
+    DhContext ctx = {0};
+    DhVerse verse;
     Nob_String_Builder sbNumbers = {0};
     Nob_String_Builder sbScan = {0};
     Nob_String_Builder sbStrippedLine = {0};
@@ -16,37 +143,405 @@ int main(void) {
 
         // Get the verse to scan
         printf("\nIntrare versum: ");
-        fgets(sentence, 128, stdin);
+        if (fgets(sentence, 128, stdin) == NULL) break;
 
         printf("\n");
 
-        // Perform elision
-        if (!dhElision(sentence, &sbElision)) continue;
-        nob_sb_append_null(&sbElision);
-        printf("Elision: %s\n", sbElision.items);
-
-        printf("\n");
+        // Perform elision and scan the verse, reading it differently if it doesn't fit otherwise
+        DhStatus status = dhScanLine(&ctx, sentence, &verse);
+        if (status != DH_EMPTY_VERSE) {
+            printf("Elision: %s\n", ctx.elision.items);
+            printf("\n");
+        }
+        if (!dhLogStatus(&verse)) continue;
 
-        // Scan the verse
-        if (!dhScan(sbElision.items, &sbNumbers, &sbScan, &sbStrippedLine)) continue;
+        dhRenderVerse(&ctx, &verse, &sbNumbers, &sbScan, &sbStrippedLine);
         nob_sb_append_null(&sbNumbers);
         nob_sb_append_null(&sbScan);
         nob_sb_append_null(&sbStrippedLine);
         printf("%s\n", sbNumbers.items);
         printf("%s\n", sbScan.items);
         printf("%s\n", sbStrippedLine.items);
-        
+
         printf("\n");
 
         printf("Do you want to scan another verse? [Y/n] ");
-        fgets(yesno, 16, stdin);
-        if (tolower(yesno[0]) == 'n')
+        if (fgets(yesno, 16, stdin) == NULL || tolower(yesno[0]) == 'n')
             break;
     }
 
-    nob_sb_free(sbElision);
+    dhContextFree(&ctx);
     nob_sb_free(sbNumbers);
     nob_sb_free(sbScan);
     nob_sb_free(sbStrippedLine);
     return 0;
-}
\ No newline at end of file
+}
+
+// Run --batch or --pipeline
+int runBatch(const char* program, const char* mode, int argc, char** argv) {
+    bool pipeline = strcmp(mode, "--pipeline") == 0;
+    PipelineOptions options = {0};
+    OutputFormat format = OUTPUT_TEXT;
+    ScanModels models = { .meter = DH_METER_HEXAMETER };
+    const char* memoryPath = NULL;
+    const char* inputPath = NULL;
+    const char* outputPath = NULL;
+    size_t checkpointInterval = 0;
+    bool resume = false;
+    while (argc > 0) {
+        const char* flag = nob_shift_args(&argc, &argv);
+        if (pipeline && strcmp(flag, "-j") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.threadCount)) return 1;
+        } else if (pipeline && strcmp(flag, "-b") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.batchLines)) return 1;
+        } else if (strcmp(flag, "-i") == 0 && argc > 0) {
+            inputPath = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "-o") == 0 && argc > 0) {
+            outputPath = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "--checkpoint") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &checkpointInterval)) return 1;
+        } else if (strcmp(flag, "--resume") == 0) {
+            resume = true;
+        } else if (strcmp(flag, "--format") == 0 && argc > 0) {
+            if (!parseOutputFormat(nob_shift_args(&argc, &argv), &format)) return 1;
+        } else if (isScanFlag(flag)) {
+            if (!parseScanFlag(program, flag, &argc, &argv, &models)) return 1;
+        } else if (!pipeline && strcmp(flag, "--memory") == 0 && argc > 0) {
+            memoryPath = nob_shift_args(&argc, &argv);
+        } else {
+            nob_log(NOB_ERROR, "Unknown flag %s", flag);
+            usage(program);
+            return 1;
+        }
+    }
+    if ((resume || checkpointInterval > 0) && outputPath == NULL) {
+        nob_log(NOB_ERROR, "Checkpoints need an output file (-o)");
+        return 1;
+    }
+    if (format == OUTPUT_COLUMNAR) {
+        if (outputPath == NULL) {
+            nob_log(NOB_ERROR, "The columnar format needs an output file (-o)");
+            return 1;
+        }
+        if (resume || checkpointInterval > 0) {
+            nob_log(NOB_ERROR, "The columnar format doesn't support checkpoints");
+            return 1;
+        }
+    }
+
+    WordMemory memory = {0};
+    FILE* in = stdin;
+    // Without an output file there's nothing to checkpoint, but the checkpointer still counts the statistics
+    Checkpointer checkpointer = { .interval = checkpointInterval, .memory = memoryPath != NULL ? &memory : NULL };
+    BatchOutput output = {
+        .format = format,
+        .memory = memoryPath != NULL ? &memory : NULL,
+        .file = stdout,
+        .checkpointer = &checkpointer,
+    };
+    bool result = true;
+
+    if (!scanModelsOpen(&models, &output.scan)) nob_return_defer(false);
+    if (memoryPath != NULL && !memoryLoad(&memory, memoryPath)) nob_return_defer(false);
+
+    if (inputPath != NULL) {
+        in = fopen(inputPath, "rb");
+        if (in == NULL) {
+            nob_log(NOB_ERROR, "Couldn't open %s: %s", inputPath, strerror(errno));
+            in = stdin;
+            nob_return_defer(false);
+        }
+    }
+
+    if (format == OUTPUT_COLUMNAR) {
+        output.file = NULL;
+        // The writer holds a whole block of every column, which is a bit much for the stack
+        ColumnarWriter* columnar = malloc(sizeof(ColumnarWriter));
+        NOB_ASSERT(columnar != NULL && "Buy more RAM lol");
+        if (!columnarWriterOpen(columnar, outputPath)) {
+            free(columnar);
+            nob_return_defer(false);
+        }
+        output.columnar = columnar;
+    } else if (outputPath != NULL) {
+        checkpointer.path = nob_temp_sprintf("%s.checkpoint", outputPath);
+        if (!checkpointOpenOutput(&checkpointer, outputPath, resume, in, inputPath != NULL ? 0 : -1, &output.file)) {
+            output.file = stdout;
+            nob_return_defer(false);
+        }
+        output.sourceOffset = checkpointer.progress.inputOffset;
+    }
+
+    // A CSV file starts with the names of the columns, but only once, not again when resuming
+    if (format == OUTPUT_CSV && checkpointer.progress.outputOffset == 0) {
+        fputs(RECORD_CSV_HEADER, output.file);
+        checkpointAdvance(&checkpointer, output.file, 0, strlen(RECORD_CSV_HEADER), (BatchStats) {0});
+    }
+
+    result = pipeline
+        ? pipelineRun(in, options, &output)
+        : batchRun(in, -1, &output);
+    if (result && memoryPath != NULL && !memorySave(&memory, memoryPath)) result = false;
+
+defer:
+    if (output.columnar != NULL) {
+        if (!columnarWriterClose(output.columnar)) result = false;
+        free(output.columnar);
+    } else if (output.file != NULL && output.file != stdout && fclose(output.file) != 0) {
+        result = false;
+    }
+    if (in != stdin) fclose(in);
+    scanModelsClose(&models);
+    memoryFree(&memory);
+
+    if (result) {
+        checkpointFinish(&checkpointer);
+        BatchStats stats = checkpointer.progress.stats;
+        nob_log(NOB_INFO, "Scanned %zu verses: %zu succeeded, %zu failed", stats.verses, stats.scanned, stats.failed);
+    }
+    return result ? 0 : 1;
+}
+
+// Run --serve
+int runServer(const char* program, int argc, char** argv) {
+    ServerOptions options = {0};
+    ScanModels models = { .meter = DH_METER_HEXAMETER };
+    while (argc > 0) {
+        const char* flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "-p") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.port)) return 1;
+        } else if (strcmp(flag, "-j") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.threadCount)) return 1;
+        } else if (strcmp(flag, "--queue") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.queueSize)) return 1;
+        } else if (strcmp(flag, "--timeout") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.timeoutMs)) return 1;
+        } else if (isScanFlag(flag)) {
+            if (!parseScanFlag(program, flag, &argc, &argv, &models)) return 1;
+        } else {
+            nob_log(NOB_ERROR, "Unknown flag %s", flag);
+            usage(program);
+            return 1;
+        }
+    }
+
+    bool ok = scanModelsOpen(&models, &options.scan) && serverRun(options);
+    scanModelsClose(&models);
+    return ok ? 0 : 1;
+}
+
+// Run --shm-serve
+int runShmServe(const char* program, int argc, char** argv) {
+    ShmOptions options = {0};
+    ScanModels models = { .meter = DH_METER_HEXAMETER };
+    while (argc > 0) {
+        const char* flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "--name") == 0 && argc > 0) {
+            options.name = nob_shift_args(&argc, &argv);
+        } else if (strcmp(flag, "-j") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.threadCount)) return 1;
+        } else if (strcmp(flag, "--slots") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.slotCount)) return 1;
+        } else if (isScanFlag(flag)) {
+            if (!parseScanFlag(program, flag, &argc, &argv, &models)) return 1;
+        } else {
+            nob_log(NOB_ERROR, "Unknown flag %s", flag);
+            usage(program);
+            return 1;
+        }
+    }
+
+    bool ok = scanModelsOpen(&models, &options.scan) && shmServe(options);
+    scanModelsClose(&models);
+    return ok ? 0 : 1;
+}
+
+// Run --shm-client
+int runShmClient(const char* program, int argc, char** argv) {
+    const char* name = NULL;
+    while (argc > 0) {
+        const char* flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "--name") == 0 && argc > 0) {
+            name = nob_shift_args(&argc, &argv);
+        } else {
+            nob_log(NOB_ERROR, "Unknown flag %s", flag);
+            usage(program);
+            return 1;
+        }
+    }
+
+    ShmClient client;
+    if (!shmClientOpen(&client, name)) return 1;
+    RecordWriter writer = {0};
+    recordWriterInit(&writer, stdout, RECORD_FORMAT_JSONL);
+    Nob_String_Builder line = {0};
+    bool ok = true;
+    while (ok && batchReadLine(stdin, &line, NULL)) {
+        DhRecord record;
+        if (!shmClientScan(&client, line.items, line.count - 1, &record)) {
+            nob_log(NOB_ERROR, "The daemon stopped before every verse was scanned");
+            ok = false;
+        } else {
+            ok = recordWriterWrite(&writer, &record);
+        }
+    }
+    if (!recordWriterClose(&writer)) ok = false;
+    nob_sb_free(line);
+    shmClientClose(&client);
+    return ok ? 0 : 1;
+}
+
+// Run --lsp
+int runLsp(const char* program, int argc, char** argv) {
+    LspOptions options = {0};
+    ScanModels models = { .meter = DH_METER_HEXAMETER };
+    while (argc > 0) {
+        const char* flag = nob_shift_args(&argc, &argv);
+        if (strcmp(flag, "--debounce") == 0) {
+            if (!parseSize(program, flag, &argc, &argv, &options.debounceMs)) return 1;
+        } else if (isScanFlag(flag)) {
+            if (!parseScanFlag(program, flag, &argc, &argv, &models)) return 1;
+        } else {
+            nob_log(NOB_ERROR, "Unknown flag %s", flag);
+            usage(program);
+            return 1;
+        }
+    }
+
+    bool ok = scanModelsOpen(&models, &options.scan) && lspRun(options);
+    scanModelsClose(&models);
+    return ok ? 0 : 1;
+}
+
+// Run --read-columnar
+int readColumnar(const char* program, int argc, char** argv) {
+    if (argc == 0) {
+        usage(program);
+        return 1;
+    }
+    const char* path = nob_shift_args(&argc, &argv);
+    ColumnarReader reader = {0};
+    if (!columnarReaderOpen(&reader, path)) return 1;
+
+    Nob_String_Builder out = {0};
+    int result = 0;
+    // Without any verses, print all of them
+    bool all = argc == 0;
+    uint64_t n = 0;
+    for (;;) {
+        if (all) {
+            if (n >= reader.verseCount) break;
+        } else {
+            if (argc == 0) break;
+            size_t verse;
+            if (!parseSize(program, "--read-columnar", &argc, &argv, &verse)) nob_return_defer(1);
+            n = verse;
+        }
+
+        ColumnarRow row;
+        if (!columnarReaderGet(&reader, n, &row)) nob_return_defer(1);
+        out.count = 0;
+        recordAppendJson(&out, &row.record);
+        // Put the source offset in the same object
+        out.count -= 2;
+        nob_sb_append_cstr(&out, nob_temp_sprintf(",\"verse\":%llu,\"offset\":%llu}\n", (unsigned long long) n, (unsigned long long) row.sourceOffset));
+        nob_temp_reset();
+        fwrite(out.items, 1, out.count, stdout);
+        if (all) ++n;
+    }
+
+defer:
+    nob_sb_free(out);
+    columnarReaderClose(&reader);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* program = nob_shift_args(&argc, &argv);
+
+    if (argc == 0) return interactive();
+
+    const char* mode = nob_shift_args(&argc, &argv);
+    if (strcmp(mode, "--batch") == 0 || strcmp(mode, "--pipeline") == 0) {
+        return runBatch(program, mode, argc, argv);
+    } else if (strcmp(mode, "--shard") == 0) {
+        ShardOptions options = {0};
+        ScanModels models = { .meter = DH_METER_HEXAMETER };
+        if (!parseSize(program, mode, &argc, &argv, &options.shardCount)) return 1;
+        while (argc > 0) {
+            const char* flag = nob_shift_args(&argc, &argv);
+            if (strcmp(flag, "--format") == 0 && argc > 0) {
+                if (!parseOutputFormat(nob_shift_args(&argc, &argv), &options.settings.format)) return 1;
+            } else if (isScanFlag(flag)) {
+                if (!parseScanFlag(program, flag, &argc, &argv, &models)) return 1;
+            } else if (strcmp(flag, "-o") == 0 && argc > 0) {
+                options.outputPath = nob_shift_args(&argc, &argv);
+            } else if (strcmp(flag, "-m") == 0 && argc > 0) {
+                options.manifestPath = nob_shift_args(&argc, &argv);
+            } else if (strcmp(flag, "--manifest-only") == 0) {
+                options.manifestOnly = true;
+            } else if (flag[0] == '-') {
+                nob_log(NOB_ERROR, "Unknown flag %s", flag);
+                usage(program);
+                return 1;
+            } else {
+                nob_da_append(&options.inputPaths, flag);
+            }
+        }
+        // The workers open the lexicon and the n-gram model themselves
+        options.settings.meter = models.meter;
+        options.settings.detectMeter = models.detectMeter;
+        options.settings.lexiconPath = models.lexiconPath;
+        options.settings.ngramPath = models.ngramPath;
+        if (options.outputPath == NULL) {
+            nob_log(NOB_ERROR, "--shard needs an output file");
+            usage(program);
+            return 1;
+        }
+        if (options.settings.format == OUTPUT_COLUMNAR) {
+            nob_log(NOB_ERROR, "The columnar format can't be sharded, since the shards can't simply be put after each other");
+            return 1;
+        }
+        bool ok = shardCoordinate(program, options);
+        nob_da_free(options.inputPaths);
+        return ok ? 0 : 1;
+    } else if (strcmp(mode, "--worker") == 0) {
+        size_t index;
+        if (argc == 0) {
+            usage(program);
+            return 1;
+        }
+        const char* manifestPath = nob_shift_args(&argc, &argv);
+        if (!parseSize(program, mode, &argc, &argv, &index)) return 1;
+        return shardWorker(manifestPath, index) ? 0 : 1;
+    } else if (strcmp(mode, "--serve") == 0) {
+        return runServer(program, argc, argv);
+    } else if (strcmp(mode, "--shm-serve") == 0) {
+        return runShmServe(program, argc, argv);
+    } else if (strcmp(mode, "--shm-client") == 0) {
+        return runShmClient(program, argc, argv);
+    } else if (strcmp(mode, "--lsp") == 0) {
+        return runLsp(program, argc, argv);
+    } else if (strcmp(mode, "--read-columnar") == 0) {
+        return readColumnar(program, argc, argv);
+    } else if (strcmp(mode, "--compile-lexicon") == 0) {
+        if (argc != 2) {
+            usage(program);
+            return 1;
+        }
+        return lexiconCompile(argv[0], argv[1]) ? 0 : 1;
+    } else if (strcmp(mode, "--train-ngram") == 0) {
+        if (argc != 2) {
+            usage(program);
+            return 1;
+        }
+        return ngramTrain(argv[0], argv[1]) ? 0 : 1;
+    } else if (strcmp(mode, "--help") == 0 || strcmp(mode, "-h") == 0) {
+        usage(program);
+        return 0;
+    }
+
+    nob_log(NOB_ERROR, "Unknown mode %s", mode);
+    usage(program);
+    return 1;
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "memory.h"
+
+#define MEMORY_MAGIC "DHMEM001"
+#define MEMORY_MAGIC_SIZE 8
+#define MEMORY_INITIAL_CAPACITY 1024
+// A word is only used after this many verses taught it something, so one verse that scanned wrong can't decide it
+#define MEMORY_MIN_SEEN 3
+// A word is only used while at most 1 in this many sightings contradicted it
+#define MEMORY_MAX_CONFLICT_RATIO 4
+
+// Find the slot of a word, or the empty slot where it would go
+MemoryEntry* memoryFind(const WordMemory* memory, const char* word, size_t len) {
+    size_t slot = lexiconHash(word, len, 0) & (memory->capacity - 1);
+    for (;;) {
+        MemoryEntry* entry = &memory->entries[slot];
+        if (entry->len == 0 || (entry->len == len && memcmp(entry->word, word, len) == 0)) return entry;
+        slot = (slot + 1) & (memory->capacity - 1);
+    }
+}
+
+// Keep the table at most half full
+void memoryGrow(WordMemory* memory) {
+    if (memory->capacity > 0 && 2*(memory->count + 1) <= memory->capacity) return;
+    WordMemory bigger = {
+        .capacity = memory->capacity == 0 ? MEMORY_INITIAL_CAPACITY : 2*memory->capacity,
+        .count = memory->count,
+    };
+    bigger.entries = calloc(bigger.capacity, sizeof(MemoryEntry));
+    NOB_ASSERT(bigger.entries != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < memory->capacity; ++i) {
+        const MemoryEntry* entry = &memory->entries[i];
+        if (entry->len > 0) *memoryFind(&bigger, entry->word, entry->len) = *entry;
+    }
+    free(memory->entries);
+    *memory = bigger;
+}
+
+void memoryLearn(WordMemory* memory, const char* word, size_t len, uint32_t longMask, uint32_t shortMask) {
+    if (len == 0 || len > LEXICON_MAX_WORD || (longMask | shortMask) == 0) return;
+    memoryGrow(memory);
+    MemoryEntry* entry = memoryFind(memory, word, len);
+    if (entry->len == 0) {
+        memcpy(entry->word, word, len);
+        entry->len = len;
+        ++memory->count;
+    }
+    ++entry->seen;
+    uint32_t contradicted = (entry->longMask & shortMask) | (entry->shortMask & longMask);
+    if (contradicted != 0) ++entry->conflicts;
+    entry->longMask |= longMask & ~contradicted;
+    entry->shortMask |= shortMask & ~contradicted;
+}
+
+void memoryConfirm(WordMemory* memory, const char* word, size_t len) {
+    if (memory->count == 0 || len == 0 || len > LEXICON_MAX_WORD) return;
+    MemoryEntry* entry = memoryFind(memory, word, len);
+    if (entry->len > 0) ++entry->seen;
+}
+
+bool memoryLookup(const WordMemory* memory, const char* word, size_t len, uint32_t* longMask, uint32_t* shortMask) {
+    if (memory->count == 0 || len == 0 || len > LEXICON_MAX_WORD) return false;
+    const MemoryEntry* entry = memoryFind(memory, word, len);
+    if (entry->len == 0 || entry->seen < MEMORY_MIN_SEEN) return false;
+    if (entry->conflicts*MEMORY_MAX_CONFLICT_RATIO > entry->seen) return false;
+    *longMask = entry->longMask;
+    *shortMask = entry->shortMask;
+    return true;
+}
+
+bool memoryDecode(WordMemory* memory, const char* bytes, size_t size, const char* name) {
+    memoryFree(memory);
+    const uint8_t* data = (const uint8_t*) bytes;
+    size_t position = MEMORY_MAGIC_SIZE + 4;
+    if (size < position || memcmp(data, MEMORY_MAGIC, MEMORY_MAGIC_SIZE) != 0) goto invalid;
+    uint32_t wordCount = lexiconGetUint32(data + MEMORY_MAGIC_SIZE);
+    for (uint32_t i = 0; i < wordCount; ++i) {
+        if (position >= size) goto invalid;
+        size_t len = data[position++];
+        if (len == 0 || len > LEXICON_MAX_WORD || size - position < len + 16) goto invalid;
+        const char* word = bytes + position;
+        position += len;
+
+        memoryGrow(memory);
+        MemoryEntry* entry = memoryFind(memory, word, len);
+        if (entry->len > 0) goto invalid;
+        memcpy(entry->word, word, len);
+        entry->len = len;
+        entry->seen = lexiconGetUint32(data + position);
+        entry->conflicts = lexiconGetUint32(data + position + 4);
+        entry->longMask = lexiconGetUint32(data + position + 8);
+        entry->shortMask = lexiconGetUint32(data + position + 12);
+        position += 16;
+        ++memory->count;
+    }
+    if (position != size) goto invalid;
+    return true;
+
+invalid:
+    nob_log(NOB_ERROR, "%s isn't a valid word memory", name);
+    memoryFree(memory);
+    return false;
+}
+
+bool memoryLoad(WordMemory* memory, const char* path) {
+    memoryFree(memory);
+    int exists = nob_file_exists(path);
+    if (exists <= 0) return exists == 0;
+
+    Nob_String_Builder sb = {0};
+    bool result = nob_read_entire_file(path, &sb) && memoryDecode(memory, sb.items, sb.count, path);
+    if (result) nob_log(NOB_INFO, "Remembered %zu words from %s", memory->count, path);
+    nob_sb_free(sb);
+    return result;
+}
+
+void memoryAppend(const WordMemory* memory, Nob_String_Builder* out) {
+    nob_sb_append_cstr(out, MEMORY_MAGIC);
+    lexiconPutUint32(out, memory->count);
+    for (size_t i = 0; i < memory->capacity; ++i) {
+        const MemoryEntry* entry = &memory->entries[i];
+        if (entry->len == 0) continue;
+        nob_da_append(out, (char) entry->len);
+        nob_sb_append_buf(out, entry->word, entry->len);
+        lexiconPutUint32(out, entry->seen);
+        lexiconPutUint32(out, entry->conflicts);
+        lexiconPutUint32(out, entry->longMask);
+        lexiconPutUint32(out, entry->shortMask);
+    }
+}
+
+bool memorySave(const WordMemory* memory, const char* path) {
+    Nob_String_Builder out = {0};
+    memoryAppend(memory, &out);
+    bool result = nob_write_entire_file(path, out.items, out.count);
+    if (result) nob_log(NOB_INFO, "Saved %zu words to %s", memory->count, path);
+    nob_sb_free(out);
+    return result;
+}
+
+void memoryFree(WordMemory* memory) {
+    free(memory->entries);
+    memset(memory, 0, sizeof(*memory));
+}
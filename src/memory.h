@@ -0,0 +1,75 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A memory of the vowel quantities of words, learned while scanning. When a verse scans completely, the syllables whose
+ * length only depends on their vowel (not on the consonants after it) tell the quantity of that vowel, and every word
+ * remembers them for the verses after it. Words are keyed the same way as in the lexicon.
+ *
+ * Every time a word is seen, the quantities are compared with what it remembers. New vowels are added, and when they
+ * contradict it, that's counted as a conflict (and the old quantities stay). A word is only used once a few verses have
+ * taught it something, and a word with too many conflicts, like two different words that are spelled the same, isn't
+ * used at all.
+ *
+ * Layout of a saved memory (all numbers are little-endian):
+ *     "DHMEM001", u32 word count
+ *     for every word: its length as one byte, its letters, u32 times seen, u32 conflicts, u32 long mask, u32 short mask
+ */
+
+#pragma once
+#include "nob.h"
+#include "lexicon.h"
+#include <stdint.h>
+
+typedef struct {
+    char word[LEXICON_MAX_WORD];
+    // 0 if the slot is empty
+    uint8_t len;
+    uint32_t seen;
+    uint32_t conflicts;
+    // Bit n is set if letter n is a long or short vowel
+    uint32_t longMask;
+    uint32_t shortMask;
+} MemoryEntry;
+
+// A hash table with open addressing. Initialise it with {0}. It can only be used by one thread at a time
+typedef struct WordMemory {
+    MemoryEntry* entries;
+    // Always a power of 2
+    size_t capacity;
+    size_t count;
+} WordMemory;
+
+// Remember the quantities of a word, which is keyed the same way as for lexiconLookup
+void memoryLearn(WordMemory* memory, const char* word, size_t len, uint32_t longMask, uint32_t shortMask);
+
+// Count a sighting of a word that agreed with what it remembers, without learning anything from it
+void memoryConfirm(WordMemory* memory, const char* word, size_t len);
+
+// Like lexiconLookup. Returns false if the word hasn't been seen enough or contradicts itself too often
+bool memoryLookup(const WordMemory* memory, const char* word, size_t len, uint32_t* longMask, uint32_t* shortMask);
+
+// Load a saved memory, replacing what memory had. A file that doesn't exist is an empty memory
+bool memoryLoad(WordMemory* memory, const char* path);
+bool memorySave(const WordMemory* memory, const char* path);
+// The same as memoryLoad and memorySave, but for a memory that's part of something else. name is used for errors
+bool memoryDecode(WordMemory* memory, const char* bytes, size_t size, const char* name);
+void memoryAppend(const WordMemory* memory, Nob_String_Builder* out);
+void memoryFree(WordMemory* memory);
@@ -0,0 +1,172 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "ngram.h"
+#include "batch.h"
+#include "lexicon.h"
+
+#define NGRAM_MAGIC "DHNGR001"
+#define NGRAM_MAGIC_SIZE 8
+#define NGRAM_HEADER_SIZE (NGRAM_MAGIC_SIZE + 4 + 4)
+#define NGRAM_PREVIOUS_CONTEXTS (NGRAM_CONTEXTS + 1)
+#define NGRAM_TABLE_SIZE (NGRAM_CONTEXTS*NGRAM_PREVIOUS_CONTEXTS)
+// A pair of contexts (or a context on its own) needs to be seen this many times before its chance is used
+#define NGRAM_MIN_COUNT 20
+// The chance for contexts that were never seen enough
+#define NGRAM_EVEN_CHANCE 128
+
+static_assert(NGRAM_CONTEXTS < UINT16_MAX, "The contexts don't fit in 16 bits anymore");
+
+uint16_t ngramContext(NgramNucleus nucleus, NgramFollow follow, NgramWordPosition position) {
+    return (nucleus*COUNT_NGRAM_FOLLOWS + follow)*COUNT_NGRAM_WORD_POSITIONS + position;
+}
+
+typedef struct {
+    uint32_t counts[NGRAM_TABLE_SIZE][COUNT_DH_LENGTHS];
+    size_t verses;
+    size_t syllables;
+} NgramCounts;
+
+// Count the lengths of one scanned verse: its line of lengths and its stripped line, which line up
+void ngramCountVerse(DhContext* ctx, const Nob_String_Builder* lengths, const char* line, NgramCounts* counts) {
+    size_t syllablePositions[MAX_SYLLABLES];
+    uint16_t contexts[MAX_SYLLABLES];
+    size_t amountOfSyllables = dhSyllableContexts(ctx, line, syllablePositions, contexts);
+    if (amountOfSyllables == 0 || amountOfSyllables > MAX_SYLLABLES) return;
+
+    // Find the length under every syllable. The lengths line has spaces between the words too
+    char syllableLengths[MAX_SYLLABLES];
+    size_t found = 0;
+    size_t strippedIndex = 0;
+    for (size_t i = 0; line[i] != '\0' && found < amountOfSyllables; ++i) {
+        if (line[i] == ' ') continue;
+        if (syllablePositions[found] == strippedIndex) syllableLengths[found++] = i < lengths->count ? lengths->items[i] : ' ';
+        ++strippedIndex;
+    }
+    // If the syllables come out differently than when the verse was scanned (which can happen when marks were lost), skip it
+    if (found != amountOfSyllables) return;
+
+    ++counts->verses;
+    // The last syllable can be either length, so it doesn't say anything
+    for (size_t i = 0; i + 1 < amountOfSyllables; ++i) {
+        DhLength length;
+        if (syllableLengths[i] == '_') length = DH_LONG;
+        else if (syllableLengths[i] == 'u') length = DH_SHORT;
+        else continue;
+        uint16_t previous = i == 0 ? NGRAM_START : contexts[i - 1];
+        ++counts->counts[contexts[i]*NGRAM_PREVIOUS_CONTEXTS + previous][length];
+        ++counts->syllables;
+    }
+}
+
+// The chance of a long syllable from its counts, out of 255, or -1 if there aren't enough of them
+int ngramChance(uint64_t longCount, uint64_t shortCount) {
+    uint64_t total = longCount + shortCount;
+    if (total < NGRAM_MIN_COUNT) return -1;
+    return (longCount + 1)*255/(total + 2);
+}
+
+bool ngramTrain(const char* scannedPath, const char* modelPath) {
+    bool result = true;
+    DhContext ctx = {0};
+    Nob_String_Builder numbers = {0};
+    Nob_String_Builder lengths = {0};
+    Nob_String_Builder line = {0};
+    Nob_String_Builder out = {0};
+    NgramCounts* counts = calloc(1, sizeof(NgramCounts));
+    NOB_ASSERT(counts != NULL && "Buy more RAM lol");
+    FILE* in = fopen(scannedPath, "rb");
+    if (in == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", scannedPath, strerror(errno));
+        nob_return_defer(false);
+    }
+
+    // Every verse is its numbers, lengths and stripped line and then an empty line, or a line starting with '!' if it failed
+    while (batchReadLine(in, &numbers, NULL)) {
+        if (numbers.count <= 1 || numbers.items[0] == '!') continue;
+        if (!batchReadLine(in, &lengths, NULL) || !batchReadLine(in, &line, NULL)) break;
+        ngramCountVerse(&ctx, &lengths, line.items, counts);
+    }
+    if (ferror(in)) {
+        nob_log(NOB_ERROR, "Couldn't read %s: %s", scannedPath, strerror(errno));
+        nob_return_defer(false);
+    }
+
+    nob_sb_append_cstr(&out, NGRAM_MAGIC);
+    lexiconPutUint32(&out, NGRAM_CONTEXTS);
+    lexiconPutUint32(&out, NGRAM_PREVIOUS_CONTEXTS);
+    for (size_t context = 0; context < NGRAM_CONTEXTS; ++context) {
+        // The context on its own, for the pairs that weren't seen enough
+        uint64_t alone[COUNT_DH_LENGTHS] = {0};
+        for (size_t previous = 0; previous < NGRAM_PREVIOUS_CONTEXTS; ++previous) {
+            alone[DH_LONG] += counts->counts[context*NGRAM_PREVIOUS_CONTEXTS + previous][DH_LONG];
+            alone[DH_SHORT] += counts->counts[context*NGRAM_PREVIOUS_CONTEXTS + previous][DH_SHORT];
+        }
+        int aloneChance = ngramChance(alone[DH_LONG], alone[DH_SHORT]);
+        for (size_t previous = 0; previous < NGRAM_PREVIOUS_CONTEXTS; ++previous) {
+            const uint32_t* pair = counts->counts[context*NGRAM_PREVIOUS_CONTEXTS + previous];
+            int chance = ngramChance(pair[DH_LONG], pair[DH_SHORT]);
+            if (chance < 0) chance = aloneChance;
+            if (chance < 0) chance = NGRAM_EVEN_CHANCE;
+            nob_da_append(&out, (char) chance);
+        }
+    }
+    if (!nob_write_entire_file(modelPath, out.items, out.count)) nob_return_defer(false);
+    nob_log(NOB_INFO, "Learned from %zu syllables of %zu verses into %s", counts->syllables, counts->verses, modelPath);
+
+defer:
+    if (in != NULL) fclose(in);
+    dhContextFree(&ctx);
+    nob_sb_free(numbers);
+    nob_sb_free(lengths);
+    nob_sb_free(line);
+    nob_sb_free(out);
+    free(counts);
+    return result;
+}
+
+bool ngramLoad(NgramModel* model, const char* path) {
+    memset(model, 0, sizeof(*model));
+    Nob_String_Builder sb = {0};
+    if (!nob_read_entire_file(path, &sb)) return false;
+    const uint8_t* data = (const uint8_t*) sb.items;
+    if (
+        sb.count != NGRAM_HEADER_SIZE + NGRAM_TABLE_SIZE || memcmp(data, NGRAM_MAGIC, NGRAM_MAGIC_SIZE) != 0 ||
+        lexiconGetUint32(data + NGRAM_MAGIC_SIZE) != NGRAM_CONTEXTS || lexiconGetUint32(data + NGRAM_MAGIC_SIZE + 4) != NGRAM_PREVIOUS_CONTEXTS
+    ) {
+        nob_log(NOB_ERROR, "%s isn't a valid n-gram model", path);
+        nob_sb_free(sb);
+        return false;
+    }
+    // Only keep the chances
+    memmove(sb.items, sb.items + NGRAM_HEADER_SIZE, NGRAM_TABLE_SIZE);
+    model->chances = (uint8_t*) sb.items;
+    return true;
+}
+
+void ngramFree(NgramModel* model) {
+    free(model->chances);
+    model->chances = NULL;
+}
+
+uint8_t ngramLongChance(const NgramModel* model, uint16_t context, uint16_t previous) {
+    return model->chances[context*NGRAM_PREVIOUS_CONTEXTS + previous];
+}
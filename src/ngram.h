@@ -0,0 +1,91 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A model of how likely a syllable is to be long, learned from scanned verses. A syllable's context is what its
+ * nucleus is, what comes after it and where it is in its word, and the model has the chance of it being long for every
+ * context together with the context of the syllable before it (a bigram). Pairs that weren't seen often enough fall
+ * back to the context on its own. The scanner uses it to break the ties the meter leaves, with one lookup per syllable.
+ *
+ * Layout of a model file:
+ *     "DHNGR001", u32 amount of contexts, u32 amount of previous contexts (the contexts and the start of a verse)
+ *     for every context, for every previous context: the chance of a long syllable as one byte, 0 to 255
+ */
+
+#pragma once
+#include "nob.h"
+#include <stdint.h>
+
+typedef enum {
+    NGRAM_NUCLEUS_A,
+    NGRAM_NUCLEUS_E,
+    NGRAM_NUCLEUS_I,
+    NGRAM_NUCLEUS_O,
+    NGRAM_NUCLEUS_U,
+    NGRAM_NUCLEUS_Y,
+    NGRAM_NUCLEUS_DIPHTHONG,
+    COUNT_NGRAM_NUCLEI,
+} NgramNucleus;
+
+// What comes after the nucleus
+typedef enum {
+    // Another vowel (hiatus)
+    NGRAM_FOLLOW_VOWEL,
+    // One consonant ('qu' counts as one) and then a vowel
+    NGRAM_FOLLOW_ONE,
+    // A stop and a liquid in the same word
+    NGRAM_FOLLOW_MUTA_CUM_LIQUIDA,
+    // Two or more consonants, or an 'x'
+    NGRAM_FOLLOW_MORE,
+    // The end of the verse
+    NGRAM_FOLLOW_END,
+    COUNT_NGRAM_FOLLOWS,
+} NgramFollow;
+
+typedef enum {
+    // The word only has this syllable
+    NGRAM_WORD_ONLY,
+    NGRAM_WORD_FIRST,
+    NGRAM_WORD_MIDDLE,
+    NGRAM_WORD_LAST,
+    COUNT_NGRAM_WORD_POSITIONS,
+} NgramWordPosition;
+
+#define NGRAM_CONTEXTS (COUNT_NGRAM_NUCLEI*COUNT_NGRAM_FOLLOWS*COUNT_NGRAM_WORD_POSITIONS)
+// The previous context of the first syllable of a verse
+#define NGRAM_START NGRAM_CONTEXTS
+
+uint16_t ngramContext(NgramNucleus nucleus, NgramFollow follow, NgramWordPosition position);
+
+typedef struct NgramModel {
+    // NGRAM_CONTEXTS*(NGRAM_CONTEXTS + 1) chances
+    uint8_t* chances;
+} NgramModel;
+
+/* Learn a model from the text output of --batch or --pipeline (the numbers, lengths and stripped line of every verse)
+ * and write it to a file. Verses that couldn't be scanned and syllables with an unknown length are skipped
+ */
+bool ngramTrain(const char* scannedPath, const char* modelPath);
+
+bool ngramLoad(NgramModel* model, const char* path);
+void ngramFree(NgramModel* model);
+
+// The chance that a syllable is long after a syllable with the previous context, from 0 to 255
+uint8_t ngramLongChance(const NgramModel* model, uint16_t context, uint16_t previous);
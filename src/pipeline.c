@@ -0,0 +1,367 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "pipeline.h"
+#include "batch.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define PIPELINE_DEFAULT_BATCH_LINES 256
+// Hand a batch to the scanners early if its lines take up more than this many bytes
+#define PIPELINE_MAX_BATCH_BYTES (1024*1024)
+// The amount of batches per scanner thread. More batches means the scanners can get further ahead of the writer
+#define PIPELINE_BATCHES_PER_THREAD 4
+// How many times to look at an empty ring before going to sleep until something is pushed onto it
+#define PIPELINE_SPINS 1024
+
+// A group of lines that travels through the pipeline as one piece
+typedef struct {
+    // The position of this batch in the input, used by the writer to put the output back in order
+    size_t sequence;
+    // The lines, all NULL-terminated and stored one after the other
+    Nob_String_Builder lines;
+    size_t lineCount;
+    // The amount of bytes every line took up in the input
+    BatchLineSizes lineSizes;
+    // The scanned text of all the lines
+    Nob_String_Builder output;
+    BatchStats stats;
+} PipelineBatch;
+
+typedef struct {
+    _Atomic size_t sequence;
+    PipelineBatch* batch;
+} RingCell;
+
+/* A bounded lock-free queue that any amount of threads can push to and pop from (Dmitry Vyukov's MPMC queue).
+ * A thread that finds it empty for too long sleeps on nonEmpty, and only then does pushing take the lock to wake it up
+ */
+typedef struct {
+    RingCell* cells;
+    size_t mask;
+    // Keep the two positions on seperate cache lines, so the producers and consumers don't fight over them
+    _Alignas(64) _Atomic size_t pushPosition;
+    _Alignas(64) _Atomic size_t popPosition;
+    _Alignas(64) _Atomic size_t sleepers;
+    pthread_mutex_t lock;
+    pthread_cond_t nonEmpty;
+} Ring;
+
+void ringInit(Ring* ring, size_t minimumCapacity) {
+    size_t capacity = 1;
+    while (capacity < minimumCapacity) capacity *= 2;
+    ring->cells = malloc(capacity*sizeof(RingCell));
+    NOB_ASSERT(ring->cells != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < capacity; ++i) {
+        atomic_init(&ring->cells[i].sequence, i);
+        ring->cells[i].batch = NULL;
+    }
+    ring->mask = capacity - 1;
+    atomic_init(&ring->pushPosition, 0);
+    atomic_init(&ring->popPosition, 0);
+    atomic_init(&ring->sleepers, 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->nonEmpty, NULL);
+}
+
+void ringFree(Ring* ring) {
+    free(ring->cells);
+    ring->cells = NULL;
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->nonEmpty);
+}
+
+// Try to push a batch onto the ring. Returns false if the ring is full
+bool ringPush(Ring* ring, PipelineBatch* batch) {
+    RingCell* cell;
+    size_t position = atomic_load_explicit(&ring->pushPosition, memory_order_relaxed);
+    for (;;) {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->pushPosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&ring->pushPosition, memory_order_relaxed);
+        }
+    }
+    cell->batch = batch;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+// Try to pop a batch from the ring. Returns false if the ring is empty
+bool ringPop(Ring* ring, PipelineBatch** batch) {
+    RingCell* cell;
+    size_t position = atomic_load_explicit(&ring->popPosition, memory_order_relaxed);
+    for (;;) {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->popPosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (difference < 0) {
+            return false;
+        } else {
+            position = atomic_load_explicit(&ring->popPosition, memory_order_relaxed);
+        }
+    }
+    *batch = cell->batch;
+    atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+    return true;
+}
+
+// Push a batch onto a ring that has room for it, and wake up a thread that's waiting for it, if there is one
+void ringPushWake(Ring* ring, PipelineBatch* batch) {
+    bool pushed = ringPush(ring, batch);
+    NOB_ASSERT(pushed && "Every ring can hold all batches");
+    // A sleeper says so before it looks at the ring one last time, so either it sees this batch or we see it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleepers, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_signal(&ring->nonEmpty);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Pop a batch from a ring, spinning for a bit and then sleeping until there is one
+PipelineBatch* ringPopWait(Ring* ring) {
+    PipelineBatch* batch;
+    for (size_t i = 0; i < PIPELINE_SPINS; ++i) {
+        if (ringPop(ring, &batch)) return batch;
+    }
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->sleepers, 1);
+    while (!ringPop(ring, &batch)) pthread_cond_wait(&ring->nonEmpty, &ring->lock);
+    atomic_fetch_sub(&ring->sleepers, 1);
+    pthread_mutex_unlock(&ring->lock);
+    return batch;
+}
+
+typedef struct {
+    FILE* in;
+    BatchOutput* output;
+    size_t threadCount;
+    size_t batchLines;
+
+    size_t batchCount;
+    PipelineBatch* batches;
+
+    // Empty batches, waiting for the reader
+    Ring freeRing;
+    // Batches filled by the reader, waiting for a scanner
+    Ring workRing;
+    // Scanned batches, waiting for the writer
+    Ring doneRing;
+
+    // The total amount of batches, only known once the reader reaches the end of the input
+    _Atomic size_t totalBatches;
+    _Atomic bool readerDone;
+    _Atomic bool failed;
+} Pipeline;
+
+void* pipelineReader(void* arg) {
+    Pipeline* pipeline = arg;
+    Nob_String_Builder line = {0};
+    size_t sequence = 0;
+    bool endOfInput = false;
+    bool canBlock = batchInputCanBlock(pipeline->in);
+
+    while (!endOfInput && !atomic_load(&pipeline->failed)) {
+        // Waiting for an empty batch here is what stops the reader from running away from the scanners and the writer
+        PipelineBatch* batch = ringPopWait(&pipeline->freeRing);
+        batch->sequence = sequence;
+        batch->lines.count = 0;
+        batch->lineCount = 0;
+        batch->lineSizes.count = 0;
+        batch->output.count = 0;
+        memset(&batch->stats, 0, sizeof(batch->stats));
+
+        while (batch->lineCount < pipeline->batchLines && batch->lines.count < PIPELINE_MAX_BATCH_BYTES) {
+            // Don't sit on the verses that came in while we wait for the rest of the batch from a slow pipe
+            if (canBlock && batch->lineCount > 0 && batchInputWouldBlock(pipeline->in)) break;
+            size_t consumed;
+            if (!batchReadLine(pipeline->in, &line, &consumed)) {
+                endOfInput = true;
+                break;
+            }
+            nob_sb_append_buf(&batch->lines, line.items, line.count);
+            ++batch->lineCount;
+            nob_da_append(&batch->lineSizes, consumed);
+        }
+
+        if (batch->lineCount == 0) {
+            ringPushWake(&pipeline->freeRing, batch);
+            break;
+        }
+        ++sequence;
+        ringPushWake(&pipeline->workRing, batch);
+    }
+
+    if (ferror(pipeline->in)) {
+        nob_log(NOB_ERROR, "Couldn't read the verses: %s", strerror(errno));
+        atomic_store(&pipeline->failed, true);
+    }
+
+    atomic_store(&pipeline->totalBatches, sequence);
+    atomic_store(&pipeline->readerDone, true);
+    // Tell every scanner there's nothing more coming, and wake the writer up so it sees how many batches there are
+    for (size_t i = 0; i < pipeline->threadCount; ++i) ringPushWake(&pipeline->workRing, NULL);
+    ringPushWake(&pipeline->doneRing, NULL);
+
+    nob_sb_free(line);
+    return NULL;
+}
+
+void* pipelineScanner(void* arg) {
+    Pipeline* pipeline = arg;
+    BatchScratch scratch = {
+        .format = pipeline->output->format,
+        .ctx = {
+            .meter = pipeline->output->scan.meter,
+            .detectMeter = pipeline->output->scan.detectMeter,
+            .lexicon = pipeline->output->scan.lexicon,
+            .ngram = pipeline->output->scan.ngram,
+        },
+    };
+
+    for (;;) {
+        PipelineBatch* batch = ringPopWait(&pipeline->workRing);
+        if (batch == NULL) break;
+
+        const char* verse = batch->lines.items;
+        for (size_t i = 0; i < batch->lineCount; ++i) {
+            ++batch->stats.verses;
+            if (batchScanVerse(verse, &scratch, &batch->output))
+                ++batch->stats.scanned;
+            else
+                ++batch->stats.failed;
+            verse += strlen(verse) + 1;
+        }
+
+        ringPushWake(&pipeline->doneRing, batch);
+    }
+
+    batchScratchFree(&scratch);
+    return NULL;
+}
+
+void* pipelineWriter(void* arg) {
+    Pipeline* pipeline = arg;
+    // Batches that were scanned before the ones in front of them. There can never be more of them than there are batches,
+    // so a batch's sequence number modulo the amount of batches is a unique spot
+    PipelineBatch** pending = calloc(pipeline->batchCount, sizeof(PipelineBatch*));
+    NOB_ASSERT(pending != NULL && "Buy more RAM lol");
+    size_t nextSequence = 0;
+
+    for (;;) {
+        if (atomic_load(&pipeline->readerDone) && nextSequence == atomic_load(&pipeline->totalBatches)) break;
+
+        PipelineBatch* batch;
+        if (!ringPop(&pipeline->doneRing, &batch)) {
+            // Nothing to do right now, so make sure everything that's been written so far actually shows up
+            if (pipeline->output->file != NULL) fflush(pipeline->output->file);
+            batch = ringPopWait(&pipeline->doneRing);
+        }
+        // The reader is done, so check again whether every batch has been written
+        if (batch == NULL) continue;
+        pending[batch->sequence % pipeline->batchCount] = batch;
+
+        // Write every batch that's next in line
+        for (;;) {
+            PipelineBatch** slot = &pending[nextSequence % pipeline->batchCount];
+            if (*slot == NULL || (*slot)->sequence != nextSequence) break;
+            PipelineBatch* ready = *slot;
+            *slot = NULL;
+
+            if (!atomic_load(&pipeline->failed)) {
+                if (!batchWriteOutput(pipeline->output, &ready->output, &ready->lineSizes, ready->stats))
+                    atomic_store(&pipeline->failed, true);
+            }
+            ++nextSequence;
+            ringPushWake(&pipeline->freeRing, ready);
+        }
+    }
+
+    if (pipeline->output->file != NULL) fflush(pipeline->output->file);
+    free(pending);
+    return NULL;
+}
+
+size_t pipelineDefaultThreadCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (size_t) processors : 1;
+#endif
+}
+
+bool pipelineRun(FILE* in, PipelineOptions options, BatchOutput* output) {
+    Pipeline pipeline = {0};
+    pipeline.in = in;
+    pipeline.output = output;
+    pipeline.threadCount = options.threadCount > 0 ? options.threadCount : pipelineDefaultThreadCount();
+    pipeline.batchLines = options.batchLines > 0 ? options.batchLines : PIPELINE_DEFAULT_BATCH_LINES;
+    pipeline.batchCount = pipeline.threadCount*PIPELINE_BATCHES_PER_THREAD;
+
+    // Every ring must be able to hold all batches plus the messages telling the threads to stop, so pushing never has to wait
+    ringInit(&pipeline.freeRing, pipeline.batchCount + pipeline.threadCount);
+    ringInit(&pipeline.workRing, pipeline.batchCount + pipeline.threadCount);
+    ringInit(&pipeline.doneRing, pipeline.batchCount + pipeline.threadCount);
+    atomic_init(&pipeline.totalBatches, 0);
+    atomic_init(&pipeline.readerDone, false);
+    atomic_init(&pipeline.failed, false);
+
+    pipeline.batches = calloc(pipeline.batchCount, sizeof(PipelineBatch));
+    NOB_ASSERT(pipeline.batches != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < pipeline.batchCount; ++i) ringPush(&pipeline.freeRing, &pipeline.batches[i]);
+
+    pthread_t reader, writer;
+    pthread_t* scanners = malloc(pipeline.threadCount*sizeof(pthread_t));
+    NOB_ASSERT(scanners != NULL && "Buy more RAM lol");
+
+    pthread_create(&reader, NULL, pipelineReader, &pipeline);
+    for (size_t i = 0; i < pipeline.threadCount; ++i) pthread_create(&scanners[i], NULL, pipelineScanner, &pipeline);
+    pthread_create(&writer, NULL, pipelineWriter, &pipeline);
+
+    pthread_join(reader, NULL);
+    for (size_t i = 0; i < pipeline.threadCount; ++i) pthread_join(scanners[i], NULL);
+    pthread_join(writer, NULL);
+
+    for (size_t i = 0; i < pipeline.batchCount; ++i) {
+        nob_sb_free(pipeline.batches[i].lines);
+        nob_sb_free(pipeline.batches[i].output);
+        nob_da_free(pipeline.batches[i].lineSizes);
+    }
+    free(pipeline.batches);
+    free(scanners);
+    ringFree(&pipeline.freeRing);
+    ringFree(&pipeline.workRing);
+    ringFree(&pipeline.doneRing);
+
+    return !atomic_load(&pipeline.failed);
+}
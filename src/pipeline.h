@@ -0,0 +1,40 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "nob.h"
+#include "batch.h"
+
+typedef struct {
+    // The amount of scanner threads. 0 means one per processor
+    size_t threadCount;
+    // The maximum amount of lines in a batch that gets handed to a scanner thread. 0 means the default
+    size_t batchLines;
+} PipelineOptions;
+
+// The amount of processors that are available, used when no thread count is given
+size_t pipelineDefaultThreadCount(void);
+
+/* Scan a (possibly endless) stream of verses with a reader thread, a pool of scanner threads and a writer thread.
+ * The output is exactly the same as batchRun's, in the same order. Only a fixed amount of batches exists at any time,
+ * so the reader waits for the writer when the scanners can't keep up and memory use stays bounded.
+ * Only the writer thread touches output
+ */
+bool pipelineRun(FILE* in, PipelineOptions options, BatchOutput* output);
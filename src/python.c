@@ -0,0 +1,320 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A CPython extension around the scanner, built with `./nob python`. dactylichexameter.scan takes a list of verses, or
+ * one buffer (or str) with a verse on every line, and scans them on a pool of threads without holding the GIL. The
+ * results come back as a dict of memoryviews with one value per verse, which the scanner writes straight into, so
+ * there isn't a Python object for every verse and numpy.asarray can wrap them without copying:
+ *
+ *     status              uint8, an index into dactylichexameter.statuses
+ *     syllables           uint8
+ *     pattern             uint8, bit n is set if metrum n+1 is a dactyl
+ *     known, long         uint32, bit n is set if the length of syllable n is known, or if it's long
+ *     caesurae            uint8, the bits of DhCaesura
+ *     meter               uint8, an index into dactylichexameter.meters
+ *     dactyl_probability  float32, 5 per verse: the chance each of the first five metra is a dactyl
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "dactylichexameter.h"
+#include "lexicon.h"
+#include "ngram.h"
+#include "pipeline.h"
+#include "records.h"
+
+#define NOB_IMPLEMENTATION
+#include "nob.h"
+
+// The threads take this many verses at a time
+#define PYTHON_CHUNK_VERSES 1024
+
+typedef struct {
+    const char* const* lines;
+    size_t count;
+    // Where the results go, which is the memory of the buffers that are handed to Python
+    uint8_t* status;
+    uint8_t* syllables;
+    uint8_t* pattern;
+    uint32_t* known;
+    uint32_t* longMask;
+    uint8_t* caesurae;
+    uint8_t* meter;
+    float* dactylProbability;
+    // The first verse no thread has taken yet
+    _Atomic size_t next;
+    DhMeter meterToScan;
+    bool detectMeter;
+    const Lexicon* lexicon;
+    const NgramModel* ngram;
+} PythonScan;
+
+void* pythonScanner(void* arg) {
+    PythonScan* scan = arg;
+    DhContext ctx = {
+        .meter = scan->meterToScan,
+        .detectMeter = scan->detectMeter,
+        .lexicon = scan->lexicon,
+        .ngram = scan->ngram,
+    };
+    // The syllables of the verses don't go back to Python, so they go in arrays that are reused for every chunk
+    DhBatchResult result = {
+        .syllableOffsets = malloc((PYTHON_CHUNK_VERSES + 1)*sizeof(uint32_t)),
+        .syllablePositions = malloc(PYTHON_CHUNK_VERSES*MAX_SYLLABLES*sizeof(uint16_t)),
+        .longProbability = malloc(PYTHON_CHUNK_VERSES*MAX_SYLLABLES*sizeof(float)),
+    };
+    NOB_ASSERT(result.syllableOffsets != NULL && result.syllablePositions != NULL && result.longProbability != NULL && "Buy more RAM lol");
+
+    for (;;) {
+        size_t start = atomic_fetch_add(&scan->next, PYTHON_CHUNK_VERSES);
+        if (start >= scan->count) break;
+        size_t count = scan->count - start < PYTHON_CHUNK_VERSES ? scan->count - start : PYTHON_CHUNK_VERSES;
+        result.capacity = count;
+        result.status = scan->status + start;
+        result.syllableCount = scan->syllables + start;
+        result.footPattern = scan->pattern + start;
+        result.longMask = scan->longMask + start;
+        // The short syllables go where the known ones do, and the long ones are added to them after
+        result.shortMask = scan->known + start;
+        result.caesurae = scan->caesurae + start;
+        result.meter = scan->meter + start;
+        result.dactylProbability = scan->dactylProbability + start*5;
+        dhScanBatch(&ctx, scan->lines + start, count, &result);
+        for (size_t i = start; i < start + count; ++i) scan->known[i] |= scan->longMask[i];
+    }
+
+    free(result.syllableOffsets);
+    free(result.syllablePositions);
+    free(result.longProbability);
+    dhContextFree(&ctx);
+    return NULL;
+}
+
+// Make a bytearray of a certain size and a memoryview of it as a certain type. Returns NULL with an exception set on failure
+PyObject* pythonColumn(size_t count, size_t width, const char* format, void** data) {
+    PyObject* bytes = PyByteArray_FromStringAndSize(NULL, count*width);
+    if (bytes == NULL) return NULL;
+    *data = PyByteArray_AS_STRING(bytes);
+    PyObject* view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL) return NULL;
+    // memoryview can't cast to a shape with a 0 in it, so no verses is just an empty row of them
+    PyObject* typed = width == 5*sizeof(float) && count > 0
+        ? PyObject_CallMethod(view, "cast", "s(nn)", format, (Py_ssize_t) count, (Py_ssize_t) 5)
+        : PyObject_CallMethod(view, "cast", "s", format);
+    Py_DECREF(view);
+    return typed;
+}
+
+// Add a column to the result. Steals the reference to the column
+bool pythonAddColumn(PyObject* result, const char* name, PyObject* column) {
+    if (column == NULL) return false;
+    bool ok = PyDict_SetItemString(result, name, column) == 0;
+    Py_DECREF(column);
+    return ok;
+}
+
+static PyObject* pythonScan(PyObject* self, PyObject* args, PyObject* kwargs) {
+    NOB_UNUSED(self);
+    static char* keywords[] = {"verses", "threads", "meter", "lexicon", "ngram", NULL};
+    PyObject* verses;
+    Py_ssize_t threadCount = 0;
+    const char* meterName = "hexameter";
+    const char* lexiconPath = NULL;
+    const char* ngramPath = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nszz", keywords, &verses, &threadCount, &meterName, &lexiconPath, &ngramPath)) return NULL;
+
+    PythonScan scan = { .detectMeter = strcmp(meterName, "detect") == 0 };
+    if (!scan.detectMeter && !dhMeterFromName(meterName, &scan.meterToScan)) {
+        PyErr_Format(PyExc_ValueError, "Unknown meter %s", meterName);
+        return NULL;
+    }
+    if (threadCount < 0) {
+        PyErr_SetString(PyExc_ValueError, "threads can't be negative");
+        return NULL;
+    }
+
+    PyObject* result = NULL;
+    PyObject* items = NULL;
+    Py_buffer buffer = {0};
+    bool hasBuffer = false;
+    char* text = NULL;
+    const char** lines = NULL;
+    Lexicon lexicon = {0};
+    NgramModel ngram = {0};
+
+    if (lexiconPath != NULL) {
+        if (!lexiconOpen(&lexicon, lexiconPath)) {
+            PyErr_Format(PyExc_OSError, "Couldn't open the lexicon %s", lexiconPath);
+            goto defer;
+        }
+        scan.lexicon = &lexicon;
+    }
+    if (ngramPath != NULL) {
+        if (!ngramLoad(&ngram, ngramPath)) {
+            PyErr_Format(PyExc_OSError, "Couldn't load the n-gram model %s", ngramPath);
+            goto defer;
+        }
+        scan.ngram = &ngram;
+    }
+
+    if (PyUnicode_Check(verses) || PyObject_CheckBuffer(verses)) {
+        // One verse on every line. The scanner wants them NULL-terminated, so that's the one copy of them that's made
+        const char* data;
+        Py_ssize_t size;
+        if (PyUnicode_Check(verses)) {
+            data = PyUnicode_AsUTF8AndSize(verses, &size);
+            if (data == NULL) goto defer;
+        } else {
+            if (PyObject_GetBuffer(verses, &buffer, PyBUF_SIMPLE) < 0) goto defer;
+            hasBuffer = true;
+            data = buffer.buf;
+            size = buffer.len;
+        }
+        size_t count = 0;
+        for (Py_ssize_t i = 0; i < size; ++i) count += data[i] == '\n';
+        // A newline at the very end doesn't start another verse
+        if (size > 0 && data[size - 1] != '\n') ++count;
+        text = malloc(size + 1);
+        lines = malloc((count > 0 ? count : 1)*sizeof(const char*));
+        if (text == NULL || lines == NULL) {
+            PyErr_NoMemory();
+            goto defer;
+        }
+        memcpy(text, data, size);
+        text[size] = '\0';
+        size_t line = 0;
+        for (Py_ssize_t start = 0; start < size;) {
+            Py_ssize_t end = start;
+            while (end < size && text[end] != '\n') ++end;
+            text[end] = '\0';
+            if (end > start && text[end - 1] == '\r') text[end - 1] = '\0';
+            lines[line++] = text + start;
+            start = end + 1;
+        }
+        scan.count = count;
+    } else {
+        // Hold on to the verses themselves, so they stay alive while the GIL is released even if the list changes
+        items = PySequence_Tuple(verses);
+        if (items == NULL) goto defer;
+        scan.count = PyTuple_GET_SIZE(items);
+        lines = malloc((scan.count > 0 ? scan.count : 1)*sizeof(const char*));
+        if (lines == NULL) {
+            PyErr_NoMemory();
+            goto defer;
+        }
+        for (size_t i = 0; i < scan.count; ++i) {
+            PyObject* item = PyTuple_GET_ITEM(items, i);
+            if (PyUnicode_Check(item)) {
+                lines[i] = PyUnicode_AsUTF8(item);
+                if (lines[i] == NULL) goto defer;
+            } else if (PyBytes_Check(item)) {
+                lines[i] = PyBytes_AS_STRING(item);
+            } else {
+                PyErr_Format(PyExc_TypeError, "Verse %zu is a %s, not a str or bytes", i, Py_TYPE(item)->tp_name);
+                goto defer;
+            }
+        }
+    }
+    scan.lines = lines;
+
+    result = PyDict_New();
+    if (
+        result == NULL ||
+        !pythonAddColumn(result, "status", pythonColumn(scan.count, 1, "B", (void**) &scan.status)) ||
+        !pythonAddColumn(result, "syllables", pythonColumn(scan.count, 1, "B", (void**) &scan.syllables)) ||
+        !pythonAddColumn(result, "pattern", pythonColumn(scan.count, 1, "B", (void**) &scan.pattern)) ||
+        !pythonAddColumn(result, "known", pythonColumn(scan.count, sizeof(uint32_t), "I", (void**) &scan.known)) ||
+        !pythonAddColumn(result, "long", pythonColumn(scan.count, sizeof(uint32_t), "I", (void**) &scan.longMask)) ||
+        !pythonAddColumn(result, "caesurae", pythonColumn(scan.count, 1, "B", (void**) &scan.caesurae)) ||
+        !pythonAddColumn(result, "meter", pythonColumn(scan.count, 1, "B", (void**) &scan.meter)) ||
+        !pythonAddColumn(result, "dactyl_probability", pythonColumn(scan.count, 5*sizeof(float), "f", (void**) &scan.dactylProbability))
+    ) {
+        Py_CLEAR(result);
+        goto defer;
+    }
+
+    size_t threads = threadCount > 0 ? (size_t) threadCount : pipelineDefaultThreadCount();
+    size_t chunks = (scan.count + PYTHON_CHUNK_VERSES - 1)/PYTHON_CHUNK_VERSES;
+    if (threads > chunks) threads = chunks > 0 ? chunks : 1;
+    Py_BEGIN_ALLOW_THREADS
+    // The calling thread scans too, so it's one thread less to start
+    pthread_t* helpers = malloc(threads*sizeof(pthread_t));
+    NOB_ASSERT(helpers != NULL && "Buy more RAM lol");
+    for (size_t i = 1; i < threads; ++i) pthread_create(&helpers[i], NULL, pythonScanner, &scan);
+    pythonScanner(&scan);
+    for (size_t i = 1; i < threads; ++i) pthread_join(helpers[i], NULL);
+    free(helpers);
+    Py_END_ALLOW_THREADS
+
+defer:
+    if (hasBuffer) PyBuffer_Release(&buffer);
+    Py_XDECREF(items);
+    free(text);
+    free(lines);
+    lexiconClose(&lexicon);
+    ngramFree(&ngram);
+    return result;
+}
+
+static PyMethodDef pythonMethods[] = {
+    {
+        "scan", (PyCFunction) (void(*)(void)) pythonScan, METH_VARARGS | METH_KEYWORDS,
+        "scan(verses, threads=0, meter='hexameter', lexicon=None, ngram=None)\n"
+        "--\n\n"
+        "Scan a list of verses, or a buffer or str with a verse on every line. Returns a dict of memoryviews with a value\n"
+        "for every verse: status, syllables, pattern, known, long, caesurae, meter and dactyl_probability.\n"
+        "threads=0 uses one thread per processor, and meter can be 'detect' to use whichever fits best"
+    },
+    {0},
+};
+
+static struct PyModuleDef pythonModule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "dactylichexameter",
+    .m_doc = "Scan Latin verse in bulk",
+    .m_size = -1,
+    .m_methods = pythonMethods,
+};
+
+PyMODINIT_FUNC PyInit_dactylichexameter(void) {
+    PyObject* module = PyModule_Create(&pythonModule);
+    if (module == NULL) return NULL;
+    PyObject* statuses = PyTuple_New(COUNT_DH_STATUSES);
+    PyObject* meters = PyTuple_New(COUNT_DH_METERS);
+    if (statuses == NULL || meters == NULL) goto fail;
+    for (size_t i = 0; i < COUNT_DH_STATUSES; ++i) PyTuple_SET_ITEM(statuses, i, PyUnicode_FromString(recordStatusCode(i)));
+    for (size_t i = 0; i < COUNT_DH_METERS; ++i) PyTuple_SET_ITEM(meters, i, PyUnicode_FromString(dhMeterName(i)));
+    if (PyModule_AddObject(module, "statuses", statuses) < 0) goto fail;
+    statuses = NULL;
+    if (PyModule_AddObject(module, "meters", meters) < 0) goto fail;
+    return module;
+
+fail:
+    Py_XDECREF(statuses);
+    Py_XDECREF(meters);
+    Py_DECREF(module);
+    return NULL;
+}
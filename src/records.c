@@ -0,0 +1,183 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "records.h"
+
+// Flush the writer's buffer once it gets this big
+#define RECORD_WRITER_BUFFER_SIZE (1024*1024)
+// No record takes up more than this many bytes in any format
+#define RECORD_MAX_SIZE 256
+
+static const char* statusCodes[] = {
+    [DH_OK]                 = "ok",
+    [DH_INCOMPLETE]         = "incomplete",
+    [DH_EMPTY_VERSE]        = "empty",
+    [DH_TOO_FEW_SYLLABLES]  = "too_few",
+    [DH_TOO_MANY_SYLLABLES] = "too_many",
+};
+static_assert(NOB_ARRAY_LEN(statusCodes) == COUNT_DH_STATUSES, "Amount of statuses have changed");
+
+const char* recordStatusCode(uint8_t status) {
+    if (status >= COUNT_DH_STATUSES) return "unknown";
+    return statusCodes[status];
+}
+
+DhRecord recordFromVerse(const DhVerse* verse) {
+    DhRecord record = {
+        .status = verse->status,
+        .syllableCount = verse->syllableCount > 255 ? 255 : verse->syllableCount,
+        .footPattern = verse->footPattern & 0x1F,
+        .caesurae = verse->caesurae,
+        .meter = verse->meter,
+        .knownMask = verse->longMask | verse->shortMask,
+        .longMask = verse->longMask,
+    };
+    return record;
+}
+
+// Make sure there's room for at least a certain amount of extra bytes, so the appending below doesn't have to check every byte
+void recordReserve(Nob_String_Builder* out, size_t extra) {
+    if (out->count + extra <= out->capacity) return;
+    if (out->capacity == 0) out->capacity = NOB_DA_INIT_CAP;
+    while (out->count + extra > out->capacity) out->capacity *= 2;
+    out->items = NOB_REALLOC(out->items, out->capacity);
+    NOB_ASSERT(out->items != NULL && "Buy more RAM lol");
+}
+
+// Append a number in decimal. There has to be room for it already
+void recordPutUnsigned(Nob_String_Builder* out, uint32_t value) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) out->items[out->count++] = digits[--count];
+}
+
+// Append a string. There has to be room for it already
+void recordPutString(Nob_String_Builder* out, const char* string) {
+    size_t len = strlen(string);
+    memcpy(out->items + out->count, string, len);
+    out->count += len;
+}
+
+void recordPutUint32(Nob_String_Builder* out, uint32_t value) {
+    out->items[out->count++] = value & 0xFF;
+    out->items[out->count++] = (value >> 8) & 0xFF;
+    out->items[out->count++] = (value >> 16) & 0xFF;
+    out->items[out->count++] = (value >> 24) & 0xFF;
+}
+
+void recordAppendBinary(Nob_String_Builder* out, const DhRecord* record) {
+    recordReserve(out, RECORD_BINARY_SIZE);
+    out->items[out->count++] = record->status;
+    out->items[out->count++] = record->syllableCount;
+    out->items[out->count++] = record->footPattern | record->meter << 5;
+    out->items[out->count++] = record->caesurae;
+    recordPutUint32(out, record->knownMask);
+    recordPutUint32(out, record->longMask);
+}
+
+void recordAppendJson(Nob_String_Builder* out, const DhRecord* record) {
+    recordReserve(out, RECORD_MAX_SIZE);
+    recordPutString(out, "{\"status\":\"");
+    recordPutString(out, recordStatusCode(record->status));
+    recordPutString(out, "\",\"syllables\":");
+    recordPutUnsigned(out, record->syllableCount);
+    recordPutString(out, ",\"pattern\":");
+    recordPutUnsigned(out, record->footPattern);
+    recordPutString(out, ",\"known\":");
+    recordPutUnsigned(out, record->knownMask);
+    recordPutString(out, ",\"long\":");
+    recordPutUnsigned(out, record->longMask);
+    recordPutString(out, ",\"caesurae\":");
+    recordPutUnsigned(out, record->caesurae);
+    recordPutString(out, ",\"meter\":\"");
+    recordPutString(out, dhMeterName(record->meter));
+    recordPutString(out, "\"}\n");
+}
+
+void recordAppendCsv(Nob_String_Builder* out, const DhRecord* record) {
+    recordReserve(out, RECORD_MAX_SIZE);
+    recordPutString(out, recordStatusCode(record->status));
+    out->items[out->count++] = ',';
+    recordPutUnsigned(out, record->syllableCount);
+    out->items[out->count++] = ',';
+    recordPutUnsigned(out, record->footPattern);
+    out->items[out->count++] = ',';
+    recordPutUnsigned(out, record->knownMask);
+    out->items[out->count++] = ',';
+    recordPutUnsigned(out, record->longMask);
+    out->items[out->count++] = ',';
+    recordPutUnsigned(out, record->caesurae);
+    out->items[out->count++] = ',';
+    recordPutString(out, dhMeterName(record->meter));
+    out->items[out->count++] = '\n';
+}
+
+DhRecord recordDecodeBinary(const uint8_t* bytes) {
+    DhRecord record = {
+        .status = bytes[0],
+        .syllableCount = bytes[1],
+        .footPattern = bytes[2] & 0x1F,
+        .caesurae = bytes[3],
+        .meter = bytes[2] >> 5,
+        .knownMask = bytes[4] | bytes[5] << 8 | bytes[6] << 16 | (uint32_t) bytes[7] << 24,
+        .longMask = bytes[8] | bytes[9] << 8 | bytes[10] << 16 | (uint32_t) bytes[11] << 24,
+    };
+    return record;
+}
+
+void recordWriterInit(RecordWriter* writer, FILE* file, RecordFormat format) {
+    writer->file = file;
+    writer->format = format;
+    writer->buffer = (Nob_String_Builder) {0};
+    recordReserve(&writer->buffer, RECORD_WRITER_BUFFER_SIZE + RECORD_MAX_SIZE);
+}
+
+bool recordWriterFlush(RecordWriter* writer) {
+    if (writer->buffer.count == 0) return true;
+    bool result = fwrite(writer->buffer.items, 1, writer->buffer.count, writer->file) == writer->buffer.count;
+    writer->buffer.count = 0;
+    return result;
+}
+
+void recordAppend(Nob_String_Builder* out, RecordFormat format, const DhRecord* record) {
+    switch (format) {
+    case RECORD_FORMAT_BINARY: recordAppendBinary(out, record); break;
+    case RECORD_FORMAT_JSONL:  recordAppendJson(out, record);   break;
+    case RECORD_FORMAT_CSV:    recordAppendCsv(out, record);    break;
+    case COUNT_RECORD_FORMATS: NOB_UNREACHABLE("recordAppend");
+    }
+}
+
+bool recordWriterWrite(RecordWriter* writer, const DhRecord* record) {
+    recordAppend(&writer->buffer, writer->format, record);
+    if (writer->buffer.count >= RECORD_WRITER_BUFFER_SIZE) return recordWriterFlush(writer);
+    return true;
+}
+
+bool recordWriterClose(RecordWriter* writer) {
+    bool result = recordWriterFlush(writer);
+    nob_sb_free(writer->buffer);
+    memset(&writer->buffer, 0, sizeof(writer->buffer));
+    return result;
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+// The metrical facts of one verse, without any of the text
+typedef struct {
+    // A DhStatus
+    uint8_t status;
+    uint8_t syllableCount;
+    // Bit n is set if metrum n+1 is a dactyl (only the lowest 5 bits are used)
+    uint8_t footPattern;
+    // Bit n is set if the verse has caesura n from DhCaesura
+    uint8_t caesurae;
+    // A DhMeter
+    uint8_t meter;
+    // Bit n is set if the length of syllable n is known
+    uint32_t knownMask;
+    // Bit n is set if syllable n is long. Only meaningful for known syllables
+    uint32_t longMask;
+} DhRecord;
+
+/* The size of a record in the binary format: status, syllable count, foot pattern (with the meter in the top 3 bits),
+ * caesurae, and the two masks as little-endian 32 bit numbers
+ */
+#define RECORD_BINARY_SIZE 12
+#define RECORD_CSV_HEADER "status,syllables,pattern,known,long,caesurae,meter\n"
+
+DhRecord recordFromVerse(const DhVerse* verse);
+
+// A short name for a status, without spaces, like "too_few"
+const char* recordStatusCode(uint8_t status);
+
+// Make sure there's room for at least extra more bytes in a buffer, so appending doesn't have to check every byte
+void recordReserve(Nob_String_Builder* out, size_t extra);
+
+// Append a record to a buffer in one of the formats. These never call printf
+void recordAppendBinary(Nob_String_Builder* out, const DhRecord* record);
+void recordAppendJson(Nob_String_Builder* out, const DhRecord* record);
+void recordAppendCsv(Nob_String_Builder* out, const DhRecord* record);
+
+// Decode a record from the binary format
+DhRecord recordDecodeBinary(const uint8_t* bytes);
+
+typedef enum {
+    RECORD_FORMAT_BINARY,
+    RECORD_FORMAT_JSONL,
+    RECORD_FORMAT_CSV,
+    COUNT_RECORD_FORMATS,
+} RecordFormat;
+
+// Append a record to a buffer in the given format
+void recordAppend(Nob_String_Builder* out, RecordFormat format, const DhRecord* record);
+
+/* Writes records to a file through one big buffer that's reused, so there's only a write call every so often.
+ * Initialise it with recordWriterInit
+ */
+typedef struct {
+    FILE* file;
+    RecordFormat format;
+    Nob_String_Builder buffer;
+} RecordWriter;
+
+void recordWriterInit(RecordWriter* writer, FILE* file, RecordFormat format);
+bool recordWriterWrite(RecordWriter* writer, const DhRecord* record);
+bool recordWriterFlush(RecordWriter* writer);
+// Flushes and frees the buffer. The file is left open
+bool recordWriterClose(RecordWriter* writer);
@@ -0,0 +1,377 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "scansion.h"
+#include <math.h>
+
+// What a spondee in the fifth foot of a hexameter (or the third of a tetrameter) costs. It happens, but a lot less often than a dactyl
+#define SCANSION_SPONDAIC_COST 3
+// Larger than any real total cost, for states that can't reach the end
+#define SCANSION_UNREACHABLE (INT_MAX/4)
+
+// The three states of a foot that can be a dactyl (_ u u) or a spondee (_ _), starting at state s
+#define SCANSION_FOOT(s, f, spondeeCost) \
+    { .next = { (s) + 1, SCANSION_NO_STATE }, .foot = (f), .position = 0 }, \
+    { .next = { (s) + 3, (s) + 2 }, .cost = { (spondeeCost), 0 }, .foot = (f), .position = 1 }, \
+    { .next = { SCANSION_NO_STATE, (s) + 3 }, .foot = (f), .position = 2 }
+// The three states of a foot that's always a dactyl, starting at state s
+#define SCANSION_DACTYL(s, f) \
+    { .next = { (s) + 1, SCANSION_NO_STATE }, .foot = (f), .position = 0 }, \
+    { .next = { SCANSION_NO_STATE, (s) + 2 }, .foot = (f), .position = 1 }, \
+    { .next = { SCANSION_NO_STATE, (s) + 3 }, .foot = (f), .position = 2 }
+// A syllable that's always long, in state s
+#define SCANSION_LONG(s, f, p) { .next = { (s) + 1, SCANSION_NO_STATE }, .foot = (f), .position = (p) }
+// A syllable that can have either length, in state s
+#define SCANSION_ANCEPS(s, f, p) { .next = { (s) + 1, SCANSION_NO_STATE }, .foot = (f), .position = (p), .anceps = true }
+// The state after the last syllable
+#define SCANSION_END(f) { .next = { SCANSION_NO_STATE, SCANSION_NO_STATE }, .foot = (f) }
+
+static const ScansionState hexameterStates[] = {
+    SCANSION_FOOT(0, 0, 0),
+    SCANSION_FOOT(3, 1, 0),
+    SCANSION_FOOT(6, 2, 0),
+    SCANSION_FOOT(9, 3, 0),
+    SCANSION_FOOT(12, 4, SCANSION_SPONDAIC_COST),
+    // The sixth foot is always _ x
+    SCANSION_LONG(15, 5, 0),
+    SCANSION_ANCEPS(16, 5, 1),
+    SCANSION_END(6),
+};
+static_assert(NOB_ARRAY_LEN(hexameterStates) <= SCANSION_MAX_STATES, "Too many states");
+
+static const ScansionState pentameterStates[] = {
+    SCANSION_FOOT(0, 0, 0),
+    SCANSION_FOOT(3, 1, 0),
+    // The first half ends with one long syllable
+    SCANSION_LONG(6, 2, 0),
+    SCANSION_DACTYL(7, 3),
+    SCANSION_DACTYL(10, 4),
+    // And so does the second half, but there it can be short too
+    SCANSION_ANCEPS(13, 5, 0),
+    SCANSION_END(6),
+};
+static_assert(NOB_ARRAY_LEN(pentameterStates) <= SCANSION_MAX_STATES, "Too many states");
+
+static const ScansionState tetrameterStates[] = {
+    SCANSION_FOOT(0, 0, 0),
+    SCANSION_FOOT(3, 1, 0),
+    SCANSION_FOOT(6, 2, SCANSION_SPONDAIC_COST),
+    SCANSION_LONG(9, 3, 0),
+    SCANSION_ANCEPS(10, 3, 1),
+    SCANSION_END(4),
+};
+static_assert(NOB_ARRAY_LEN(tetrameterStates) <= SCANSION_MAX_STATES, "Too many states");
+
+#define SCANSION_AUTOMATON(table) { .states = (table), .stateCount = NOB_ARRAY_LEN(table), .start = 0, .end = NOB_ARRAY_LEN(table) - 1 }
+
+const ScansionMeter scansionMeters[] = {
+    [DH_METER_HEXAMETER] = {
+        .name = "hexameter",
+        .automaton = SCANSION_AUTOMATON(hexameterStates),
+        .minSyllables = 13,
+        .maxSyllables = 17,
+        .footCount = 6,
+        .ending = "_uu__",
+        .caesuraFeet = {
+            [DH_CAESURA_PENTHEMIMERAL]  = 2,
+            [DH_CAESURA_HEPHTHEMIMERAL] = 3,
+            [DH_CAESURA_TROCHAIC]       = 2,
+            [DH_DIAERESIS_BUCOLIC]      = 4,
+        },
+    },
+    [DH_METER_PENTAMETER] = {
+        .name = "pentameter",
+        .automaton = SCANSION_AUTOMATON(pentameterStates),
+        .minSyllables = 12,
+        .maxSyllables = 14,
+        .footCount = 6,
+        .ending = "_uu_uu_",
+        // The break in the middle is in the same place as a penthemimeral caesura
+        .caesuraFeet = {
+            [DH_CAESURA_PENTHEMIMERAL]  = 2,
+            [DH_CAESURA_HEPHTHEMIMERAL] = -1,
+            [DH_CAESURA_TROCHAIC]       = -1,
+            [DH_DIAERESIS_BUCOLIC]      = -1,
+        },
+    },
+    [DH_METER_TETRAMETER] = {
+        .name = "tetrameter",
+        .automaton = SCANSION_AUTOMATON(tetrameterStates),
+        .minSyllables = 8,
+        .maxSyllables = 11,
+        .footCount = 4,
+        .ending = "_uu__",
+        .caesuraFeet = {
+            [DH_CAESURA_PENTHEMIMERAL]  = -1,
+            [DH_CAESURA_HEPHTHEMIMERAL] = -1,
+            [DH_CAESURA_TROCHAIC]       = -1,
+            [DH_DIAERESIS_BUCOLIC]      = -1,
+        },
+    },
+};
+static_assert(NOB_ARRAY_LEN(scansionMeters) == COUNT_DH_METERS, "Amount of meters have changed");
+
+// One of the cheapest ways to get to a state, and where it came from
+typedef struct {
+    int cost;
+    uint8_t previous;
+    uint8_t rank;
+    uint8_t length;
+} ScansionEntry;
+
+// Put an entry into a list that's sorted by cost, keeping only the cheapest DH_MAX_ALTERNATIVES
+void scansionInsert(ScansionEntry* entries, uint8_t* count, ScansionEntry entry) {
+    size_t i = *count;
+    if (i == DH_MAX_ALTERNATIVES) {
+        if (entries[i - 1].cost <= entry.cost) return;
+        --i;
+    } else {
+        ++*count;
+    }
+    while (i > 0 && entries[i - 1].cost > entry.cost) {
+        entries[i] = entries[i - 1];
+        --i;
+    }
+    entries[i] = entry;
+}
+
+// What it costs for syllable i to go along an edge
+int scansionEdgeCost(const ScansionState* state, const DhSyllableCost* costs, size_t i, DhLength length) {
+    if (state->anceps) return state->cost[length];
+    return state->cost[length] + costs[i].cost[length];
+}
+
+/* What a syllable's lengths weigh for the forward-backward algorithm: e^-cost. Every path takes exactly one of the two
+ * lengths of a syllable, so taking the cheapest one off both changes nothing about the chances, but keeps the numbers
+ * from getting too small for a double
+ */
+void scansionSyllableWeights(const DhSyllableCost* costs, size_t n, double weights[MAX_SYLLABLES][COUNT_DH_LENGTHS]) {
+    for (size_t i = 0; i < n; ++i) {
+        int cheapest = costs[i].cost[DH_LONG] < costs[i].cost[DH_SHORT] ? costs[i].cost[DH_LONG] : costs[i].cost[DH_SHORT];
+        for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) weights[i][length] = exp(cheapest - costs[i].cost[length]);
+    }
+}
+
+// What an edge weighs, given the weights of the syllables
+double scansionEdgeWeight(const ScansionState* state, double syllableWeights[MAX_SYLLABLES][COUNT_DH_LENGTHS], size_t i, DhLength length) {
+    double weight = state->cost[length] == 0 ? 1 : exp(-state->cost[length]);
+    return state->anceps ? weight : weight*syllableWeights[i][length];
+}
+
+bool scansionSolve(const ScansionAutomaton* automaton, const DhSyllableCost* costs, size_t n, ScansionResult* result) {
+    NOB_ASSERT(n <= MAX_SYLLABLES && automaton->stateCount <= SCANSION_MAX_STATES);
+    memset(result, 0, sizeof(*result));
+    memset(result->lengths, '?', MAX_SYLLABLES);
+    const ScansionState* states = automaton->states;
+
+    double weights[MAX_SYLLABLES][COUNT_DH_LENGTHS];
+    scansionSyllableWeights(costs, n, weights);
+
+    // The cheapest ways to be in a state after i syllables, going forward
+    ScansionEntry forward[MAX_SYLLABLES + 1][SCANSION_MAX_STATES][DH_MAX_ALTERNATIVES];
+    uint8_t forwardCount[MAX_SYLLABLES + 1][SCANSION_MAX_STATES] = {0};
+    // The total weight of all ways to be in a state after i syllables
+    double alpha[MAX_SYLLABLES + 1][SCANSION_MAX_STATES] = {0};
+    forward[0][automaton->start][0] = (ScansionEntry) {0};
+    forwardCount[0][automaton->start] = 1;
+    alpha[0][automaton->start] = 1;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t s = 0; s < automaton->stateCount; ++s) {
+            if (forwardCount[i][s] == 0) continue;
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                uint8_t next = states[s].next[length];
+                if (next != SCANSION_NO_STATE) alpha[i + 1][next] += alpha[i][s]*scansionEdgeWeight(&states[s], weights, i, length);
+            }
+            for (size_t rank = 0; rank < forwardCount[i][s]; ++rank) {
+                for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                    uint8_t next = states[s].next[length];
+                    if (next == SCANSION_NO_STATE) continue;
+                    ScansionEntry entry = {
+                        .cost = forward[i][s][rank].cost + scansionEdgeCost(&states[s], costs, i, length),
+                        .previous = s,
+                        .rank = rank,
+                        .length = length,
+                    };
+                    scansionInsert(forward[i + 1][next], &forwardCount[i + 1][next], entry);
+                }
+            }
+        }
+    }
+    if (forwardCount[n][automaton->end] == 0) return false;
+    result->cost = forward[n][automaton->end][0].cost;
+
+    // The cheapest way from a state after i syllables to the end, going backward
+    int backward[MAX_SYLLABLES + 1][SCANSION_MAX_STATES];
+    // The total weight of all ways from a state after i syllables to the end
+    double beta[MAX_SYLLABLES + 1][SCANSION_MAX_STATES] = {0};
+    for (size_t s = 0; s < automaton->stateCount; ++s) backward[n][s] = SCANSION_UNREACHABLE;
+    backward[n][automaton->end] = 0;
+    beta[n][automaton->end] = 1;
+    for (size_t i = n; i-- > 0;) {
+        for (size_t s = 0; s < automaton->stateCount; ++s) {
+            backward[i][s] = SCANSION_UNREACHABLE;
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                uint8_t next = states[s].next[length];
+                if (next == SCANSION_NO_STATE || backward[i + 1][next] == SCANSION_UNREACHABLE) continue;
+                int cost = scansionEdgeCost(&states[s], costs, i, length) + backward[i + 1][next];
+                if (cost < backward[i][s]) backward[i][s] = cost;
+                beta[i][s] += scansionEdgeWeight(&states[s], weights, i, length)*beta[i + 1][next];
+            }
+        }
+    }
+    double total = alpha[n][automaton->end];
+
+    // A syllable is known if only one of its lengths is part of a scansion with the lowest cost
+    for (size_t i = 0; i < n; ++i) {
+        bool possible[COUNT_DH_LENGTHS] = {0};
+        double weight[COUNT_DH_LENGTHS] = {0};
+        for (size_t s = 0; s < automaton->stateCount; ++s) {
+            if (forwardCount[i][s] == 0) continue;
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                uint8_t next = states[s].next[length];
+                if (next == SCANSION_NO_STATE || backward[i + 1][next] == SCANSION_UNREACHABLE) continue;
+                int cost = forward[i][s][0].cost + scansionEdgeCost(&states[s], costs, i, length) + backward[i + 1][next];
+                if (cost == result->cost) possible[length] = true;
+
+                double edge = alpha[i][s]*scansionEdgeWeight(&states[s], weights, i, length)*beta[i + 1][next];
+                // An anceps syllable is always written as long
+                weight[states[s].anceps ? DH_LONG : length] += edge;
+                if (length == DH_SHORT && states[s].position == 1) result->dactylProbability[states[s].foot] += edge;
+            }
+        }
+        if (possible[DH_LONG] != possible[DH_SHORT]) result->lengths[i] = possible[DH_LONG] ? '_' : 'u';
+
+        if (total > 0) {
+            result->longProbability[i] = weight[DH_LONG]/total;
+        } else {
+            double longWeight = exp(-costs[i].cost[DH_LONG]);
+            double shortWeight = exp(-costs[i].cost[DH_SHORT]);
+            result->longProbability[i] = longWeight + shortWeight > 0 ? longWeight/(longWeight + shortWeight) : 0.5;
+        }
+    }
+    for (size_t foot = 0; foot < SCANSION_MAX_FEET; ++foot) {
+        result->dactylProbability[foot] = total > 0 ? result->dactylProbability[foot]/total : 0.5;
+    }
+
+    // Follow every cheap way back to the start to write it down
+    for (size_t alternative = 0; alternative < forwardCount[n][automaton->end]; ++alternative) {
+        DhAlternative* out = &result->alternatives[result->alternativeCount++];
+        const ScansionEntry* entry = &forward[n][automaton->end][alternative];
+        out->cost = entry->cost;
+        for (size_t i = n; i > 0; --i) {
+            const ScansionState* previous = &states[entry->previous];
+            if (entry->length == DH_LONG) out->longMask |= 1u << (i - 1);
+            // A short second syllable makes the foot a dactyl
+            if (entry->length == DH_SHORT && previous->position == 1) out->footPattern |= 1u << previous->foot;
+            entry = &forward[i - 1][entry->previous][entry->rank];
+        }
+    }
+
+    return result->cost < DH_COST_FORBIDDEN;
+}
+
+bool scansionFeasible(const ScansionAutomaton* automaton, const DhSyllableCost* costs, size_t n) {
+    NOB_ASSERT(n <= MAX_SYLLABLES && automaton->stateCount <= SCANSION_MAX_STATES);
+    const ScansionState* states = automaton->states;
+
+    // Bit s is set if state s can be reached with the syllables so far without breaking a hard rule
+    uint32_t reachable = 1u << automaton->start;
+    for (size_t i = 0; i < n && reachable != 0; ++i) {
+        uint32_t next = 0;
+        for (uint32_t left = reachable; left != 0; left &= left - 1) {
+            const ScansionState* state = &states[__builtin_ctz(left)];
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                if (state->next[length] == SCANSION_NO_STATE) continue;
+                if (scansionEdgeCost(state, costs, i, length) >= DH_COST_FORBIDDEN) continue;
+                next |= 1u << state->next[length];
+            }
+        }
+        reachable = next;
+    }
+    return (reachable & 1u << automaton->end) != 0;
+}
+
+// The lengths an edge can be taken for, given what's known about a syllable
+bool scansionLengthAllowed(const ScansionState* state, char known, DhLength length) {
+    if (state->anceps || known == '?') return true;
+    return known == (length == DH_LONG ? '_' : 'u');
+}
+
+// Going backward from the end, find the states the automaton can be in before every syllable, given the lengths
+void scansionNumberBackward(const ScansionAutomaton* automaton, const char* lengths, size_t n, uint32_t* backward) {
+    const ScansionState* states = automaton->states;
+    backward[n] = 1u << automaton->end;
+    for (size_t i = n; i-- > 0;) {
+        backward[i] = 0;
+        for (size_t s = 0; s < automaton->stateCount; ++s) {
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                uint8_t next = states[s].next[length];
+                if (next != SCANSION_NO_STATE && backward[i + 1] & (1u << next) && scansionLengthAllowed(&states[s], lengths[i], length))
+                    backward[i] |= 1u << s;
+            }
+        }
+    }
+}
+
+size_t scansionNumber(const ScansionAutomaton* automaton, const char* lengths, size_t n, char* numbers) {
+    NOB_ASSERT(n <= MAX_SYLLABLES && automaton->stateCount <= SCANSION_MAX_STATES);
+    memset(numbers, ' ', MAX_SYLLABLES);
+    const ScansionState* states = automaton->states;
+
+    // Bit s is set if the automaton can be in state s before syllable i, coming from the start or from the end
+    uint32_t forward[MAX_SYLLABLES + 1];
+    uint32_t backward[MAX_SYLLABLES + 1];
+    forward[0] = 1u << automaton->start;
+    // If there's only one way through, like when every length is known, going backward wouldn't add anything
+    bool determined = true;
+    for (size_t i = 0; i < n; ++i) {
+        forward[i + 1] = 0;
+        for (uint32_t left = forward[i]; left != 0; left &= left - 1) {
+            const ScansionState* state = &states[__builtin_ctz(left)];
+            for (DhLength length = 0; length < COUNT_DH_LENGTHS; ++length) {
+                if (state->next[length] != SCANSION_NO_STATE && scansionLengthAllowed(state, lengths[i], length))
+                    forward[i + 1] |= 1u << state->next[length];
+            }
+        }
+        if ((forward[i + 1] & (forward[i + 1] - 1)) != 0) determined = false;
+    }
+    if (determined && forward[n] == 1u << automaton->end) {
+        memcpy(backward, forward, (n + 1)*sizeof(*backward));
+    } else {
+        scansionNumberBackward(automaton, lengths, n, backward);
+    }
+
+    size_t count = 0;
+    // Bit f is set if metrum f already has a number, so lengths that don't fit can't number one twice
+    uint32_t numbered = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t at = forward[i] & backward[i];
+        // The lengths don't fit, so go by whichever end is sure on its own
+        if (at == 0) at = forward[i] != 0 && (forward[i] & (forward[i] - 1)) == 0 ? forward[i] : backward[i];
+        if (at == 0 || (at & (at - 1)) != 0 || __builtin_ctz(at) == automaton->end) continue;
+        const ScansionState* state = &states[__builtin_ctz(at)];
+        if (state->position != 0 || numbered & (1u << state->foot)) continue;
+        numbers[i] = '1' + state->foot;
+        numbered |= 1u << state->foot;
+        ++count;
+    }
+    return count;
+}
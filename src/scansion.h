@@ -0,0 +1,109 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* Finds the cheapest scansions of a verse with dynamic programming over a small automaton that describes the meter.
+ * Every state of the automaton is a spot in a foot, and every syllable moves it to the next state along a long or a
+ * short edge. The rules only decide what every length costs for every syllable, and the automaton makes sure the
+ * result is a valid verse, so one pass over the syllables finds the best scansion and the runners-up.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+// Marks a missing edge in the automaton
+#define SCANSION_NO_STATE 0xFF
+#define SCANSION_MAX_STATES 32
+#define SCANSION_MAX_FEET 6
+
+typedef struct {
+    // The state after a long or short syllable, or SCANSION_NO_STATE if that length isn't allowed here
+    uint8_t next[COUNT_DH_LENGTHS];
+    // What it costs to take an edge, on top of the syllable's own cost
+    int cost[COUNT_DH_LENGTHS];
+    // The foot this state is in, starting at 0
+    uint8_t foot;
+    // 0 for the first syllable of a foot, 1 for the second and so on
+    uint8_t position;
+    // Either length is fine here, so the syllable's own cost doesn't matter and it's written as long
+    bool anceps;
+} ScansionState;
+
+typedef struct {
+    const ScansionState* states;
+    size_t stateCount;
+    uint8_t start;
+    // The automaton has to end up here after the last syllable
+    uint8_t end;
+} ScansionAutomaton;
+
+/* Everything about a meter the scanner needs, so scanning doesn't have to know which meter it is. Every meter's
+ * automaton is written out as a table with the SCANSION_* macros in scansion.c, so the compiler builds them
+ */
+typedef struct {
+    const char* name;
+    ScansionAutomaton automaton;
+    // The amount of syllables the shortest and the longest way through the automaton take
+    size_t minSyllables;
+    size_t maxSyllables;
+    // The amount of metra that get a number
+    size_t footCount;
+    /* The lengths of the last syllables when every rule is broken anyway, and only what's (nearly) always true is shown.
+     * The first syllable is always long
+     */
+    const char* ending;
+    /* For every DhCaesura, the metrum it's in, or -1 if the meter doesn't have it. The bucolic diaeresis is right
+     * before the start of its metrum, and the others are after the first syllable, or the first short syllable
+     */
+    int caesuraFeet[COUNT_DH_CAESURAE];
+} ScansionMeter;
+
+extern const ScansionMeter scansionMeters[];
+
+typedef struct {
+    // The lowest total cost
+    int cost;
+    // '_' or 'u' where every scansion with the lowest cost agrees, '?' where they don't
+    char lengths[MAX_SYLLABLES];
+    size_t alternativeCount;
+    DhAlternative alternatives[DH_MAX_ALTERNATIVES];
+    // The chance that a syllable is long, and that a foot is a dactyl, over all ways through the automaton
+    double longProbability[MAX_SYLLABLES];
+    double dactylProbability[SCANSION_MAX_FEET];
+} ScansionResult;
+
+/* Find the cheapest ways through the automaton for n syllables. Returns false if there's no way through it that
+ * stays below DH_COST_FORBIDDEN.
+ * In the same passes, it works out the chances with the forward-backward algorithm, where a path with cost c weighs
+ * e^-c. If there's no way through at all, the chance of a syllable being long only comes from its own costs
+ */
+bool scansionSolve(const ScansionAutomaton* automaton, const DhSyllableCost* costs, size_t n, ScansionResult* result);
+
+/* Number the metra, given the lengths of the syllables ('?' for unknown): a syllable gets the number of its metrum if
+ * it has to be the first syllable of it, going through the automaton from both ends. If the lengths don't fit the
+ * meter at all, both ends are numbered as far as they go on their own. Returns the amount of numbers
+ */
+size_t scansionNumber(const ScansionAutomaton* automaton, const char* lengths, size_t n, char* numbers);
+
+/* Only check if there's a way through the automaton for n syllables that stays below DH_COST_FORBIDDEN, the same thing
+ * scansionSolve returns. It keeps a set of the states that can be reached and stops as soon as that's empty
+ */
+bool scansionFeasible(const ScansionAutomaton* automaton, const DhSyllableCost* costs, size_t n);
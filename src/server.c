@@ -0,0 +1,855 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "server.h"
+#include "pipeline.h"
+#include "records.h"
+#include "lexicon.h"
+
+#ifdef _WIN32
+
+bool serverRun(ServerOptions options) {
+    NOB_UNUSED(options);
+    nob_log(NOB_ERROR, "The server needs epoll, which only Linux has");
+    return false;
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+
+// The most requests a scanner takes from the queue at once
+#define SERVER_MAX_COALESCE 64
+#define SERVER_MAX_EVENTS 256
+// How often the connections are checked for timeouts, in milliseconds
+#define SERVER_TICK_MS 100
+#define SERVER_MAX_HEADER_SIZE (16*1024)
+#define SERVER_MAX_BODY_SIZE (8*1024*1024)
+#define SERVER_READ_SIZE (64*1024)
+// Bucket n of a latency histogram counts what took at most 2^n microseconds, so they go up to about 4 seconds
+#define SERVER_HISTOGRAM_BUCKETS 23
+// Every scanner remembers the records of this many verses, by where the hash of the verse puts them
+#define SERVER_CACHE_SIZE 1024
+// Longer verses aren't remembered
+#define SERVER_CACHE_VERSE_SIZE 160
+
+typedef enum {
+    SERVER_ENDPOINT_SCAN,
+    SERVER_ENDPOINT_BATCH,
+} ServerEndpoint;
+
+typedef struct {
+    int fd;
+    // Where the connection is in Server.connections
+    size_t slot;
+    // What's been received and not handled yet
+    Nob_String_Builder in;
+    // The response that's being sent, and how much of it is sent already
+    Nob_String_Builder out;
+    size_t sent;
+    // Waiting for the socket to take more of the response
+    bool writing;
+    // When the first byte of the request that's coming in arrived, or 0 if there's none
+    uint64_t requestStart;
+    // When the request that's being answered arrived
+    uint64_t answering;
+    bool keepAlive;
+    // The request is with the scanners. Nothing else is handled until it's back, so the responses stay in order
+    bool busy;
+    // The connection is closed, and will be freed once it's not busy
+    bool closed;
+
+    // The request that's with the scanners, and what they made of it
+    ServerEndpoint endpoint;
+    Nob_String_Builder body;
+    uint64_t deadline;
+    int status;
+    Nob_String_Builder response;
+} ServerConnection;
+
+typedef struct {
+    ServerConnection** items;
+    size_t count;
+    size_t capacity;
+} ServerConnections;
+
+/* Only one thread ever writes to a histogram or a counter, so adding to them is a plain load and store. They're atomic
+ * so GET /metrics can read them from another thread
+ */
+typedef struct {
+    _Atomic uint64_t buckets[SERVER_HISTOGRAM_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sumNanoseconds;
+} ServerHistogram;
+
+typedef struct {
+    bool used;
+    uint32_t hash;
+    size_t len;
+    char verse[SERVER_CACHE_VERSE_SIZE];
+    DhRecord record;
+} ServerCacheEntry;
+
+struct Server;
+
+// One scanner thread. It's aligned to cache lines so the counters of different scanners never share one
+typedef struct {
+    _Alignas(64) struct Server* server;
+    DhContext ctx;
+    DhVerse verse;
+    Nob_String_Builder line;
+    ServerCacheEntry* cache;
+
+    _Atomic uint64_t verses;
+    _Atomic uint64_t statuses[COUNT_DH_STATUSES];
+    _Atomic uint64_t cacheHits;
+    _Atomic uint64_t cacheMisses;
+    ServerHistogram elision;
+    ServerHistogram scan;
+} ServerScanner;
+
+// The status codes of the responses that are counted, the rest are counted as "other"
+static const int serverCountedStatuses[] = {200, 400, 404, 405, 408, 413, 431, 501, 503, 504};
+
+typedef struct Server {
+    ServerOptions options;
+    size_t threadCount;
+    ServerScanner* scanners;
+    int epoll;
+    int listener;
+    // An eventfd the scanners poke when they're done with some requests
+    int wakeup;
+
+    // Requests waiting for a scanner, as a ring
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueReady;
+    ServerConnection** queue;
+    size_t queueStart;
+    size_t queueCount;
+    bool stopping;
+
+    // Requests the scanners are done with
+    pthread_mutex_t doneLock;
+    ServerConnections done;
+
+    ServerConnections connections;
+    // Connections that were closed during this round of events, freed at the end of it
+    ServerConnections closing;
+
+    // Only written by the thread that handles the connections
+    ServerHistogram requests;
+    _Atomic uint64_t responses[NOB_ARRAY_LEN(serverCountedStatuses) + 1];
+} Server;
+
+static volatile sig_atomic_t serverStopRequested = 0;
+
+void serverStopHandler(int signal) {
+    NOB_UNUSED(signal);
+    serverStopRequested = 1;
+}
+
+uint64_t serverNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec*1000000000 + now.tv_nsec;
+}
+
+// Add to a counter that only the calling thread writes to
+void serverCount(_Atomic uint64_t* counter, uint64_t amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+void serverObserve(ServerHistogram* histogram, uint64_t nanoseconds) {
+    uint64_t microseconds = (nanoseconds + 999)/1000;
+    size_t bucket = 0;
+    while (bucket < SERVER_HISTOGRAM_BUCKETS && (1ull << bucket) < microseconds) ++bucket;
+    // What took longer than the last bucket is only in the count
+    if (bucket < SERVER_HISTOGRAM_BUCKETS) serverCount(&histogram->buckets[bucket], 1);
+    serverCount(&histogram->count, 1);
+    serverCount(&histogram->sumNanoseconds, nanoseconds);
+}
+
+const char* serverStatusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default:  return "Unknown";
+    }
+}
+
+// Put a whole response in the connection's output. It's sent by serverFlush
+void serverRespond(Server* server, ServerConnection* connection, int status, const char* contentType, const char* body, size_t bodySize) {
+    serverObserve(&server->requests, serverNow() - connection->answering);
+    size_t counted = 0;
+    while (counted < NOB_ARRAY_LEN(serverCountedStatuses) && serverCountedStatuses[counted] != status) ++counted;
+    serverCount(&server->responses[counted], 1);
+
+    char header[256];
+    int headerSize = snprintf(
+        header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n%s\r\n",
+        status, serverStatusText(status), contentType, bodySize, connection->keepAlive ? "keep-alive" : "close",
+        status == 503 ? "Retry-After: 1\r\n" : ""
+    );
+    connection->out.count = 0;
+    connection->sent = 0;
+    nob_sb_append_buf(&connection->out, header, headerSize);
+    nob_sb_append_buf(&connection->out, body, bodySize);
+}
+
+void serverRespondText(Server* server, ServerConnection* connection, int status, const char* text) {
+    serverRespond(server, connection, status, "text/plain", text, strlen(text));
+}
+
+// Close a connection. It's only freed later, since there can still be events or a request in flight for it
+void serverClose(Server* server, ServerConnection* connection) {
+    if (connection->closed) return;
+    epoll_ctl(server->epoll, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    connection->closed = true;
+    if (!connection->busy) nob_da_append(&server->closing, connection);
+}
+
+void serverFree(Server* server, ServerConnection* connection) {
+    // Take it out of the list of connections by moving the last one into its place
+    ServerConnection* last = server->connections.items[--server->connections.count];
+    server->connections.items[connection->slot] = last;
+    last->slot = connection->slot;
+    nob_sb_free(connection->in);
+    nob_sb_free(connection->out);
+    nob_sb_free(connection->body);
+    nob_sb_free(connection->response);
+    free(connection);
+}
+
+// Send as much of the response as the socket takes. Returns false if the connection got closed
+bool serverFlush(Server* server, ServerConnection* connection) {
+    while (connection->sent < connection->out.count) {
+        ssize_t sent = send(connection->fd, connection->out.items + connection->sent, connection->out.count - connection->sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!connection->writing) {
+                    struct epoll_event event = { .events = EPOLLIN | EPOLLOUT, .data.ptr = connection };
+                    epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+                    connection->writing = true;
+                }
+                return true;
+            }
+            serverClose(server, connection);
+            return false;
+        }
+        connection->sent += sent;
+    }
+    connection->out.count = 0;
+    connection->sent = 0;
+    if (connection->writing) {
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = connection };
+        epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->writing = false;
+    }
+    if (!connection->keepAlive) {
+        serverClose(server, connection);
+        return false;
+    }
+    return true;
+}
+
+// Hand a request to the scanners, or turn it away if there are too many waiting already
+bool serverEnqueue(Server* server, ServerConnection* connection) {
+    pthread_mutex_lock(&server->queueLock);
+    bool full = server->queueCount == server->options.queueSize;
+    if (!full) {
+        server->queue[(server->queueStart + server->queueCount++) % server->options.queueSize] = connection;
+        connection->busy = true;
+        pthread_cond_signal(&server->queueReady);
+    }
+    pthread_mutex_unlock(&server->queueLock);
+    return !full;
+}
+
+// Compare the name of a header without caring about case
+bool serverHeaderIs(Nob_String_View name, const char* expected) {
+    size_t len = strlen(expected);
+    if (name.count != len) return false;
+    for (size_t i = 0; i < len; ++i) {
+        if (tolower((unsigned char) name.data[i]) != expected[i]) return false;
+    }
+    return true;
+}
+
+// Append a line of formatted text. Every line of the metrics fits in a small buffer
+void serverAppendf(Nob_String_Builder* out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (size > 0) nob_sb_append_buf(out, line, (size_t) size < sizeof(line) ? (size_t) size : sizeof(line) - 1);
+}
+
+uint64_t serverRead64(const _Atomic uint64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void serverAppendCounter(Nob_String_Builder* out, const char* name, const char* type, const char* help, uint64_t value) {
+    serverAppendf(out, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type, name, (unsigned long long) value);
+}
+
+// Append the sum of one histogram of every scanner (or of only the one histogram when stride is 0)
+void serverAppendHistogram(Nob_String_Builder* out, const char* name, const char* help, const ServerHistogram* first, size_t count, size_t stride) {
+    uint64_t buckets[SERVER_HISTOGRAM_BUCKETS] = {0};
+    uint64_t total = 0;
+    uint64_t sumNanoseconds = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const ServerHistogram* histogram = (const ServerHistogram*) ((const char*) first + i*stride);
+        for (size_t bucket = 0; bucket < SERVER_HISTOGRAM_BUCKETS; ++bucket) buckets[bucket] += serverRead64(&histogram->buckets[bucket]);
+        total += serverRead64(&histogram->count);
+        sumNanoseconds += serverRead64(&histogram->sumNanoseconds);
+    }
+
+    serverAppendf(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket < SERVER_HISTOGRAM_BUCKETS; ++bucket) {
+        cumulative += buckets[bucket];
+        serverAppendf(out, "%s_bucket{le=\"%.7g\"} %llu\n", name, (double) (1ull << bucket)/1e6, (unsigned long long) cumulative);
+    }
+    // The counts are read while the scanners go on, so the total can be behind the buckets
+    if (total < cumulative) total = cumulative;
+    serverAppendf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long) total);
+    serverAppendf(out, "%s_sum %.9f\n", name, (double) sumNanoseconds/1e9);
+    serverAppendf(out, "%s_count %llu\n", name, (unsigned long long) total);
+}
+
+/* Write the metrics in the Prometheus text format. The scanners all count on their own, and only here are their
+ * counts added up
+ */
+void serverWriteMetrics(Server* server, Nob_String_Builder* out) {
+    uint64_t verses = 0;
+    uint64_t statuses[COUNT_DH_STATUSES] = {0};
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+    for (size_t i = 0; i < server->threadCount; ++i) {
+        const ServerScanner* scanner = &server->scanners[i];
+        verses += serverRead64(&scanner->verses);
+        for (size_t status = 0; status < COUNT_DH_STATUSES; ++status) statuses[status] += serverRead64(&scanner->statuses[status]);
+        cacheHits += serverRead64(&scanner->cacheHits);
+        cacheMisses += serverRead64(&scanner->cacheMisses);
+    }
+    pthread_mutex_lock(&server->queueLock);
+    size_t queueDepth = server->queueCount;
+    pthread_mutex_unlock(&server->queueLock);
+
+    serverAppendCounter(out, "dh_verses_scanned_total", "counter", "Verses that were scanned, including the ones that failed", verses);
+    serverAppendf(out, "# HELP dh_verses_failed_total Verses that didn't scan completely, by why\n# TYPE dh_verses_failed_total counter\n");
+    for (size_t status = 0; status < COUNT_DH_STATUSES; ++status) {
+        if (status == DH_OK) continue;
+        serverAppendf(out, "dh_verses_failed_total{reason=\"%s\"} %llu\n", recordStatusCode(status), (unsigned long long) statuses[status]);
+    }
+    serverAppendCounter(out, "dh_cache_hits_total", "counter", "Verses whose record a scanner still remembered", cacheHits);
+    serverAppendCounter(out, "dh_cache_misses_total", "counter", "Verses a scanner had to scan", cacheMisses);
+    serverAppendCounter(out, "dh_queue_depth", "gauge", "Requests waiting for a scanner", queueDepth);
+    serverAppendf(out, "# HELP dh_http_responses_total Responses by status code\n# TYPE dh_http_responses_total counter\n");
+    for (size_t i = 0; i <= NOB_ARRAY_LEN(serverCountedStatuses); ++i) {
+        char code[16] = "other";
+        if (i < NOB_ARRAY_LEN(serverCountedStatuses)) snprintf(code, sizeof(code), "%d", serverCountedStatuses[i]);
+        serverAppendf(out, "dh_http_responses_total{code=\"%s\"} %llu\n", code, (unsigned long long) serverRead64(&server->responses[i]));
+    }
+    serverAppendHistogram(out, "dh_elision_seconds", "Time spent on the elision of a verse", &server->scanners[0].elision, server->threadCount, sizeof(ServerScanner));
+    serverAppendHistogram(out, "dh_scan_seconds", "Time spent scanning a verse after its elision", &server->scanners[0].scan, server->threadCount, sizeof(ServerScanner));
+    serverAppendHistogram(out, "dh_request_seconds", "Time from the start of a request to its response", &server->requests, 1, 0);
+}
+
+/* Handle the requests that have fully come in, one at a time: answer the ones that can be answered right away and hand
+ * the others to the scanners. Stops when the connection is busy, closed or still sending
+ */
+void serverHandleRequests(Server* server, ServerConnection* connection) {
+    while (!connection->busy && !connection->closed && connection->out.count == 0 && connection->in.count > 0) {
+        Nob_String_View received = nob_sv_from_parts(connection->in.items, connection->in.count);
+        connection->answering = connection->requestStart;
+        size_t headerEnd = 0;
+        while (headerEnd + 4 <= received.count && memcmp(received.data + headerEnd, "\r\n\r\n", 4) != 0) ++headerEnd;
+        if (headerEnd + 4 > received.count) {
+            if (received.count > SERVER_MAX_HEADER_SIZE) {
+                connection->keepAlive = false;
+                serverRespondText(server, connection, 431, "The request headers are too large\n");
+                serverFlush(server, connection);
+            }
+            return;
+        }
+
+        Nob_String_View head = nob_sv_from_parts(received.data, headerEnd);
+        Nob_String_View requestLine = nob_sv_chop_by_delim(&head, '\n');
+        Nob_String_View method = nob_sv_chop_by_delim(&requestLine, ' ');
+        Nob_String_View path = nob_sv_chop_by_delim(&requestLine, ' ');
+        path = nob_sv_chop_by_delim(&path, '?');
+        Nob_String_View version = nob_sv_trim(requestLine);
+        bool http11 = nob_sv_eq(version, nob_sv_from_cstr("HTTP/1.1"));
+        connection->keepAlive = http11;
+
+        size_t contentLength = 0;
+        bool chunked = false;
+        bool badRequest = !http11 && !nob_sv_eq(version, nob_sv_from_cstr("HTTP/1.0"));
+        while (head.count > 0) {
+            Nob_String_View value = nob_sv_trim(nob_sv_chop_by_delim(&head, '\n'));
+            Nob_String_View name = nob_sv_trim(nob_sv_chop_by_delim(&value, ':'));
+            value = nob_sv_trim(value);
+            if (serverHeaderIs(name, "content-length")) {
+                char* end;
+                char number[32] = {0};
+                memcpy(number, value.data, value.count < sizeof(number) - 1 ? value.count : sizeof(number) - 1);
+                contentLength = strtoull(number, &end, 10);
+                if (value.count == 0 || *end != '\0') badRequest = true;
+            } else if (serverHeaderIs(name, "connection")) {
+                if (serverHeaderIs(value, "close")) connection->keepAlive = false;
+                else if (serverHeaderIs(value, "keep-alive")) connection->keepAlive = true;
+            } else if (serverHeaderIs(name, "transfer-encoding")) {
+                chunked = true;
+            }
+        }
+        if (badRequest || chunked || contentLength > SERVER_MAX_BODY_SIZE) {
+            connection->keepAlive = false;
+            if (badRequest) serverRespondText(server, connection, 400, "The request is malformed\n");
+            else if (chunked) serverRespondText(server, connection, 501, "Only requests with a Content-Length are supported\n");
+            else serverRespondText(server, connection, 413, "The request body is too large\n");
+            serverFlush(server, connection);
+            return;
+        }
+        size_t requestSize = headerEnd + 4 + contentLength;
+        if (received.count < requestSize) return;
+
+        bool post = nob_sv_eq(method, nob_sv_from_cstr("POST"));
+        bool get = nob_sv_eq(method, nob_sv_from_cstr("GET"));
+        bool scan = nob_sv_eq(path, nob_sv_from_cstr("/scan"));
+        bool batch = nob_sv_eq(path, nob_sv_from_cstr("/batch"));
+        bool health = nob_sv_eq(path, nob_sv_from_cstr("/health"));
+        bool metrics = nob_sv_eq(path, nob_sv_from_cstr("/metrics"));
+        if (scan || batch) {
+            if (!post) {
+                serverRespondText(server, connection, 405, "Use POST\n");
+            } else {
+                connection->endpoint = scan ? SERVER_ENDPOINT_SCAN : SERVER_ENDPOINT_BATCH;
+                connection->body.count = 0;
+                nob_sb_append_buf(&connection->body, received.data + headerEnd + 4, contentLength);
+                nob_sb_append_null(&connection->body);
+                connection->deadline = connection->requestStart + server->options.timeoutMs*1000000;
+                if (!serverEnqueue(server, connection)) serverRespondText(server, connection, 503, "Too many requests are waiting\n");
+            }
+        } else if (health) {
+            if (get) serverRespondText(server, connection, 200, "ok\n");
+            else serverRespondText(server, connection, 405, "Use GET\n");
+        } else if (metrics) {
+            if (get) {
+                Nob_String_Builder text = {0};
+                serverWriteMetrics(server, &text);
+                serverRespond(server, connection, 200, "text/plain; version=0.0.4", text.items, text.count);
+                nob_sb_free(text);
+            } else {
+                serverRespondText(server, connection, 405, "Use GET\n");
+            }
+        } else {
+            serverRespondText(server, connection, 404, "There's /scan, /batch, /health and /metrics\n");
+        }
+
+        // The request is handled, so drop it from what came in
+        memmove(connection->in.items, connection->in.items + requestSize, connection->in.count - requestSize);
+        connection->in.count -= requestSize;
+        connection->requestStart = connection->in.count > 0 ? serverNow() : 0;
+        if (!connection->busy && !serverFlush(server, connection)) return;
+    }
+}
+
+void serverRead(Server* server, ServerConnection* connection) {
+    for (;;) {
+        recordReserve(&connection->in, SERVER_READ_SIZE);
+        ssize_t received = recv(connection->fd, connection->in.items + connection->in.count, connection->in.capacity - connection->in.count, 0);
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            serverClose(server, connection);
+            return;
+        }
+        if (received == 0) {
+            serverClose(server, connection);
+            return;
+        }
+        if (connection->requestStart == 0) connection->requestStart = serverNow();
+        connection->in.count += received;
+        // Don't let a client that keeps sending while its request is being scanned fill up the memory
+        if (connection->in.count > 2*(SERVER_MAX_HEADER_SIZE + SERVER_MAX_BODY_SIZE)) {
+            serverClose(server, connection);
+            return;
+        }
+    }
+    serverHandleRequests(server, connection);
+}
+
+void serverAccept(Server* server) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) nob_log(NOB_WARNING, "Couldn't accept a connection: %s", strerror(errno));
+            return;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        // The responses are small and every one of them is waited for, so don't let them sit in the socket
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+        ServerConnection* connection = calloc(1, sizeof(ServerConnection));
+        NOB_ASSERT(connection != NULL && "Buy more RAM lol");
+        connection->fd = fd;
+        connection->slot = server->connections.count;
+        nob_da_append(&server->connections, connection);
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = connection };
+        if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            nob_log(NOB_WARNING, "Couldn't watch a connection: %s", strerror(errno));
+            close(fd);
+            connection->closed = true;
+            nob_da_append(&server->closing, connection);
+        }
+    }
+}
+
+// Send the responses of the requests the scanners are done with, and go on with whatever those connections sent next
+void serverFinishRequests(Server* server) {
+    uint64_t count;
+    if (read(server->wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        nob_log(NOB_WARNING, "Couldn't read the wakeup counter: %s", strerror(errno));
+    }
+
+    pthread_mutex_lock(&server->doneLock);
+    ServerConnections done = server->done;
+    server->done = (ServerConnections) {0};
+    pthread_mutex_unlock(&server->doneLock);
+
+    for (size_t i = 0; i < done.count; ++i) {
+        ServerConnection* connection = done.items[i];
+        connection->busy = false;
+        if (connection->closed) {
+            nob_da_append(&server->closing, connection);
+            continue;
+        }
+        if (connection->status == 200) {
+            const char* contentType = connection->endpoint == SERVER_ENDPOINT_SCAN ? "application/json" : "application/x-ndjson";
+            serverRespond(server, connection, 200, contentType, connection->response.items, connection->response.count);
+        } else {
+            serverRespondText(server, connection, connection->status, "The request took too long\n");
+        }
+        if (serverFlush(server, connection)) serverHandleRequests(server, connection);
+    }
+    nob_da_free(done);
+}
+
+// Answer the connections that have been sending a request for too long with 408
+void serverCheckTimeouts(Server* server) {
+    uint64_t now = serverNow();
+    uint64_t timeout = server->options.timeoutMs*1000000;
+    for (size_t i = 0; i < server->connections.count; ++i) {
+        ServerConnection* connection = server->connections.items[i];
+        if (connection->closed || connection->busy || connection->out.count > 0) continue;
+        if (connection->requestStart == 0 || now - connection->requestStart <= timeout) continue;
+        connection->in.count = 0;
+        connection->answering = connection->requestStart;
+        connection->requestStart = 0;
+        connection->keepAlive = false;
+        serverRespondText(server, connection, 408, "The request took too long to arrive\n");
+        serverFlush(server, connection);
+    }
+}
+
+/* Scan one verse into a JSON record, like batchScanVerse, but time the elision and the scanning, and remember the
+ * record in case the same verse comes in again
+ */
+void serverScanVerse(ServerScanner* scanner, const char* verse, Nob_String_Builder* out) {
+    size_t len = strlen(verse);
+    uint32_t hash = lexiconHash(verse, len, 0);
+    ServerCacheEntry* entry = len < SERVER_CACHE_VERSE_SIZE ? &scanner->cache[hash % SERVER_CACHE_SIZE] : NULL;
+    DhRecord record;
+    if (entry != NULL && entry->used && entry->hash == hash && entry->len == len && memcmp(entry->verse, verse, len) == 0) {
+        record = entry->record;
+        serverCount(&scanner->cacheHits, 1);
+    } else {
+        serverCount(&scanner->cacheMisses, 1);
+        uint64_t start = serverNow();
+        DhStatus status = dhElisionContext(&scanner->ctx, verse);
+        uint64_t elided = serverNow();
+        serverObserve(&scanner->elision, elided - start);
+        if (status == DH_OK) {
+            dhScanElided(&scanner->ctx, verse, &scanner->verse);
+            serverObserve(&scanner->scan, serverNow() - elided);
+        } else {
+            memset(&scanner->verse, 0, sizeof(scanner->verse));
+            scanner->verse.status = status;
+        }
+        record = recordFromVerse(&scanner->verse);
+        if (entry != NULL) {
+            entry->used = true;
+            entry->hash = hash;
+            entry->len = len;
+            memcpy(entry->verse, verse, len);
+            entry->record = record;
+        }
+    }
+    serverCount(&scanner->verses, 1);
+    serverCount(&scanner->statuses[record.status], 1);
+    recordAppendJson(out, &record);
+}
+
+// Scan the request of a connection into its response
+void serverScanRequest(ServerScanner* scanner, ServerConnection* connection) {
+    connection->response.count = 0;
+    connection->status = 504;
+    if (serverNow() > connection->deadline) return;
+
+    const char* body = connection->body.items;
+    size_t bodySize = connection->body.count - 1;
+    if (connection->endpoint == SERVER_ENDPOINT_SCAN) {
+        serverScanVerse(scanner, body, &connection->response);
+        connection->status = 200;
+        return;
+    }
+
+    // Every line is a verse, but a newline at the very end doesn't start another one
+    Nob_String_Builder* line = &scanner->line;
+    size_t start = 0;
+    while (start < bodySize) {
+        size_t end = start;
+        while (end < bodySize && body[end] != '\n') ++end;
+        line->count = 0;
+        nob_sb_append_buf(line, body + start, end > start && body[end - 1] == '\r' ? end - start - 1 : end - start);
+        nob_sb_append_null(line);
+        serverScanVerse(scanner, line->items, &connection->response);
+        start = end + 1;
+        if (serverNow() > connection->deadline) {
+            connection->response.count = 0;
+            return;
+        }
+    }
+    connection->status = 200;
+}
+
+void* serverScanner(void* arg) {
+    ServerScanner* scanner = arg;
+    Server* server = scanner->server;
+    ServerConnection* requests[SERVER_MAX_COALESCE];
+
+    for (;;) {
+        // Take a fair share of everything that's waiting, so concurrent requests get scanned together
+        pthread_mutex_lock(&server->queueLock);
+        while (server->queueCount == 0 && !server->stopping) pthread_cond_wait(&server->queueReady, &server->queueLock);
+        if (server->queueCount == 0) {
+            pthread_mutex_unlock(&server->queueLock);
+            break;
+        }
+        size_t count = (server->queueCount + server->threadCount - 1)/server->threadCount;
+        if (count > SERVER_MAX_COALESCE) count = SERVER_MAX_COALESCE;
+        for (size_t i = 0; i < count; ++i) {
+            requests[i] = server->queue[server->queueStart];
+            server->queueStart = (server->queueStart + 1) % server->options.queueSize;
+        }
+        server->queueCount -= count;
+        pthread_mutex_unlock(&server->queueLock);
+
+        for (size_t i = 0; i < count; ++i) serverScanRequest(scanner, requests[i]);
+
+        pthread_mutex_lock(&server->doneLock);
+        for (size_t i = 0; i < count; ++i) nob_da_append(&server->done, requests[i]);
+        pthread_mutex_unlock(&server->doneLock);
+        uint64_t one = 1;
+        if (write(server->wakeup, &one, sizeof(one)) < 0) nob_log(NOB_WARNING, "Couldn't wake the server up: %s", strerror(errno));
+    }
+    return NULL;
+}
+
+int serverListen(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Couldn't create a socket: %s", strerror(errno));
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        nob_log(NOB_ERROR, "Couldn't listen on port %zu: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool serverRun(ServerOptions options) {
+    if (options.port == 0) options.port = SERVER_DEFAULT_PORT;
+    if (options.queueSize == 0) options.queueSize = SERVER_DEFAULT_QUEUE;
+    if (options.timeoutMs == 0) options.timeoutMs = SERVER_DEFAULT_TIMEOUT_MS;
+    if (options.port > UINT16_MAX) {
+        nob_log(NOB_ERROR, "There's no port %zu", options.port);
+        return false;
+    }
+
+    Server server = {
+        .options = options,
+        .threadCount = options.threadCount > 0 ? options.threadCount : pipelineDefaultThreadCount(),
+        .epoll = -1,
+        .wakeup = -1,
+    };
+    server.listener = serverListen(options.port);
+    if (server.listener < 0) return false;
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    server.wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event listenerEvent = { .events = EPOLLIN, .data.ptr = &server.listener };
+    struct epoll_event wakeupEvent = { .events = EPOLLIN, .data.ptr = &server.wakeup };
+    if (
+        server.epoll < 0 || server.wakeup < 0 ||
+        epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &listenerEvent) < 0 ||
+        epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.wakeup, &wakeupEvent) < 0
+    ) {
+        nob_log(NOB_ERROR, "Couldn't set up epoll: %s", strerror(errno));
+        close(server.listener);
+        if (server.epoll >= 0) close(server.epoll);
+        if (server.wakeup >= 0) close(server.wakeup);
+        return false;
+    }
+
+    // Stop on SIGINT and SIGTERM by interrupting epoll_wait, and never die from writing to a connection that's gone
+    struct sigaction stop = { .sa_handler = serverStopHandler };
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    server.queue = malloc(options.queueSize*sizeof(ServerConnection*));
+    NOB_ASSERT(server.queue != NULL && "Buy more RAM lol");
+    pthread_mutex_init(&server.queueLock, NULL);
+    pthread_cond_init(&server.queueReady, NULL);
+    pthread_mutex_init(&server.doneLock, NULL);
+    pthread_t* threads = malloc(server.threadCount*sizeof(pthread_t));
+    NOB_ASSERT(threads != NULL && "Buy more RAM lol");
+    server.scanners = aligned_alloc(_Alignof(ServerScanner), server.threadCount*sizeof(ServerScanner));
+    NOB_ASSERT(server.scanners != NULL && "Buy more RAM lol");
+    memset(server.scanners, 0, server.threadCount*sizeof(ServerScanner));
+    for (size_t i = 0; i < server.threadCount; ++i) {
+        ServerScanner* scanner = &server.scanners[i];
+        scanner->server = &server;
+        scanner->ctx = (DhContext) {
+            .meter = options.scan.meter,
+            .detectMeter = options.scan.detectMeter,
+            .lexicon = options.scan.lexicon,
+            .ngram = options.scan.ngram,
+        };
+        scanner->cache = calloc(SERVER_CACHE_SIZE, sizeof(ServerCacheEntry));
+        NOB_ASSERT(scanner->cache != NULL && "Buy more RAM lol");
+        pthread_create(&threads[i], NULL, serverScanner, scanner);
+    }
+    nob_log(NOB_INFO, "Listening on http://127.0.0.1:%zu with %zu scanners", options.port, server.threadCount);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    uint64_t lastCheck = serverNow();
+    bool result = true;
+    while (!serverStopRequested) {
+        int count = epoll_wait(server.epoll, events, SERVER_MAX_EVENTS, SERVER_TICK_MS);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            nob_log(NOB_ERROR, "Couldn't wait for events: %s", strerror(errno));
+            result = false;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            void* source = events[i].data.ptr;
+            if (source == &server.listener) {
+                serverAccept(&server);
+            } else if (source == &server.wakeup) {
+                serverFinishRequests(&server);
+            } else {
+                ServerConnection* connection = source;
+                if (connection->closed) continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) serverRead(&server, connection);
+                if (!connection->closed && (events[i].events & EPOLLOUT) && serverFlush(&server, connection)) {
+                    serverHandleRequests(&server, connection);
+                }
+            }
+        }
+
+        uint64_t now = serverNow();
+        if (now - lastCheck >= SERVER_TICK_MS*1000000ull) {
+            serverCheckTimeouts(&server);
+            lastCheck = now;
+        }
+        for (size_t i = 0; i < server.closing.count; ++i) serverFree(&server, server.closing.items[i]);
+        server.closing.count = 0;
+    }
+    nob_log(NOB_INFO, "Stopping the server");
+
+    pthread_mutex_lock(&server.queueLock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.queueReady);
+    pthread_mutex_unlock(&server.queueLock);
+    for (size_t i = 0; i < server.threadCount; ++i) {
+        pthread_join(threads[i], NULL);
+        dhContextFree(&server.scanners[i].ctx);
+        nob_sb_free(server.scanners[i].line);
+        free(server.scanners[i].cache);
+    }
+
+    while (server.connections.count > 0) {
+        ServerConnection* connection = server.connections.items[0];
+        if (!connection->closed) close(connection->fd);
+        serverFree(&server, connection);
+    }
+    nob_da_free(server.connections);
+    nob_da_free(server.closing);
+    nob_da_free(server.done);
+    free(server.queue);
+    free(threads);
+    free(server.scanners);
+    pthread_mutex_destroy(&server.queueLock);
+    pthread_cond_destroy(&server.queueReady);
+    pthread_mutex_destroy(&server.doneLock);
+    close(server.listener);
+    close(server.epoll);
+    close(server.wakeup);
+    return result;
+}
+
+#endif // _WIN32
@@ -0,0 +1,60 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* A small HTTP/1.1 server on localhost, so a program that wants a lot of verses scanned doesn't have to start a new
+ * process for every one of them. Connections are kept alive, and one thread handles all of them with epoll while a
+ * pool of scanner threads does the scanning. The scanners take every request that's waiting at once, so requests that
+ * come in at the same time get scanned as one batch.
+ *
+ * Endpoints:
+ *     POST /scan     The body is one verse, the response is its record as JSON (like --format jsonl)
+ *     POST /batch    The body is any amount of verses, one per line, the response has a JSON record for each of them
+ *     GET  /health   Responds with "ok"
+ *     GET  /metrics  Counters and latency histograms in the Prometheus text format
+ *
+ * When the queue of requests is full, new requests are turned away right away with 503, and requests that waited or
+ * took longer than the timeout get 504. A connection that doesn't finish sending its request in time is closed with 408.
+ * Linux only.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+#define SERVER_DEFAULT_PORT 8347
+#define SERVER_DEFAULT_QUEUE 1024
+#define SERVER_DEFAULT_TIMEOUT_MS 5000
+
+typedef struct {
+    // The port to listen on, on 127.0.0.1. 0 means SERVER_DEFAULT_PORT
+    size_t port;
+    // The amount of scanner threads. 0 means one per processor
+    size_t threadCount;
+    // The maximum amount of requests waiting for a scanner. 0 means SERVER_DEFAULT_QUEUE
+    size_t queueSize;
+    // How long a request may take, in milliseconds. 0 means SERVER_DEFAULT_TIMEOUT_MS
+    size_t timeoutMs;
+    // How to scan
+    DhScanSettings scan;
+} ServerOptions;
+
+// Serve until the process gets SIGINT or SIGTERM. Returns false if the server couldn't start
+bool serverRun(ServerOptions options);
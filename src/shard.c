@@ -0,0 +1,484 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "shard.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "lexicon.h"
+#include "ngram.h"
+#include "records.h"
+#include <sys/stat.h>
+
+/* The manifest is a text file that starts with the settings, one per line as "<name>\t<value>" (shards, format, meter,
+ * and lexicon and ngram if there are any), then every input file as "input\t<size>\t<modification time>\t<path>",
+ * followed by one shard per line: "<start>\t<end>\t<input path>\t<output path>"
+ */
+#define SHARD_MANIFEST_HEADER "# dh shard manifest v3"
+
+char* shardStrdup(Nob_String_View sv) {
+    char* result = malloc(sv.count + 1);
+    NOB_ASSERT(result != NULL && "Buy more RAM lol");
+    memcpy(result, sv.data, sv.count);
+    result[sv.count] = '\0';
+    return result;
+}
+
+void shardsFree(Shards* shards) {
+    for (size_t i = 0; i < shards->count; ++i) {
+        free((char*) shards->items[i].inputPath);
+        free((char*) shards->items[i].outputPath);
+    }
+    nob_da_free(*shards);
+    memset(shards, 0, sizeof(*shards));
+}
+
+// Get the size of a file in bytes, or -1 if it can't be opened
+long long shardFileSize(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return -1;
+#ifdef _WIN32
+    long long size = _fseeki64(file, 0, SEEK_END) == 0 ? _ftelli64(file) : -1;
+#else
+    long long size = fseeko(file, 0, SEEK_END) == 0 ? ftello(file) : -1;
+#endif
+    fclose(file);
+    return size;
+}
+
+// Get the size and modification time of a file
+bool shardStatInput(const char* path, ShardInput* input) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path, &info) != 0) return false;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+#endif
+    input->size = info.st_size;
+    input->modified = info.st_mtime;
+    return true;
+}
+
+// Move an offset forward to the start of the next line, unless it's already at the start of a line
+long long shardAlignToLine(FILE* file, long long offset, long long size) {
+    if (offset <= 0) return 0;
+    if (offset >= size) return size;
+    // Start one byte early, so an offset right after a newline stays where it is
+    if (!batchSeek(file, offset - 1)) return size;
+    int chr;
+    while ((chr = fgetc(file)) != EOF && chr != '\n');
+    long long aligned = batchTell(file);
+    return aligned < 0 || chr == EOF ? size : aligned;
+}
+
+bool shardSplit(ShardOptions options, Shards* shards) {
+    long long* sizes = calloc(options.inputPaths.count, sizeof(long long));
+    NOB_ASSERT(sizes != NULL && "Buy more RAM lol");
+    bool result = true;
+    long long totalSize = 0;
+    for (size_t i = 0; i < options.inputPaths.count; ++i) {
+        sizes[i] = shardFileSize(options.inputPaths.items[i]);
+        if (sizes[i] < 0) {
+            nob_log(NOB_ERROR, "Couldn't open %s: %s", options.inputPaths.items[i], strerror(errno));
+            nob_return_defer(false);
+        }
+        totalSize += sizes[i];
+    }
+
+    for (size_t i = 0; i < options.inputPaths.count; ++i) {
+        if (sizes[i] == 0) continue;
+        // Give every file a share of the shards that matches its share of the bytes, but at least one
+        size_t pieces = (size_t) ((double) options.shardCount*sizes[i]/totalSize + 0.5);
+        if (pieces == 0) pieces = 1;
+
+        FILE* file = fopen(options.inputPaths.items[i], "rb");
+        if (file == NULL) {
+            nob_log(NOB_ERROR, "Couldn't open %s: %s", options.inputPaths.items[i], strerror(errno));
+            nob_return_defer(false);
+        }
+        long long start = 0;
+        for (size_t piece = 1; piece <= pieces && start < sizes[i]; ++piece) {
+            long long end = piece == pieces ? sizes[i] : shardAlignToLine(file, sizes[i]*piece/pieces, sizes[i]);
+            if (end <= start) continue;
+            Shard shard = {
+                .inputPath = shardStrdup(nob_sv_from_cstr(options.inputPaths.items[i])),
+                .start = start,
+                .end = end,
+                .outputPath = shardStrdup(nob_sv_from_cstr(nob_temp_sprintf("%s.shard-%zu", options.outputPath, shards->count))),
+            };
+            nob_da_append(shards, shard);
+            start = end;
+        }
+        fclose(file);
+    }
+
+defer:
+    free(sizes);
+    return result;
+}
+
+void shardManifestFree(ShardManifest* manifest) {
+    free((char*) manifest->settings.lexiconPath);
+    free((char*) manifest->settings.ngramPath);
+    for (size_t i = 0; i < manifest->inputs.count; ++i) free((char*) manifest->inputs.items[i].path);
+    nob_da_free(manifest->inputs);
+    shardsFree(&manifest->shards);
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+bool shardWriteManifest(const char* manifestPath, ShardOptions options, Shards shards) {
+    ShardSettings settings = options.settings;
+    Nob_String_Builder sb = {0};
+    bool result = true;
+    nob_sb_append_cstr(&sb, SHARD_MANIFEST_HEADER "\n");
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("shards\t%zu\n", options.shardCount));
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("format\t%s\n", outputFormatNames[settings.format]));
+    nob_sb_append_cstr(&sb, nob_temp_sprintf("meter\t%s\n", settings.detectMeter ? "detect" : dhMeterName(settings.meter)));
+    if (settings.lexiconPath != NULL) nob_sb_append_cstr(&sb, nob_temp_sprintf("lexicon\t%s\n", settings.lexiconPath));
+    if (settings.ngramPath != NULL) nob_sb_append_cstr(&sb, nob_temp_sprintf("ngram\t%s\n", settings.ngramPath));
+    for (size_t i = 0; i < options.inputPaths.count; ++i) {
+        ShardInput input;
+        if (!shardStatInput(options.inputPaths.items[i], &input)) {
+            nob_log(NOB_ERROR, "Couldn't open %s: %s", options.inputPaths.items[i], strerror(errno));
+            nob_return_defer(false);
+        }
+        nob_sb_append_cstr(&sb, nob_temp_sprintf("input\t%lld\t%lld\t%s\n", input.size, input.modified, options.inputPaths.items[i]));
+    }
+    for (size_t i = 0; i < shards.count; ++i) {
+        Shard shard = shards.items[i];
+        nob_sb_append_cstr(&sb, nob_temp_sprintf("%lld\t%lld\t%s\t%s\n", shard.start, shard.end, shard.inputPath, shard.outputPath));
+    }
+    result = nob_write_entire_file(manifestPath, sb.items, sb.count);
+
+defer:
+    nob_sb_free(sb);
+    return result;
+}
+
+// Check that the input files are still the same as when the manifest was written, so the shards still line up
+bool shardCheckInputs(const char* manifestPath, const ShardManifest* manifest) {
+    for (size_t i = 0; i < manifest->inputs.count; ++i) {
+        const ShardInput* expected = &manifest->inputs.items[i];
+        ShardInput input;
+        if (!shardStatInput(expected->path, &input)) {
+            nob_log(NOB_ERROR, "Couldn't open %s: %s", expected->path, strerror(errno));
+            return false;
+        }
+        if (input.size != expected->size || input.modified != expected->modified) {
+            nob_log(NOB_ERROR, "%s changed since %s was written, so its shards don't line up anymore", expected->path, manifestPath);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool shardPathsEqual(const char* a, const char* b) {
+    if (a == NULL || b == NULL) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+// Check that an existing manifest was written for the same command, so its shards can be reused
+bool shardCheckManifest(const char* manifestPath, const ShardManifest* manifest, ShardOptions options) {
+    const char* different = NULL;
+    ShardSettings settings = manifest->settings;
+    if (manifest->shardCount != options.shardCount) different = "amount of shards";
+    else if (settings.format != options.settings.format) different = "format";
+    else if (settings.detectMeter != options.settings.detectMeter || (!settings.detectMeter && settings.meter != options.settings.meter)) different = "meter";
+    else if (!shardPathsEqual(settings.lexiconPath, options.settings.lexiconPath)) different = "lexicon";
+    else if (!shardPathsEqual(settings.ngramPath, options.settings.ngramPath)) different = "n-gram model";
+    else if (manifest->inputs.count != options.inputPaths.count) different = "list of input files";
+    for (size_t i = 0; different == NULL && i < manifest->inputs.count; ++i) {
+        if (strcmp(manifest->inputs.items[i].path, options.inputPaths.items[i]) != 0) different = "list of input files";
+    }
+    if (different != NULL) {
+        nob_log(NOB_ERROR, "%s was written for another %s. Remove it and the shards next to the output to start over, or use another output (-o) or manifest (-m)",
+            manifestPath, different);
+        return false;
+    }
+    return shardCheckInputs(manifestPath, manifest);
+}
+
+bool shardReadManifest(const char* manifestPath, ShardManifest* manifest) {
+    Nob_String_Builder sb = {0};
+    bool result = true;
+    manifest->settings.meter = DH_METER_HEXAMETER;
+    if (!nob_read_entire_file(manifestPath, &sb)) nob_return_defer(false);
+
+    Nob_String_View content = nob_sv_from_parts(sb.items, sb.count);
+    if (!nob_sv_eq(nob_sv_trim_right(nob_sv_chop_by_delim(&content, '\n')), nob_sv_from_cstr(SHARD_MANIFEST_HEADER))) {
+        nob_log(NOB_ERROR, "%s isn't a shard manifest of this version", manifestPath);
+        nob_return_defer(false);
+    }
+    size_t lineNumber = 1;
+    while (content.count > 0) {
+        Nob_String_View line = nob_sv_trim_right(nob_sv_chop_by_delim(&content, '\n'));
+        ++lineNumber;
+        if (line.count == 0 || line.data[0] == '#') continue;
+
+        if (!isdigit((unsigned char) line.data[0])) {
+            Nob_String_View name = nob_sv_chop_by_delim(&line, '\t');
+            const char* value = nob_temp_sv_to_cstr(line);
+            if (nob_sv_eq(name, nob_sv_from_cstr("shards"))) {
+                manifest->shardCount = strtoull(value, NULL, 10);
+            } else if (nob_sv_eq(name, nob_sv_from_cstr("input"))) {
+                Nob_String_View size = nob_sv_chop_by_delim(&line, '\t');
+                Nob_String_View modified = nob_sv_chop_by_delim(&line, '\t');
+                if (size.count == 0 || modified.count == 0 || line.count == 0) goto invalid;
+                ShardInput input = {
+                    .path = shardStrdup(line),
+                    .size = strtoll(nob_temp_sv_to_cstr(size), NULL, 10),
+                    .modified = strtoll(nob_temp_sv_to_cstr(modified), NULL, 10),
+                };
+                nob_da_append(&manifest->inputs, input);
+            } else if (nob_sv_eq(name, nob_sv_from_cstr("format"))) {
+                if (!parseOutputFormat(value, &manifest->settings.format)) goto invalid;
+            } else if (nob_sv_eq(name, nob_sv_from_cstr("meter"))) {
+                manifest->settings.detectMeter = strcmp(value, "detect") == 0;
+                if (!manifest->settings.detectMeter && !dhMeterFromName(value, &manifest->settings.meter)) goto invalid;
+            } else if (nob_sv_eq(name, nob_sv_from_cstr("lexicon")) && manifest->settings.lexiconPath == NULL) {
+                manifest->settings.lexiconPath = shardStrdup(line);
+            } else if (nob_sv_eq(name, nob_sv_from_cstr("ngram")) && manifest->settings.ngramPath == NULL) {
+                manifest->settings.ngramPath = shardStrdup(line);
+            } else {
+                goto invalid;
+            }
+            continue;
+        }
+
+        Nob_String_View start = nob_sv_chop_by_delim(&line, '\t');
+        Nob_String_View end = nob_sv_chop_by_delim(&line, '\t');
+        Nob_String_View inputPath = nob_sv_chop_by_delim(&line, '\t');
+        Nob_String_View outputPath = line;
+        if (start.count == 0 || end.count == 0 || inputPath.count == 0 || outputPath.count == 0) goto invalid;
+
+        Shard shard = {
+            .inputPath = shardStrdup(inputPath),
+            .start = strtoll(nob_temp_sv_to_cstr(start), NULL, 10),
+            .end = strtoll(nob_temp_sv_to_cstr(end), NULL, 10),
+            .outputPath = shardStrdup(outputPath),
+        };
+        nob_da_append(&manifest->shards, shard);
+    }
+    nob_return_defer(true);
+
+invalid:
+    nob_log(NOB_ERROR, "%s:%zu: Invalid line in the shard manifest", manifestPath, lineNumber);
+    result = false;
+
+defer:
+    nob_sb_free(sb);
+    return result;
+}
+
+const char* shardStatsPath(const Shard* shard) {
+    return nob_temp_sprintf("%s.stats", shard->outputPath);
+}
+
+bool shardWriteStats(const char* path, BatchStats stats) {
+    const char* content = nob_temp_sprintf("verses %zu\nscanned %zu\nfailed %zu\n", stats.verses, stats.scanned, stats.failed);
+    return nob_write_entire_file(path, content, strlen(content));
+}
+
+bool shardReadStats(const char* path, BatchStats* stats) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    BatchStats read = {0};
+    bool result = fscanf(file, "verses %zu scanned %zu failed %zu", &read.verses, &read.scanned, &read.failed) == 3;
+    if (result)
+        batchStatsAdd(stats, read);
+    else
+        nob_log(NOB_ERROR, "Invalid statistics in %s", path);
+    fclose(file);
+    return result;
+}
+
+bool shardWorker(const char* manifestPath, size_t index) {
+    bool result = true;
+    ShardManifest manifest = {0};
+    Lexicon lexicon = {0};
+    NgramModel ngram = {0};
+    FILE* in = NULL;
+    FILE* out = NULL;
+    if (!shardReadManifest(manifestPath, &manifest)) nob_return_defer(false);
+    if (index >= manifest.shards.count) {
+        nob_log(NOB_ERROR, "%s only has %zu shards", manifestPath, manifest.shards.count);
+        nob_return_defer(false);
+    }
+    if (!shardCheckInputs(manifestPath, &manifest)) nob_return_defer(false);
+    Shard* shard = &manifest.shards.items[index];
+    ShardSettings settings = manifest.settings;
+    if (settings.lexiconPath != NULL && !lexiconOpen(&lexicon, settings.lexiconPath)) nob_return_defer(false);
+    if (settings.ngramPath != NULL && !ngramLoad(&ngram, settings.ngramPath)) nob_return_defer(false);
+
+    in = fopen(shard->inputPath, "rb");
+    if (in == NULL || !batchSeek(in, shard->start)) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", shard->inputPath, strerror(errno));
+        nob_return_defer(false);
+    }
+
+    // Write to a temporary file first, so the output only exists once the whole shard is done.
+    // If an earlier run of this shard left a checkpoint behind, pick up where it stopped
+    const char* tempPath = nob_temp_sprintf("%s.tmp", shard->outputPath);
+    Checkpointer checkpointer = { .path = nob_temp_sprintf("%s.checkpoint", tempPath) };
+    if (!checkpointOpenOutput(&checkpointer, tempPath, true, in, shard->start, &out)) nob_return_defer(false);
+
+    BatchOutput output = {
+        .format = settings.format,
+        .scan = {
+            .meter = settings.meter,
+            .detectMeter = settings.detectMeter,
+            .lexicon = settings.lexiconPath != NULL ? &lexicon : NULL,
+            .ngram = settings.ngramPath != NULL ? &ngram : NULL,
+        },
+        .file = out,
+        .checkpointer = &checkpointer,
+    };
+    if (!batchRun(in, shard->end, &output)) nob_return_defer(false);
+    if (fclose(out) != 0) {
+        out = NULL;
+        nob_log(NOB_ERROR, "Couldn't write %s: %s", tempPath, strerror(errno));
+        nob_return_defer(false);
+    }
+    out = NULL;
+
+    if (!shardWriteStats(shardStatsPath(shard), checkpointer.progress.stats)) nob_return_defer(false);
+    if (!nob_rename(tempPath, shard->outputPath)) nob_return_defer(false);
+    checkpointFinish(&checkpointer);
+
+defer:
+    if (in != NULL) fclose(in);
+    if (out != NULL) fclose(out);
+    lexiconClose(&lexicon);
+    ngramFree(&ngram);
+    shardManifestFree(&manifest);
+    return result;
+}
+
+// Append a whole file to another one
+bool shardAppendFile(FILE* out, const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (in == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", path, strerror(errno));
+        return false;
+    }
+    char buffer[64*1024];
+    size_t read;
+    bool result = true;
+    while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, read, out) != read) {
+            result = false;
+            break;
+        }
+    }
+    if (ferror(in)) result = false;
+    fclose(in);
+    return result;
+}
+
+bool shardCoordinate(const char* program, ShardOptions options) {
+    bool result = true;
+    ShardManifest manifest = {0};
+    Shards* shards = &manifest.shards;
+    Nob_Procs procs = {0};
+    Nob_Cmd cmd = {0};
+    FILE* out = NULL;
+
+    const char* manifestPath = options.manifestPath != NULL ? options.manifestPath : nob_temp_sprintf("%s.manifest", options.outputPath);
+    if (nob_file_exists(manifestPath) == 1) {
+        // Reuse the old split, so the shards that are already done still line up
+        nob_log(NOB_INFO, "Reusing the shards in %s", manifestPath);
+        if (!shardReadManifest(manifestPath, &manifest)) nob_return_defer(false);
+        if (!shardCheckManifest(manifestPath, &manifest, options)) nob_return_defer(false);
+    } else {
+        if (!shardSplit(options, shards)) nob_return_defer(false);
+        if (!shardWriteManifest(manifestPath, options, *shards)) nob_return_defer(false);
+    }
+
+    if (options.manifestOnly) {
+        nob_log(NOB_INFO, "Wrote %zu shards to %s. Run `%s --worker %s <index>` for every shard, then run this command again without --manifest-only to merge them",
+            shards->count, manifestPath, program, manifestPath);
+        nob_return_defer(true);
+    }
+
+    // Run the workers for the shards that aren't done yet, at most shardCount at a time
+    size_t jobs = options.shardCount > 0 ? options.shardCount : 1;
+    for (size_t i = 0; i < shards->count; ++i) {
+        if (nob_file_exists(shards->items[i].outputPath) == 1) continue;
+        nob_cmd_append(&cmd, program, "--worker", manifestPath, nob_temp_sprintf("%zu", i));
+        nob_da_append(&procs, nob_cmd_run_async_and_reset(&cmd));
+        if (procs.count >= jobs) nob_procs_wait_and_reset(&procs);
+    }
+    nob_procs_wait_and_reset(&procs);
+
+    size_t missing = 0;
+    for (size_t i = 0; i < shards->count; ++i) {
+        if (nob_file_exists(shards->items[i].outputPath) != 1) {
+            nob_log(NOB_ERROR, "Shard %zu (%s, bytes %lld to %lld) failed", i, shards->items[i].inputPath, shards->items[i].start, shards->items[i].end);
+            ++missing;
+        }
+    }
+    if (missing > 0) {
+        nob_log(NOB_ERROR, "%zu of %zu shards failed. Run the same command again to only redo those", missing, shards->count);
+        nob_return_defer(false);
+    }
+
+    // Merge the shards in the order of the manifest, so the result is the same as scanning the input in one go
+    const char* tempPath = nob_temp_sprintf("%s.tmp", options.outputPath);
+    out = fopen(tempPath, "wb");
+    if (out == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", tempPath, strerror(errno));
+        nob_return_defer(false);
+    }
+    // A CSV file starts with the names of the columns, which the workers leave out
+    if (options.settings.format == OUTPUT_CSV) fputs(RECORD_CSV_HEADER, out);
+    BatchStats stats = {0};
+    for (size_t i = 0; i < shards->count; ++i) {
+        if (!shardAppendFile(out, shards->items[i].outputPath) || !shardReadStats(shardStatsPath(&shards->items[i]), &stats)) {
+            nob_log(NOB_ERROR, "Couldn't merge shard %zu", i);
+            nob_return_defer(false);
+        }
+    }
+    bool closed = fclose(out) == 0;
+    out = NULL;
+    if (!closed) {
+        nob_log(NOB_ERROR, "Couldn't write %s: %s", tempPath, strerror(errno));
+        nob_return_defer(false);
+    }
+    if (!nob_rename(tempPath, options.outputPath)) nob_return_defer(false);
+
+    nob_log(NOB_INFO, "Scanned %zu verses in %zu shards: %zu succeeded, %zu failed", stats.verses, shards->count, stats.scanned, stats.failed);
+
+    // Everything is in the output now, so the shards can go
+    for (size_t i = 0; i < shards->count; ++i) {
+        remove(shards->items[i].outputPath);
+        remove(shardStatsPath(&shards->items[i]));
+    }
+    remove(manifestPath);
+
+defer:
+    if (out != NULL) fclose(out);
+    shardManifestFree(&manifest);
+    nob_da_free(procs);
+    nob_cmd_free(cmd);
+    return result;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include "nob.h"
+#include "batch.h"
+
+// A piece of an input file, always starting and ending at the start of a line
+typedef struct {
+    const char* inputPath;
+    long long start;
+    long long end;
+    // Where the worker writes the scanned verses. The shard is finished once this file exists
+    const char* outputPath;
+} Shard;
+
+typedef struct {
+    Shard* items;
+    size_t count;
+    size_t capacity;
+} Shards;
+
+// How the workers scan the verses and write them, the same as the flags of --batch
+typedef struct {
+    // Anything but OUTPUT_COLUMNAR, since the outputs of the shards are simply put after each other
+    OutputFormat format;
+    DhMeter meter;
+    bool detectMeter;
+    // Optional
+    const char* lexiconPath;
+    const char* ngramPath;
+} ShardSettings;
+
+// An input file as it was when the manifest was written, so a manifest for files that changed since isn't used
+typedef struct {
+    const char* path;
+    long long size;
+    long long modified;
+} ShardInput;
+
+typedef struct {
+    ShardInput* items;
+    size_t count;
+    size_t capacity;
+} ShardInputs;
+
+// Everything in a manifest
+typedef struct {
+    ShardSettings settings;
+    // The amount of shards that were asked for, which isn't always the amount there are
+    size_t shardCount;
+    ShardInputs inputs;
+    Shards shards;
+} ShardManifest;
+
+void shardManifestFree(ShardManifest* manifest);
+
+typedef struct {
+    ShardSettings settings;
+    // The amount of shards to split the input into, which is also the amount of workers that run at the same time
+    size_t shardCount;
+    // Where the merged output goes. The shards are put next to it
+    const char* outputPath;
+    // Where the shard manifest goes. NULL means "<outputPath>.manifest"
+    const char* manifestPath;
+    // Only write the manifest, so the workers can be run by hand (on other hosts, for example)
+    bool manifestOnly;
+    Nob_File_Paths inputPaths;
+} ShardOptions;
+
+/* Split the input files into shards, run a worker process (`program --worker <manifest> <index>`) for every shard that
+ * isn't finished yet, and merge the outputs and statistics in the order of the manifest. If the manifest already exists,
+ * it's reused instead of splitting the inputs again, so running the same command again only redoes the failed shards.
+ * A manifest that was written for other inputs, other settings or another amount of shards is an error
+ */
+bool shardCoordinate(const char* program, ShardOptions options);
+
+// Scan one shard from a manifest. This is what the worker processes run
+bool shardWorker(const char* manifestPath, size_t index);
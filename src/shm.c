@@ -0,0 +1,475 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "shm.h"
+#include "pipeline.h"
+
+#ifndef _WIN32
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* How many times to look before going to sleep. A round trip takes a few microseconds, so it's usually over by then.
+ * With only one processor the other side can't get anything done while this one spins, so then it sleeps right away
+ */
+#define SHM_SPINS 4000
+// How long to sleep at most before checking if the daemon is still there, or if it should stop, in milliseconds
+#define SHM_TICK_MS 100
+
+void shmRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+#ifdef _WIN32
+
+void shmFutexWait(_Atomic uint32_t* word, uint32_t expected) {
+    NOB_UNUSED(word);
+    NOB_UNUSED(expected);
+    Sleep(1);
+}
+
+void shmFutexWake(_Atomic uint32_t* word, int count) {
+    NOB_UNUSED(word);
+    NOB_UNUSED(count);
+}
+
+void shmYield(void) {
+    SwitchToThread();
+}
+
+bool shmClientDaemonAlive(const ShmClient* client) {
+    return atomic_load(&client->header->running);
+}
+
+#else
+
+// Sleep while a word in the region is still expected, for at most SHM_TICK_MS. The region is shared, so not FUTEX_PRIVATE
+void shmFutexWait(_Atomic uint32_t* word, uint32_t expected) {
+    struct timespec timeout = { .tv_sec = 0, .tv_nsec = SHM_TICK_MS*1000000 };
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+void shmFutexWake(_Atomic uint32_t* word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+void shmYield(void) {
+    sched_yield();
+}
+
+// Whether the process that wrote its id into a region is still there. Somebody else's process (EPERM) counts as well
+bool shmProcessAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+bool shmClientDaemonAlive(const ShmClient* client) {
+    return atomic_load(&client->header->running) && shmProcessAlive(atomic_load(&client->header->pid));
+}
+
+#endif // _WIN32
+
+// The amount of slots a request takes up. The client is trusted to stay inside the ring, but not more than that
+size_t shmSpan(const ShmHeader* header, const ShmSlot* slot) {
+    return slot->span >= 1 && slot->span <= header->slotCount ? slot->span : 1;
+}
+
+// Take the next request (with all of its slots) off the ring, or NULL if there's none
+ShmSlot* shmTake(ShmHeader* header, ShmSlot* slots) {
+    uint64_t mask = header->slotCount - 1;
+    uint64_t position = atomic_load_explicit(&header->dequeuePosition, memory_order_relaxed);
+    for (;;) {
+        ShmSlot* slot = &slots[position & mask];
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        int64_t difference = (int64_t) (sequence - (position + 1));
+        if (difference == 0) {
+            uint64_t next = position + shmSpan(header, slot);
+            if (atomic_compare_exchange_weak_explicit(&header->dequeuePosition, &position, next, memory_order_relaxed, memory_order_relaxed)) return slot;
+        } else if (difference < 0) {
+            return NULL;
+        } else {
+            position = atomic_load_explicit(&header->dequeuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+// Take count free slots that come right after each other in the ring, or NULL if there aren't that many free yet
+ShmSlot* shmReserveSpan(ShmClient* client, size_t count) {
+    ShmHeader* header = client->header;
+    uint64_t mask = header->slotCount - 1;
+    uint64_t position = atomic_load_explicit(&header->enqueuePosition, memory_order_relaxed);
+    for (;;) {
+        int64_t difference = 0;
+        for (size_t i = 0; i < count && difference == 0; ++i) {
+            uint64_t sequence = atomic_load_explicit(&client->slots[(position + i) & mask].sequence, memory_order_acquire);
+            difference = (int64_t) (sequence - (position + i));
+        }
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&header->enqueuePosition, &position, position + count, memory_order_relaxed, memory_order_relaxed)) {
+                for (size_t i = 0; i < count; ++i) client->slots[(position + i) & mask].position = position + i;
+                return &client->slots[position & mask];
+            }
+        } else if (difference < 0) {
+            // A slot from one lap ago is still in use, so the ring is full
+            return NULL;
+        } else {
+            position = atomic_load_explicit(&header->enqueuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+ShmSlot* shmClientReserve(ShmClient* client) {
+    return shmReserveSpan(client, 1);
+}
+
+/* Hand a verse that was written into the lines of count slots, starting with slot, to the scanners. Only the first
+ * slot is published, and the scanner that takes it takes the rest along
+ */
+void shmSubmitSpan(ShmClient* client, ShmSlot* slot, size_t count, size_t length) {
+    ShmHeader* header = client->header;
+    slot->length = length;
+    slot->span = count;
+    atomic_store_explicit(&slot->state, SHM_SLOT_REQUEST, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, slot->position + 1, memory_order_release);
+    // Only wake a scanner up if one went to sleep. It says so before looking at the ring one last time, so this can't miss it
+    atomic_fetch_add(&header->requests, 1);
+    if (atomic_load(&header->sleepingScanners) > 0) shmFutexWake(&header->requests, 1);
+}
+
+void shmClientSubmit(ShmClient* client, ShmSlot* slot, size_t length) {
+    if (length > SHM_LINE_SIZE - 1) length = SHM_LINE_SIZE - 1;
+    slot->line[length] = '\0';
+    shmSubmitSpan(client, slot, 1, length);
+}
+
+bool shmClientWait(ShmClient* client, ShmSlot* slot) {
+    for (size_t i = 0; i < client->spins; ++i) {
+        if (atomic_load_explicit(&slot->state, memory_order_acquire) == SHM_SLOT_DONE) return true;
+        shmRelax();
+    }
+    atomic_store(&slot->clientSleeping, 1);
+    while (atomic_load(&slot->state) != SHM_SLOT_DONE) {
+        if (!shmClientDaemonAlive(client)) {
+            atomic_store(&slot->clientSleeping, 0);
+            return false;
+        }
+        shmFutexWait(&slot->state, SHM_SLOT_REQUEST);
+    }
+    atomic_store(&slot->clientSleeping, 0);
+    return true;
+}
+
+// Give back count slots that were reserved together, starting with slot
+void shmReleaseSpan(ShmClient* client, ShmSlot* slot, size_t count) {
+    uint64_t slotCount = client->header->slotCount;
+    for (size_t i = 0; i < count; ++i) {
+        ShmSlot* part = &client->slots[(slot->position + i) & (slotCount - 1)];
+        atomic_store_explicit(&part->state, SHM_SLOT_FREE, memory_order_relaxed);
+        atomic_store_explicit(&part->sequence, part->position + slotCount, memory_order_release);
+    }
+}
+
+void shmClientRelease(ShmClient* client, ShmSlot* slot) {
+    shmReleaseSpan(client, slot, 1);
+}
+
+bool shmClientScan(ShmClient* client, const char* verse, size_t length, DhRecord* record) {
+    // A verse that fits in one slot gets its NULL-terminator there, a longer one uses every byte of every line
+    size_t count = length < SHM_LINE_SIZE ? 1 : (length + SHM_LINE_SIZE - 1)/SHM_LINE_SIZE;
+    if (count > client->header->slotCount || length > UINT32_MAX) {
+        // The ring can never hold it, and with that many letters it can't be a verse anyway
+        nob_log(NOB_WARNING, "A verse of %zu bytes doesn't fit in the shared memory, so it's counted as too long", length);
+        *record = (DhRecord) { .status = DH_TOO_MANY_SYLLABLES, .syllableCount = UINT8_MAX };
+        return true;
+    }
+    ShmSlot* slot;
+    while ((slot = shmReserveSpan(client, count)) == NULL) {
+        if (!shmClientDaemonAlive(client)) return false;
+        // Full, so let the scanners catch up
+        shmYield();
+    }
+    if (length < SHM_LINE_SIZE) {
+        memcpy(slot->line, verse, length);
+        slot->line[length] = '\0';
+    } else {
+        for (size_t i = 0, written = 0; i < count; ++i, written += SHM_LINE_SIZE) {
+            size_t partLength = length - written < SHM_LINE_SIZE ? length - written : SHM_LINE_SIZE;
+            memcpy(client->slots[(slot->position + i) & (client->header->slotCount - 1)].line, verse + written, partLength);
+        }
+    }
+    shmSubmitSpan(client, slot, count, length);
+    bool done = shmClientWait(client, slot);
+    if (done) *record = recordDecodeBinary(slot->record);
+    shmReleaseSpan(client, slot, count);
+    return done;
+}
+
+#ifdef _WIN32
+
+bool shmServe(ShmOptions options) {
+    NOB_UNUSED(options);
+    nob_log(NOB_ERROR, "Scanning through shared memory needs futexes, which only Linux has");
+    return false;
+}
+
+bool shmClientOpen(ShmClient* client, const char* name) {
+    NOB_UNUSED(client);
+    NOB_UNUSED(name);
+    nob_log(NOB_ERROR, "Scanning through shared memory needs futexes, which only Linux has");
+    return false;
+}
+
+void shmClientClose(ShmClient* client) {
+    NOB_UNUSED(client);
+}
+
+#else
+
+typedef struct {
+    ShmHeader* header;
+    ShmSlot* slots;
+    ShmOptions options;
+    size_t spins;
+    atomic_bool stopping;
+} ShmDaemon;
+
+static volatile sig_atomic_t shmStopRequested = 0;
+
+void shmStopHandler(int signal) {
+    NOB_UNUSED(signal);
+    shmStopRequested = 1;
+}
+
+void* shmScanner(void* arg) {
+    ShmDaemon* daemon = arg;
+    ShmHeader* header = daemon->header;
+    DhContext ctx = {
+        .meter = daemon->options.scan.meter,
+        .detectMeter = daemon->options.scan.detectMeter,
+        .lexicon = daemon->options.scan.lexicon,
+        .ngram = daemon->options.scan.ngram,
+    };
+    DhVerse verse;
+    // Where a verse that's spread over several slots is put back together
+    Nob_String_Builder longLine = {0};
+    uint64_t mask = header->slotCount - 1;
+
+    for (;;) {
+        ShmSlot* slot = NULL;
+        for (size_t i = 0; i < daemon->spins && slot == NULL; ++i) {
+            slot = shmTake(header, daemon->slots);
+            if (slot == NULL) shmRelax();
+        }
+        if (slot == NULL) {
+            // Say that this scanner is going to sleep before looking one last time, so no request can slip by
+            uint32_t seen = atomic_load(&header->requests);
+            atomic_fetch_add(&header->sleepingScanners, 1);
+            slot = shmTake(header, daemon->slots);
+            if (slot == NULL && !atomic_load(&daemon->stopping)) shmFutexWait(&header->requests, seen);
+            atomic_fetch_sub(&header->sleepingScanners, 1);
+            if (slot == NULL) {
+                if (atomic_load(&daemon->stopping)) break;
+                continue;
+            }
+        }
+
+        // The client is trusted to stay inside its slots, but not to end the verse
+        size_t span = shmSpan(header, slot);
+        if (span == 1 && slot->length < SHM_LINE_SIZE) {
+            slot->line[slot->length] = '\0';
+            dhScanLine(&ctx, slot->line, &verse);
+        } else {
+            size_t left = slot->length < span*SHM_LINE_SIZE ? slot->length : span*SHM_LINE_SIZE;
+            longLine.count = 0;
+            for (size_t i = 0; i < span; ++i) {
+                size_t partLength = left < SHM_LINE_SIZE ? left : SHM_LINE_SIZE;
+                nob_sb_append_buf(&longLine, daemon->slots[(slot->position + i) & mask].line, partLength);
+                left -= partLength;
+            }
+            nob_sb_append_null(&longLine);
+            dhScanLine(&ctx, longLine.items, &verse);
+        }
+        DhRecord record = recordFromVerse(&verse);
+        // Append the record right into the slot. It has exactly enough room, so this never reallocates
+        Nob_String_Builder out = { .items = (char*) slot->record, .capacity = RECORD_BINARY_SIZE };
+        recordAppendBinary(&out, &record);
+
+        atomic_store(&slot->state, SHM_SLOT_DONE);
+        if (atomic_load(&slot->clientSleeping)) shmFutexWake(&slot->state, 1);
+    }
+
+    dhContextFree(&ctx);
+    nob_sb_free(longLine);
+    return NULL;
+}
+
+/* A region that's still there is either another daemon's that's running, or one from a daemon that was killed before
+ * it could remove it. Only the second one is removed
+ */
+bool shmRemoveLeftover(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return true;
+    struct stat info;
+    const ShmHeader* header = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(ShmHeader)) {
+        header = mmap(NULL, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (header == MAP_FAILED || memcmp(header->magic, SHM_MAGIC, sizeof(header->magic)) != 0) {
+        if (header != MAP_FAILED) munmap((void*) header, sizeof(ShmHeader));
+        nob_log(NOB_ERROR, "The shared memory %s already exists, but isn't from a daemon of this version. Remove it or use another --name", name);
+        return false;
+    }
+    int32_t pid = atomic_load(&header->pid);
+    munmap((void*) header, sizeof(ShmHeader));
+    if (shmProcessAlive(pid)) {
+        nob_log(NOB_ERROR, "A daemon (process %d) is already scanning through the shared memory %s", pid, name);
+        return false;
+    }
+    nob_log(NOB_WARNING, "Replacing the shared memory %s that process %d left behind", name, pid);
+    shm_unlink(name);
+    return true;
+}
+
+bool shmServe(ShmOptions options) {
+    if (options.name == NULL) options.name = SHM_DEFAULT_NAME;
+    if (options.slotCount == 0) options.slotCount = SHM_DEFAULT_SLOTS;
+    if (options.slotCount > UINT32_MAX/2) {
+        nob_log(NOB_ERROR, "%zu slots is too many", options.slotCount);
+        return false;
+    }
+    // The position of a slot is a mask away then
+    size_t slotCount = 1;
+    while (slotCount < options.slotCount) slotCount *= 2;
+    size_t threadCount = options.threadCount > 0 ? options.threadCount : pipelineDefaultThreadCount();
+    size_t size = sizeof(ShmHeader) + slotCount*sizeof(ShmSlot);
+
+    if (!shmRemoveLeftover(options.name)) return false;
+    int fd = shm_open(options.name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Couldn't create the shared memory %s: %s", options.name, strerror(errno));
+        return false;
+    }
+    void* region = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        nob_log(NOB_ERROR, "Couldn't map the shared memory %s: %s", options.name, strerror(errno));
+        shm_unlink(options.name);
+        return false;
+    }
+
+    ShmDaemon daemon = {
+        .header = region,
+        .slots = (ShmSlot*) ((char*) region + sizeof(ShmHeader)),
+        .options = options,
+        .spins = pipelineDefaultThreadCount() > 1 ? SHM_SPINS : 0,
+    };
+    // The id goes in before the magic, so another daemon never finds a region of this version without it
+    atomic_store(&daemon.header->pid, getpid());
+    memcpy(daemon.header->magic, SHM_MAGIC, sizeof(daemon.header->magic));
+    daemon.header->slotCount = slotCount;
+    daemon.header->slotSize = sizeof(ShmSlot);
+    for (size_t i = 0; i < slotCount; ++i) atomic_store_explicit(&daemon.slots[i].sequence, i, memory_order_relaxed);
+    atomic_store(&daemon.header->running, 1);
+
+    struct sigaction stop = { .sa_handler = shmStopHandler };
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    pthread_t* threads = malloc(threadCount*sizeof(pthread_t));
+    NOB_ASSERT(threads != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < threadCount; ++i) pthread_create(&threads[i], NULL, shmScanner, &daemon);
+    nob_log(NOB_INFO, "Scanning through the shared memory %s with %zu slots and %zu scanners", options.name, slotCount, threadCount);
+
+    struct timespec tick = { .tv_sec = 0, .tv_nsec = SHM_TICK_MS*1000000 };
+    while (!shmStopRequested) nanosleep(&tick, NULL);
+    nob_log(NOB_INFO, "Stopping the daemon");
+
+    // New clients can't find the region anymore, and the ones that are waiting give up
+    shm_unlink(options.name);
+    atomic_store(&daemon.header->running, 0);
+    atomic_store(&daemon.stopping, true);
+    atomic_fetch_add(&daemon.header->requests, 1);
+    shmFutexWake(&daemon.header->requests, INT_MAX);
+    for (size_t i = 0; i < threadCount; ++i) pthread_join(threads[i], NULL);
+    for (size_t i = 0; i < slotCount; ++i) shmFutexWake(&daemon.slots[i].state, INT_MAX);
+    free(threads);
+    munmap(region, size);
+    return true;
+}
+
+bool shmClientOpen(ShmClient* client, const char* name) {
+    if (name == NULL) name = SHM_DEFAULT_NAME;
+    memset(client, 0, sizeof(*client));
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Couldn't open the shared memory %s (is the daemon running?): %s", name, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    void* region = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(ShmHeader)) {
+        region = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (region == MAP_FAILED) {
+        nob_log(NOB_ERROR, "Couldn't map the shared memory %s", name);
+        return false;
+    }
+    client->header = region;
+    client->slots = (ShmSlot*) ((char*) region + sizeof(ShmHeader));
+    client->size = info.st_size;
+    client->spins = pipelineDefaultThreadCount() > 1 ? SHM_SPINS : 0;
+
+    const ShmHeader* header = client->header;
+    uint32_t slotCount = header->slotCount;
+    if (
+        memcmp(header->magic, SHM_MAGIC, sizeof(header->magic)) != 0 || header->slotSize != sizeof(ShmSlot) ||
+        slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || sizeof(ShmHeader) + (size_t) slotCount*sizeof(ShmSlot) > client->size
+    ) {
+        nob_log(NOB_ERROR, "%s isn't the shared memory of a daemon of this version", name);
+        shmClientClose(client);
+        return false;
+    }
+    if (!shmClientDaemonAlive(client)) {
+        nob_log(NOB_ERROR, "The daemon of the shared memory %s isn't running anymore", name);
+        shmClientClose(client);
+        return false;
+    }
+    return true;
+}
+
+void shmClientClose(ShmClient* client) {
+    if (client->header != NULL) munmap(client->header, client->size);
+    memset(client, 0, sizeof(*client));
+}
+
+#endif // _WIN32
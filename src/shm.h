@@ -0,0 +1,143 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* Scanning through shared memory, for programs on the same machine that scan so many verses that even a pipe or a
+ * local HTTP connection costs too much. The daemon (shmServe) creates a region with shm_open that holds a ring of
+ * slots. A client writes a verse straight into a free slot, the daemon's scanner threads write the record into that
+ * same slot, and the client reads it from there, so nothing is copied on the way.
+ *
+ * The ring is a bounded queue many clients can put requests in and many scanners can take them from at once without
+ * any locks (Vyukov's MPMC queue): every slot has a sequence number that says whose turn it is. A slot goes back to
+ * the clients once the client that had it is done reading its record. Scanners that find the ring empty, and clients
+ * that are waiting for their record, spin for a moment and then sleep on a futex in the region, so the other side
+ * only makes a system call to wake them when somebody is actually sleeping.
+ *
+ * Linux only.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+#include "records.h"
+
+#include <stdatomic.h>
+
+#define SHM_MAGIC "DHSHM002"
+#define SHM_DEFAULT_NAME "/dactylichexameter"
+#define SHM_DEFAULT_SLOTS 1024
+// The longest verse a slot holds, including the NULL-terminator
+#define SHM_LINE_SIZE 464
+
+typedef enum {
+    // The slot is free, or a client is writing its verse into it
+    SHM_SLOT_FREE,
+    // The verse is waiting for a scanner, or being scanned
+    SHM_SLOT_REQUEST,
+    // The record is there
+    SHM_SLOT_DONE,
+} ShmSlotState;
+
+typedef struct {
+    /* Whose turn it is at the slot that's at position p in the ring (p modulo the amount of slots): it's free for the
+     * request at p when this is p, and has that request in it when it's p + 1
+     */
+    _Alignas(64) _Atomic uint64_t sequence;
+    // A ShmSlotState, which the client sleeps on while it's waiting for the record
+    _Atomic uint32_t state;
+    _Atomic uint32_t clientSleeping;
+    // The position in the ring the slot was taken for
+    uint64_t position;
+    // The length of the verse, without the NULL-terminator
+    uint32_t length;
+    /* The amount of slots the verse takes up, starting with this one. A verse that doesn't fit in one slot goes on in
+     * the lines of the slots after it, without NULL-terminators in between. Those are taken off the ring together with
+     * this one
+     */
+    uint32_t span;
+    // The record in the binary format of records.h
+    uint8_t record[RECORD_BINARY_SIZE];
+    char line[SHM_LINE_SIZE];
+} ShmSlot;
+
+// The start of the region. The slots come right after it
+typedef struct {
+    char magic[8];
+    uint32_t slotCount;
+    // sizeof(ShmSlot), so a client that was built with a different layout is turned away
+    uint32_t slotSize;
+    // Cleared when the daemon stops, so clients don't wait for it forever
+    _Atomic uint32_t running;
+    /* The process id of the daemon. If it's killed before it can clear running, the clients (and a new daemon with the
+     * same name) can tell from this that it's gone
+     */
+    _Atomic int32_t pid;
+    // Where the next request goes, and where the next scanner takes one from. They're on their own cache lines
+    _Alignas(64) _Atomic uint64_t enqueuePosition;
+    _Alignas(64) _Atomic uint64_t dequeuePosition;
+    // Goes up with every request, and the scanners sleep on it when there aren't any
+    _Alignas(64) _Atomic uint32_t requests;
+    _Atomic uint32_t sleepingScanners;
+} ShmHeader;
+
+typedef struct {
+    const char* name;
+    // The amount of scanner threads. 0 means one per processor
+    size_t threadCount;
+    // The amount of slots in the ring, rounded up to a power of two. 0 means SHM_DEFAULT_SLOTS
+    size_t slotCount;
+    // How to scan
+    DhScanSettings scan;
+} ShmOptions;
+
+/* Create the region and scan what comes in until the process gets SIGINT or SIGTERM. The region is removed after.
+ * Fails if another daemon with the same name is still running, and replaces the region of one that was killed
+ */
+bool shmServe(ShmOptions options);
+
+typedef struct {
+    ShmHeader* header;
+    ShmSlot* slots;
+    size_t size;
+    // How many times to look for the record before sleeping
+    size_t spins;
+} ShmClient;
+
+// Map the region of a daemon that's running
+bool shmClientOpen(ShmClient* client, const char* name);
+void shmClientClose(ShmClient* client);
+
+/* Take a free slot and write a verse of at most SHM_LINE_SIZE - 1 bytes into its line. Returns NULL if all of them are
+ * taken, which only lasts until the scanners catch up
+ */
+ShmSlot* shmClientReserve(ShmClient* client);
+// Hand the verse in a slot that was reserved to the scanners
+void shmClientSubmit(ShmClient* client, ShmSlot* slot, size_t length);
+// Whether the daemon is still there to scan the verses
+bool shmClientDaemonAlive(const ShmClient* client);
+// Wait until the record of a slot is there. Returns false if the daemon stopped (or was killed) first
+bool shmClientWait(ShmClient* client, ShmSlot* slot);
+// Give a slot back once its record has been read
+void shmClientRelease(ShmClient* client, ShmSlot* slot);
+
+/* Scan one verse through the daemon: reserve, submit, wait and release. A verse that's too long for one slot is spread
+ * over as many as it needs. Returns false if the daemon stopped
+ */
+bool shmClientScan(ShmClient* client, const char* verse, size_t length, DhRecord* record);
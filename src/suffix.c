@@ -0,0 +1,43 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "suffix.h"
+// Generated by nob from suffixes.txt. State 0 is the start, the empty ending
+#include "suffixautomaton.h"
+
+size_t suffixMatch(const char* word, size_t len, uint8_t* longMask, uint8_t* shortMask) {
+    size_t matched = 0;
+    uint16_t state = 0;
+    for (size_t i = len; i > 0; --i) {
+        char chr = word[i - 1];
+        if (chr == 'j') chr = 'i';
+        else if (chr == 'v') chr = 'u';
+        if (chr < 'a' || chr > 'z') break;
+        state = suffixStates[state].next[chr - 'a'];
+        if (state == 0) break;
+        if (suffixStates[state].length > 0) {
+            matched = suffixStates[state].length;
+            *longMask = suffixStates[state].longMask;
+            *shortMask = suffixStates[state].shortMask;
+        }
+    }
+    return matched;
+}
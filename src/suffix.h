@@ -0,0 +1,47 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* The suffix automaton: a trie of the endings in suffixes.txt, reversed so it's walked from the end of a word to its
+ * start. nob compiles the rule file into a table of states in build/suffixautomaton.h, so there's nothing to load.
+ * Words are walked the way they are in the stripped line, with 'j' and 'v' read as 'i' and 'u'.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// The longest ending a rule can have, so the masks fit in a byte
+#define SUFFIX_MAX_LENGTH 8
+
+typedef struct {
+    // The state after reading a letter (going backwards), or 0 if no ending continues with it
+    uint16_t next[26];
+    // The length of the ending this state stands for if it's a rule, and 0 otherwise
+    uint8_t length;
+    // Bit n is set if letter n of the ending (counting from its start) is a long or short vowel
+    uint8_t longMask;
+    uint8_t shortMask;
+} SuffixState;
+
+/* Find the longest ending of a word that has a rule, in one pass from its end. Returns the length of the ending, or 0
+ * if there's none, and sets the masks to the quantities of its letters
+ */
+size_t suffixMatch(const char* word, size_t len, uint8_t* longMask, uint8_t* shortMask);
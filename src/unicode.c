@@ -0,0 +1,252 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "unicode.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool unicodeIsAscii(const char* string, size_t len) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Or 16 bytes at a time together and only look at the top bits at the end
+    __m128i bits = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) bits = _mm_or_si128(bits, _mm_loadu_si128((const __m128i*) (string + i)));
+    if (_mm_movemask_epi8(bits) != 0) return false;
+#else
+    uint64_t bits = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, string + i, sizeof(word));
+        bits |= word;
+    }
+    if (bits & 0x8080808080808080ull) return false;
+#endif
+    for (; i < len; ++i) {
+        if ((unsigned char) string[i] >= 0x80) return false;
+    }
+    return true;
+}
+
+// What a letter from Latin-1 or Latin Extended-A is read as
+typedef struct {
+    const char* ascii;
+    DhMark mark;
+} UnicodeLetter;
+
+#define UNICODE_LETTERS_START 0xC0
+#define UNICODE_LETTERS_END   0x180
+
+// Indexed by code point - UNICODE_LETTERS_START. Missing entries aren't letters
+static const UnicodeLetter unicodeLetters[UNICODE_LETTERS_END - UNICODE_LETTERS_START] = {
+#define L(codePoint, ascii, mark) [(codePoint) - UNICODE_LETTERS_START] = {ascii, DH_MARK_##mark}
+    // Latin-1, upper case and lower case
+    L(0xC0, "A", NONE), L(0xC1, "A", NONE), L(0xC2, "A", LONG), L(0xC3, "A", NONE), L(0xC4, "A", DIAERESIS), L(0xC5, "A", NONE),
+    L(0xC6, "AE", NONE), L(0xC7, "C", NONE),
+    L(0xC8, "E", NONE), L(0xC9, "E", NONE), L(0xCA, "E", LONG), L(0xCB, "E", DIAERESIS),
+    L(0xCC, "I", NONE), L(0xCD, "I", NONE), L(0xCE, "I", LONG), L(0xCF, "I", DIAERESIS),
+    L(0xD0, "D", NONE), L(0xD1, "N", NONE),
+    L(0xD2, "O", NONE), L(0xD3, "O", NONE), L(0xD4, "O", LONG), L(0xD5, "O", NONE), L(0xD6, "O", DIAERESIS), L(0xD8, "O", NONE),
+    L(0xD9, "U", NONE), L(0xDA, "U", NONE), L(0xDB, "U", LONG), L(0xDC, "U", DIAERESIS),
+    L(0xDD, "Y", NONE), L(0xDE, "TH", NONE), L(0xDF, "ss", NONE),
+    L(0xE0, "a", NONE), L(0xE1, "a", NONE), L(0xE2, "a", LONG), L(0xE3, "a", NONE), L(0xE4, "a", DIAERESIS), L(0xE5, "a", NONE),
+    L(0xE6, "ae", NONE), L(0xE7, "c", NONE),
+    L(0xE8, "e", NONE), L(0xE9, "e", NONE), L(0xEA, "e", LONG), L(0xEB, "e", DIAERESIS),
+    L(0xEC, "i", NONE), L(0xED, "i", NONE), L(0xEE, "i", LONG), L(0xEF, "i", DIAERESIS),
+    L(0xF0, "d", NONE), L(0xF1, "n", NONE),
+    L(0xF2, "o", NONE), L(0xF3, "o", NONE), L(0xF4, "o", LONG), L(0xF5, "o", NONE), L(0xF6, "o", DIAERESIS), L(0xF8, "o", NONE),
+    L(0xF9, "u", NONE), L(0xFA, "u", NONE), L(0xFB, "u", LONG), L(0xFC, "u", DIAERESIS),
+    L(0xFD, "y", NONE), L(0xFE, "th", NONE), L(0xFF, "y", DIAERESIS),
+    // Latin Extended-A, which comes in upper case and lower case pairs
+    L(0x100, "A", LONG), L(0x101, "a", LONG), L(0x102, "A", SHORT), L(0x103, "a", SHORT), L(0x104, "A", NONE), L(0x105, "a", NONE),
+    L(0x106, "C", NONE), L(0x107, "c", NONE), L(0x108, "C", NONE), L(0x109, "c", NONE),
+    L(0x10A, "C", NONE), L(0x10B, "c", NONE), L(0x10C, "C", NONE), L(0x10D, "c", NONE),
+    L(0x10E, "D", NONE), L(0x10F, "d", NONE), L(0x110, "D", NONE), L(0x111, "d", NONE),
+    L(0x112, "E", LONG), L(0x113, "e", LONG), L(0x114, "E", SHORT), L(0x115, "e", SHORT),
+    L(0x116, "E", NONE), L(0x117, "e", NONE), L(0x118, "E", NONE), L(0x119, "e", NONE), L(0x11A, "E", NONE), L(0x11B, "e", NONE),
+    L(0x11C, "G", NONE), L(0x11D, "g", NONE), L(0x11E, "G", NONE), L(0x11F, "g", NONE),
+    L(0x120, "G", NONE), L(0x121, "g", NONE), L(0x122, "G", NONE), L(0x123, "g", NONE),
+    L(0x124, "H", NONE), L(0x125, "h", NONE), L(0x126, "H", NONE), L(0x127, "h", NONE),
+    L(0x128, "I", NONE), L(0x129, "i", NONE), L(0x12A, "I", LONG), L(0x12B, "i", LONG), L(0x12C, "I", SHORT), L(0x12D, "i", SHORT),
+    L(0x12E, "I", NONE), L(0x12F, "i", NONE), L(0x130, "I", NONE), L(0x131, "i", NONE), L(0x132, "IJ", NONE), L(0x133, "ij", NONE),
+    L(0x134, "J", NONE), L(0x135, "j", NONE), L(0x136, "K", NONE), L(0x137, "k", NONE), L(0x138, "k", NONE),
+    L(0x139, "L", NONE), L(0x13A, "l", NONE), L(0x13B, "L", NONE), L(0x13C, "l", NONE), L(0x13D, "L", NONE), L(0x13E, "l", NONE),
+    L(0x13F, "L", NONE), L(0x140, "l", NONE), L(0x141, "L", NONE), L(0x142, "l", NONE),
+    L(0x143, "N", NONE), L(0x144, "n", NONE), L(0x145, "N", NONE), L(0x146, "n", NONE), L(0x147, "N", NONE), L(0x148, "n", NONE),
+    L(0x149, "n", NONE), L(0x14A, "N", NONE), L(0x14B, "n", NONE),
+    L(0x14C, "O", LONG), L(0x14D, "o", LONG), L(0x14E, "O", SHORT), L(0x14F, "o", SHORT), L(0x150, "O", NONE), L(0x151, "o", NONE),
+    L(0x152, "OE", NONE), L(0x153, "oe", NONE),
+    L(0x154, "R", NONE), L(0x155, "r", NONE), L(0x156, "R", NONE), L(0x157, "r", NONE), L(0x158, "R", NONE), L(0x159, "r", NONE),
+    L(0x15A, "S", NONE), L(0x15B, "s", NONE), L(0x15C, "S", NONE), L(0x15D, "s", NONE),
+    L(0x15E, "S", NONE), L(0x15F, "s", NONE), L(0x160, "S", NONE), L(0x161, "s", NONE),
+    L(0x162, "T", NONE), L(0x163, "t", NONE), L(0x164, "T", NONE), L(0x165, "t", NONE), L(0x166, "T", NONE), L(0x167, "t", NONE),
+    L(0x168, "U", NONE), L(0x169, "u", NONE), L(0x16A, "U", LONG), L(0x16B, "u", LONG), L(0x16C, "U", SHORT), L(0x16D, "u", SHORT),
+    L(0x16E, "U", NONE), L(0x16F, "u", NONE), L(0x170, "U", NONE), L(0x171, "u", NONE), L(0x172, "U", NONE), L(0x173, "u", NONE),
+    L(0x174, "W", NONE), L(0x175, "w", NONE), L(0x176, "Y", NONE), L(0x177, "y", NONE), L(0x178, "Y", DIAERESIS),
+    L(0x179, "Z", NONE), L(0x17A, "z", NONE), L(0x17B, "Z", NONE), L(0x17C, "z", NONE), L(0x17D, "Z", NONE), L(0x17E, "z", NONE),
+    L(0x17F, "s", NONE),
+#undef L
+};
+
+// The combining marks that say something about the length of the letter before them
+#define UNICODE_COMBINING_START     0x300
+#define UNICODE_COMBINING_END       0x370
+#define UNICODE_COMBINING_MACRON    0x304
+#define UNICODE_COMBINING_BREVE     0x306
+#define UNICODE_COMBINING_DIAERESIS 0x308
+
+/* Decode one code point from a string, and return how many bytes it took up. Returns 1 with a code point of -1 if the
+ * bytes aren't valid UTF-8
+ */
+size_t unicodeDecode(const unsigned char* bytes, int32_t* codePoint) {
+    size_t size;
+    if (bytes[0] < 0x80) {
+        *codePoint = bytes[0];
+        return 1;
+    } else if ((bytes[0] & 0xE0) == 0xC0) {
+        *codePoint = bytes[0] & 0x1F;
+        size = 2;
+    } else if ((bytes[0] & 0xF0) == 0xE0) {
+        *codePoint = bytes[0] & 0x0F;
+        size = 3;
+    } else if ((bytes[0] & 0xF8) == 0xF0) {
+        *codePoint = bytes[0] & 0x07;
+        size = 4;
+    } else {
+        *codePoint = -1;
+        return 1;
+    }
+    // A NULL-terminator isn't a continuation byte, so this never reads past the end
+    for (size_t i = 1; i < size; ++i) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            *codePoint = -1;
+            return 1;
+        }
+        *codePoint = *codePoint << 6 | (bytes[i] & 0x3F);
+    }
+    return size;
+}
+
+// The ASCII character a code point that isn't a letter is read as, or 0 if it's dropped
+char unicodeNonLetter(int32_t codePoint) {
+    switch (codePoint) {
+    case 0x2018: case 0x2019: case 0x201A: case 0x201B:
+        return '\'';
+    case 0x201C: case 0x201D: case 0x201E: case 0x201F: case 0xAB: case 0xBB:
+        return '"';
+    case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014:
+        return '-';
+    case 0xA0: case 0x202F: case 0x3000:
+        return ' ';
+    // A byte order mark
+    case 0xFEFF:
+        return 0;
+    }
+    if (codePoint >= 0x2000 && codePoint <= 0x200A) return ' ';
+    return '?';
+}
+
+void unicodeNormalize(const char* line, Nob_String_Builder* ascii, DhMarks* marks) {
+    ascii->count = 0;
+    marks->count = 0;
+    bool marked = false;
+    const unsigned char* bytes = (const unsigned char*) line;
+    size_t i = 0;
+    while (bytes[i]) {
+        int32_t codePoint;
+        i += unicodeDecode(bytes + i, &codePoint);
+        if (codePoint >= 0 && codePoint < 0x80) {
+            nob_da_append(ascii, codePoint);
+            nob_da_append(marks, DH_MARK_NONE);
+        } else if (codePoint >= UNICODE_LETTERS_START && codePoint < UNICODE_LETTERS_END && unicodeLetters[codePoint - UNICODE_LETTERS_START].ascii != NULL) {
+            const UnicodeLetter* letter = &unicodeLetters[codePoint - UNICODE_LETTERS_START];
+            for (const char* c = letter->ascii; *c; ++c) {
+                nob_da_append(ascii, *c);
+                nob_da_append(marks, letter->mark);
+            }
+            marked |= letter->mark != DH_MARK_NONE;
+        } else if (codePoint == 0x232 || codePoint == 0x233) {
+            // 'ȳ' is the only letter with a macron outside of Latin Extended-A that shows up in Latin
+            nob_da_append(ascii, codePoint == 0x232 ? 'Y' : 'y');
+            nob_da_append(marks, DH_MARK_LONG);
+            marked = true;
+        } else if (codePoint >= UNICODE_COMBINING_START && codePoint < UNICODE_COMBINING_END) {
+            // A combining mark goes on the letter before it. The ones that don't say anything about the length are dropped
+            DhMark mark = DH_MARK_NONE;
+            if (codePoint == UNICODE_COMBINING_MACRON) mark = DH_MARK_LONG;
+            if (codePoint == UNICODE_COMBINING_BREVE) mark = DH_MARK_SHORT;
+            if (codePoint == UNICODE_COMBINING_DIAERESIS) mark = DH_MARK_DIAERESIS;
+            if (mark != DH_MARK_NONE && marks->count > 0 && isalpha(ascii->items[ascii->count - 1])) {
+                marks->items[marks->count - 1] = mark;
+                marked = true;
+            }
+        } else {
+            char chr = unicodeNonLetter(codePoint);
+            if (chr == 0) continue;
+            nob_da_append(ascii, chr);
+            nob_da_append(marks, DH_MARK_NONE);
+        }
+    }
+    nob_sb_append_null(ascii);
+    if (!marked) marks->count = 0;
+}
+
+// Append a code point as UTF-8
+void unicodeAppendCodePoint(Nob_String_Builder* sb, int32_t codePoint) {
+    if (codePoint < 0x80) {
+        nob_da_append(sb, codePoint);
+    } else if (codePoint < 0x800) {
+        nob_da_append(sb, 0xC0 | codePoint >> 6);
+        nob_da_append(sb, 0x80 | (codePoint & 0x3F));
+    } else {
+        nob_da_append(sb, 0xE0 | codePoint >> 12);
+        nob_da_append(sb, 0x80 | (codePoint >> 6 & 0x3F));
+        nob_da_append(sb, 0x80 | (codePoint & 0x3F));
+    }
+}
+
+// The lowercase vowels, in the order of the columns of markedVowels
+static const char markedVowelLetters[] = "aeiouy";
+
+// The precomposed code point of every vowel with every mark, or 0 if there isn't one
+static const int32_t markedVowels[][6] = {
+    [DH_MARK_NONE]      = {'a', 'e', 'i', 'o', 'u', 'y'},
+    [DH_MARK_LONG]      = {0x101, 0x113, 0x12B, 0x14D, 0x16B, 0x233},
+    [DH_MARK_SHORT]     = {0x103, 0x115, 0x12D, 0x14F, 0x16D, 0},
+    [DH_MARK_DIAERESIS] = {0xE4, 0xEB, 0xEF, 0xF6, 0xFC, 0xFF},
+};
+static_assert(NOB_ARRAY_LEN(markedVowels) == COUNT_DH_MARKS, "Amount of marks have changed");
+
+void unicodeAppendMarked(Nob_String_Builder* sb, char vowel, DhMark mark) {
+    const char* column = strchr(markedVowelLetters, vowel);
+    if (vowel == 0 || column == NULL || mark >= COUNT_DH_MARKS) {
+        nob_da_append(sb, vowel);
+        return;
+    }
+    int32_t codePoint = markedVowels[mark][column - markedVowelLetters];
+    if (codePoint != 0) {
+        unicodeAppendCodePoint(sb, codePoint);
+        return;
+    }
+    // There's no 'y' with a breve, so it gets a combining one
+    nob_da_append(sb, vowel);
+    unicodeAppendCodePoint(sb, UNICODE_COMBINING_BREVE);
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2024 gstaaij
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+/* Reading UTF-8 verses. Editions that mark vowel lengths write them with macrons (ā) and breves (ă), and a diaeresis
+ * (poëta) to show two vowels aren't a diphthong. The scanner only works on ASCII, so lines are decoded into plain
+ * letters with the marks kept next to them, one for every letter. Most verses are plain ASCII, so that's checked first
+ * and such lines aren't copied at all.
+ */
+
+#pragma once
+#include "nob.h"
+#include "dactylichexameter.h"
+
+// Check if the first len bytes of a string are all ASCII
+bool unicodeIsAscii(const char* string, size_t len);
+
+/* Decode a UTF-8 line into ascii, which is cleared first and NULL-terminated. A letter with a macron, circumflex, breve
+ * or diaeresis becomes the letter itself, with its DhMark at the same index in marks. Other accents are dropped, 'æ' and
+ * 'œ' become "ae" and "oe", curly quotes and dashes become their ASCII versions, other kinds of spaces become ' ', and
+ * anything else that isn't ASCII (or isn't valid UTF-8) becomes '?'. marks is left empty if no letter is marked
+ */
+void unicodeNormalize(const char* line, Nob_String_Builder* ascii, DhMarks* marks);
+
+// Append a lowercase vowel with a mark on it as UTF-8, in a form unicodeNormalize reads back as the same vowel and mark
+void unicodeAppendMarked(Nob_String_Builder* sb, char vowel, DhMark mark);